@@ -0,0 +1,15 @@
+#ifndef YOSEMITE_BENCH_CPP_TRACE_H
+#define YOSEMITE_BENCH_CPP_TRACE_H
+
+// No-op stand-in for cpp_trace, the bench does not collect host backtraces.
+
+#include <string>
+#include <vector>
+
+inline void init_backtrace(const char* lib_path) {}
+
+inline std::vector<std::string> get_backtrace() {
+    return {};
+}
+
+#endif // YOSEMITE_BENCH_CPP_TRACE_H
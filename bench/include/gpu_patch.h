@@ -0,0 +1,76 @@
+#ifndef YOSEMITE_BENCH_GPU_PATCH_H
+#define YOSEMITE_BENCH_GPU_PATCH_H
+
+/* Stand-in for nv-compute's gpu_src/include/gpu_patch.h.
+
+Only the bench target puts this directory ahead of the real include path,
+so the analyzer and its tools build without the nv-compute tree. It
+declares the records the tools read, with the fields they use; keep it in
+sync when a tool starts reading a new field.
+*/
+
+#include <cstdint>
+
+#define GPU_WARP_SIZE 32
+#define MAX_NUM_MEMORY_RANGES 1000
+
+// MemoryAccess::flags bits, from the sanitizer API and the pc dependency patch
+#define SANITIZER_MEMORY_DEVICE_FLAG_READ 0x1
+#define SANITIZER_MEMORY_DEVICE_FLAG_WRITE 0x2
+#define SANITIZER_MEMORY_DEVICE_FLAG_RED 0x3
+#define SANITIZER_MEMORY_DEVICE_FLAG_ATOMIC 0x4
+#define SANITIZER_MEMORY_DEVICE_FLAG_PREFETCH 0x8
+#define SANITIZER_MEMORY_GLOBAL 0x10
+#define SANITIZER_MEMORY_SHARED 0x20
+#define SANITIZER_MEMORY_LOCAL 0x40
+
+enum class MemoryType : uint32_t {
+    Global = 0,
+    Shared = 1,
+    Local = 2,
+    BlockExit = 3,
+};
+
+struct MemoryRange {
+    uint64_t start;
+    uint64_t end;
+
+    bool operator<(const MemoryRange& other) const {
+        return start < other.start || (start == other.start && end < other.end);
+    }
+};
+
+struct MemoryAccess {
+    uint64_t pc;
+    uint32_t flags;
+    uint32_t accessSize;
+    uint32_t distinct_sector_count;
+    uint32_t active_mask;
+    uint32_t unique_address_mask;
+    MemoryType type;
+    uint64_t ctaId;
+    uint32_t warpId;
+    uint64_t addresses[GPU_WARP_SIZE];
+};
+
+struct MemoryAccessState {
+    uint32_t size;
+    MemoryRange start_end[MAX_NUM_MEMORY_RANGES];
+    uint32_t touch[MAX_NUM_MEMORY_RANGES];
+};
+
+struct TensorAccessState {
+    uint32_t size;
+    MemoryRange start_end[MAX_NUM_MEMORY_RANGES];
+    uint32_t touch[MAX_NUM_MEMORY_RANGES];
+};
+
+struct MemoryAccessTracker {
+    uint64_t accessCount;
+    uint64_t accessSize;
+    MemoryAccessState* access_state;
+    TensorAccessState* tensor_access_state;
+    MemoryAccess* access;
+};
+
+#endif // YOSEMITE_BENCH_GPU_PATCH_H
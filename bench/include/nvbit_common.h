@@ -0,0 +1,15 @@
+#ifndef YOSEMITE_BENCH_NVBIT_COMMON_H
+#define YOSEMITE_BENCH_NVBIT_COMMON_H
+
+// Stand-in for nv-nvbit's nvbit_common.h, see gpu_patch.h.
+
+#include <cstdint>
+
+#define GPU_WARP_SIZE_NVBIT 32
+
+typedef struct {
+    uint64_t grid_launch_id;
+    uint64_t addrs[GPU_WARP_SIZE_NVBIT];
+} nvbit_mem_access_t;
+
+#endif // YOSEMITE_BENCH_NVBIT_COMMON_H
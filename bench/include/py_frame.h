@@ -0,0 +1,13 @@
+#ifndef YOSEMITE_BENCH_PY_FRAME_H
+#define YOSEMITE_BENCH_PY_FRAME_H
+
+// No-op stand-in for py_frame, the bench has no Python frames to walk.
+
+#include <string>
+#include <vector>
+
+inline std::vector<std::string> get_pyframes() {
+    return {};
+}
+
+#endif // YOSEMITE_BENCH_PY_FRAME_H
@@ -0,0 +1,431 @@
+/* sanalyzer-bench: per-tool throughput on synthetic GPU traces.
+
+    make bench
+    bin/sanalyzer-bench --tools=pc_dependency_analysis --workers=1,2,4,8
+
+Every (tool, pattern, worker count) case builds a fresh tool, replays the
+allocation and kernel events of the synthetic kernel around its buffers
+and reports accesses/sec, ns per warp record, host event cost and peak
+RSS. YOSEMITE_WORKER_COUNT is set per case, so tools that read it show
+their scaling; the other tools run once with the first worker count.
+Tracker tools only get one per-kernel summary, so their accesses/sec is
+the rate at which they consume summaries, not per-access work.
+Tools write their usual output folders under --output-dir.
+*/
+#include "trace_generator.h"
+#include "tools/tool.h"
+#include "utils/access_trace.h"
+#include "utils/event_pool.h"
+#include "tools/mem_trace.h"
+#include "tools/heatmap_analysis.h"
+#include "tools/block_divergence_analysis.h"
+#include "tools/pc_dependency_analysis.h"
+#include "tools/app_analysis_cpu.h"
+#include "tools/time_hotness_cpu.h"
+#include "tools/app_metric.h"
+#include "tools/app_analysis.h"
+#include "tools/uvm_advisor.h"
+#include "tools/roofline_size.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace yosemite;
+
+typedef enum {
+    BenchInput_TRACE = 0,     // MemoryAccess records
+    BenchInput_TRACKER = 1,   // one MemoryAccessTracker per kernel
+} BenchInput_t;
+
+typedef struct BenchTool {
+    const char* name;
+    BenchInput_t input;
+    bool uses_workers;
+    bool global_only;   // asserts on addresses outside device allocations
+    int alloc_type;     // UVMAdvisor only tracks managed (0x6) allocations
+    std::function<std::shared_ptr<Tool>()> create;
+} BenchTool_t;
+
+static const std::vector<BenchTool_t> _bench_tools = {
+    {"mem_trace", BenchInput_TRACE, false, false, 0, [] { return std::make_shared<MemTrace>(); }},
+    {"heatmap_analysis", BenchInput_TRACE, false, false, 0, [] { return std::make_shared<HeatmapAnalysis>(); }},
+    {"block_divergence_analysis", BenchInput_TRACE, false, false, 0, [] { return std::make_shared<BlockDivergenceAnalysis>(); }},
+    {"pc_dependency_analysis", BenchInput_TRACE, true, false, 0, [] { return std::make_shared<PcDependency>(); }},
+    {"app_analysis_cpu", BenchInput_TRACE, false, true, 0, [] { return std::make_shared<AppAnalysisCPU>(); }},
+    {"time_hotness_cpu", BenchInput_TRACE, false, false, 0, [] { return std::make_shared<TimeHotnessCPU>(); }},
+    {"app_metric", BenchInput_TRACKER, false, false, 0, [] { return std::make_shared<AppMetrics>(); }},
+    {"app_analysis", BenchInput_TRACKER, false, false, 0, [] { return std::make_shared<AppAnalysis>(); }},
+    {"uvm_advisor", BenchInput_TRACKER, false, false, 0x6, [] { return std::make_shared<UVMAdvisor>(); }},
+    {"roofline_size", BenchInput_TRACKER, false, false, 0, [] { return std::make_shared<RooflineSize>(); }},
+};
+
+typedef struct BenchOptions {
+    std::vector<std::string> tools;
+    std::vector<TracePattern_t> patterns;
+    std::vector<uint32_t> workers;
+    TraceConfig_t trace;
+    uint32_t iterations = 3;
+    uint64_t buffer_records = 1 << 16;
+    std::string csv_file;
+    std::string output_dir = "sanalyzer_bench_out";
+} BenchOptions_t;
+
+typedef struct BenchResult {
+    double data_seconds = 0;
+    double event_seconds = 0;
+    uint64_t events = 0;
+    uint64_t peak_rss_kb = 0;
+} BenchResult_t;
+
+
+static std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        if (comma > pos) {
+            items.push_back(list.substr(pos, comma - pos));
+        }
+        pos = comma + 1;
+    }
+    return items;
+}
+
+
+// Peak RSS is per case: writing 5 to clear_refs resets VmHWM (Linux >= 4.0).
+static void reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if (clear_refs) {
+        clear_refs << "5";
+    }
+}
+
+
+static uint64_t read_peak_rss_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::strtoull(line.c_str() + 6, nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+
+class EventTimer {
+public:
+    explicit EventTimer(BenchResult_t& result) : _result(result), _start(std::chrono::steady_clock::now()) {}
+
+    ~EventTimer() {
+        _result.event_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    }
+
+private:
+    BenchResult_t& _result;
+    std::chrono::steady_clock::time_point _start;
+};
+
+
+static EventRecord_t make_record(EventType_t evt_type, uint64_t& sequence) {
+    EventRecord_t record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp = sequence++;
+    record.evt_type = evt_type;
+    record.device_id = 0;
+    return record;
+}
+
+
+static BenchResult_t run_case(const BenchTool_t& bench_tool, const SyntheticTrace_t& trace,
+                              const BenchOptions_t& options) {
+    BenchResult_t result;
+    reset_peak_rss();
+    std::shared_ptr<Tool> tool = bench_tool.create();
+
+    AccessTraceDecoder decoder;
+    decoder.set_typed(true);
+    MemoryAccessState access_state;
+    TensorAccessState tensor_state;
+    MemoryAccessTracker tracker;
+    fill_tracker(trace, access_state, tensor_state, tracker);
+
+    uint64_t sequence = 0;
+    const uint32_t kernel_name = EventNameTable::instance().intern("bench_kernel");
+    {
+        EventTimer timer(result);
+        for (const MemoryRange& range : trace.allocations) {
+            EventRecord_t alloc = make_record(EventType_MEM_ALLOC, sequence);
+            alloc.mem_alloc = {range.start, range.end - range.start, bench_tool.alloc_type};
+            tool->mem_alloc_callback(alloc);
+
+            EventRecord_t ten_alloc = make_record(EventType_TEN_ALLOC, sequence);
+            const int64_t size = static_cast<int64_t>(range.end - range.start);
+            ten_alloc.ten_alloc = {range.start, size, size, size};
+            tool->ten_alloc_callback(ten_alloc);
+            result.events += 2;
+        }
+    }
+
+    for (uint32_t iteration = 0; iteration < options.iterations; iteration++) {
+        {
+            EventTimer timer(result);
+            EventRecord_t launch = make_record(EventType_KERNEL_LAUNCH, sequence);
+            launch.kernel_launch = {kernel_name, trace.grid_dim, 1, 1, trace.block_dim, 1, 1,
+                                    trace.block_dim, trace.grid_dim};
+            tool->kernel_start_callback(launch);
+            result.events++;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        if (bench_tool.input == BenchInput_TRACKER) {
+            tool->gpu_data_analysis(&tracker, 1);
+        } else {
+            const MemoryAccess* accesses = trace.accesses.data();
+            const uint64_t total = trace.accesses.size();
+            for (uint64_t offset = 0; offset < total; offset += options.buffer_records) {
+                const uint64_t size = std::min<uint64_t>(options.buffer_records, total - offset);
+                if (tool->access_trace()) {
+                    tool->gpu_trace_analysis(decoder.decode(accesses + offset, size));
+                } else {
+                    tool->gpu_data_analysis(const_cast<MemoryAccess*>(accesses + offset), size);
+                }
+            }
+        }
+        result.data_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            EventTimer timer(result);
+            EventRecord_t end = make_record(EventType_KERNEL_END, sequence);
+            end.kernel_end = {kernel_name};
+            tool->kernel_end_callback(end);
+            result.events++;
+        }
+    }
+
+    {
+        EventTimer timer(result);
+        for (const MemoryRange& range : trace.allocations) {
+            EventRecord_t ten_free = make_record(EventType_TEN_FREE, sequence);
+            const int64_t size = static_cast<int64_t>(range.end - range.start);
+            ten_free.ten_free = {range.start, -size, 0, size};
+            tool->ten_free_callback(ten_free);
+
+            EventRecord_t mem_free = make_record(EventType_MEM_FREE, sequence);
+            mem_free.mem_free = {range.start, range.end - range.start, bench_tool.alloc_type};
+            tool->mem_free_callback(mem_free);
+            result.events += 2;
+        }
+    }
+
+    result.peak_rss_kb = read_peak_rss_kb();
+    return result;
+}
+
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --tools=a,b,...        tools to run (default: all)\n"
+            "  --patterns=a,b,...     trace patterns (default: all)\n"
+            "  --workers=1,2,...      YOSEMITE_WORKER_COUNT values (default: 1,2,4,8)\n"
+            "  --records=N            warp records per kernel (default: %lu)\n"
+            "  --ctas=N               CTAs per kernel (default: %u)\n"
+            "  --warps=N              warps per CTA (default: %u)\n"
+            "  --iterations=N         kernel launches per case (default: 3)\n"
+            "  --buffer-records=N     records per gpu_data_analysis call (default: 65536)\n"
+            "  --seed=N               generator seed\n"
+            "  --csv=FILE             also write the results as CSV\n"
+            "  --output-dir=DIR       working directory for tool output (default: sanalyzer_bench_out)\n",
+            program, TraceConfig_t().records, TraceConfig_t().ctas, TraceConfig_t().warps_per_cta);
+    fprintf(stderr, "Tools:");
+    for (const auto& tool : _bench_tools) {
+        fprintf(stderr, " %s", tool.name);
+    }
+    fprintf(stderr, "\nPatterns:");
+    for (uint32_t i = 0; i < TracePatternCount; i++) {
+        fprintf(stderr, " %s", trace_pattern_name(static_cast<TracePattern_t>(i)));
+    }
+    fprintf(stderr, "\n");
+}
+
+
+static bool parse_options(int argc, char** argv, BenchOptions_t& options) {
+    options.trace.records = 1 << 18;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        const size_t eq = arg.find('=');
+        if (eq != std::string::npos) {
+            value = arg.substr(eq + 1);
+            arg = arg.substr(0, eq);
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        }
+
+        if (arg == "--tools") {
+            options.tools = split_list(value);
+        } else if (arg == "--patterns") {
+            for (const auto& name : split_list(value)) {
+                TracePattern_t pattern;
+                if (!trace_pattern_from_name(name, pattern)) {
+                    fprintf(stderr, "Unknown pattern %s.\n", name.c_str());
+                    return false;
+                }
+                options.patterns.push_back(pattern);
+            }
+        } else if (arg == "--workers") {
+            for (const auto& count : split_list(value)) {
+                options.workers.push_back(static_cast<uint32_t>(std::stoul(count)));
+            }
+        } else if (arg == "--records") {
+            options.trace.records = std::stoull(value);
+        } else if (arg == "--ctas") {
+            options.trace.ctas = static_cast<uint32_t>(std::stoul(value));
+        } else if (arg == "--warps") {
+            options.trace.warps_per_cta = static_cast<uint32_t>(std::stoul(value));
+        } else if (arg == "--iterations") {
+            options.iterations = static_cast<uint32_t>(std::stoul(value));
+        } else if (arg == "--buffer-records") {
+            options.buffer_records = std::max<uint64_t>(1, std::stoull(value));
+        } else if (arg == "--seed") {
+            options.trace.seed = std::stoull(value);
+        } else if (arg == "--csv") {
+            options.csv_file = value;
+        } else if (arg == "--output-dir") {
+            options.output_dir = value;
+        } else {
+            return false;
+        }
+    }
+
+    if (options.tools.empty()) {
+        for (const auto& tool : _bench_tools) {
+            options.tools.push_back(tool.name);
+        }
+    }
+    if (options.patterns.empty()) {
+        for (uint32_t i = 0; i < TracePatternCount; i++) {
+            options.patterns.push_back(static_cast<TracePattern_t>(i));
+        }
+    }
+    if (options.workers.empty()) {
+        options.workers = {1, 2, 4, 8};
+    }
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+    BenchOptions_t options;
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<const BenchTool_t*> tools;
+    for (const auto& name : options.tools) {
+        const BenchTool_t* found = nullptr;
+        for (const auto& tool : _bench_tools) {
+            if (name == tool.name) {
+                found = &tool;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Unknown tool %s.\n", name.c_str());
+            usage(argv[0]);
+            return 1;
+        }
+        tools.push_back(found);
+    }
+
+    FILE* csv = nullptr;
+    if (!options.csv_file.empty()) {
+        csv = fopen(options.csv_file.c_str(), "w");
+        if (!csv) {
+            fprintf(stderr, "Cannot open %s.\n", options.csv_file.c_str());
+            return 1;
+        }
+        fprintf(csv, "tool,pattern,workers,warp_records,accesses,data_seconds,accesses_per_second,"
+                     "ns_per_warp_record,events,ns_per_event,peak_rss_kb,speedup\n");
+    }
+    mkdir(options.output_dir.c_str(), 0755);
+    if (chdir(options.output_dir.c_str()) != 0) {
+        fprintf(stderr, "Cannot enter %s.\n", options.output_dir.c_str());
+        return 1;
+    }
+
+    // tool output would drown the table
+    fflush(stdout);
+    const int report_fd = dup(STDOUT_FILENO);
+    FILE* report = fdopen(report_fd, "w");
+    if (!freopen("tool_output.log", "w", stdout)) {
+        fprintf(stderr, "Cannot redirect tool output, it will be interleaved with the report.\n");
+    }
+
+    fprintf(report, "%-26s %-15s %7s %10s %12s %10s %9s %9s %10s %7s\n",
+            "tool", "pattern", "workers", "records", "accesses", "Macc/s", "ns/rec", "ns/evt", "peakRSS MB", "speedup");
+    fflush(report);
+
+    for (TracePattern_t pattern : options.patterns) {
+        TraceConfig_t config = options.trace;
+        config.pattern = pattern;
+        SyntheticTrace_t trace;
+        generate_trace(config, trace);
+        const uint64_t warp_records = trace.warp_records * options.iterations;
+        const uint64_t accesses = trace.active_lanes * options.iterations;
+
+        for (const BenchTool_t* tool : tools) {
+            if (tool->global_only && (pattern == TracePattern_SHARED_TILES || pattern == TracePattern_DEVICE_TABLE ||
+                                      pattern == TracePattern_REGISTER_SPILLS || pattern == TracePattern_SHARED_COLUMNS)) {
+                fprintf(report, "%-26s %-15s skipped, traces of device allocations only\n",
+                        tool->name, trace_pattern_name(pattern));
+                continue;
+            }
+            const size_t worker_runs = tool->uses_workers ? options.workers.size() : 1;
+            double base_seconds = 0;
+            for (size_t w = 0; w < worker_runs; w++) {
+                const uint32_t workers = options.workers[w];
+                setenv("YOSEMITE_WORKER_COUNT", std::to_string(workers).c_str(), 1);
+                const BenchResult_t result = run_case(*tool, trace, options);
+
+                if (w == 0) {
+                    base_seconds = result.data_seconds;
+                }
+                const double seconds = result.data_seconds > 0 ? result.data_seconds : 1e-9;
+                const double speedup = base_seconds / seconds;
+                const double ns_per_event = result.events ? result.event_seconds * 1e9 / result.events : 0;
+                fprintf(report, "%-26s %-15s %7u %10lu %12lu %10.1f %9.1f %9.0f %10.1f %7.2f\n",
+                        tool->name, trace_pattern_name(pattern), workers, warp_records, accesses,
+                        accesses / seconds / 1e6, seconds * 1e9 / warp_records, ns_per_event,
+                        result.peak_rss_kb / 1024.0, speedup);
+                fflush(report);
+                if (csv) {
+                    fprintf(csv, "%s,%s,%u,%lu,%lu,%.6f,%.0f,%.2f,%lu,%.1f,%lu,%.3f\n",
+                            tool->name, trace_pattern_name(pattern), workers, warp_records, accesses,
+                            result.data_seconds, accesses / seconds, seconds * 1e9 / warp_records,
+                            result.events, ns_per_event, result.peak_rss_kb, speedup);
+                    fflush(csv);
+                }
+            }
+        }
+    }
+
+    if (csv) {
+        fclose(csv);
+    }
+    fclose(report);
+    return 0;
+}
@@ -0,0 +1,286 @@
+#include "trace_generator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace yosemite {
+
+static constexpr uint64_t k_global_base = 0x7f0000000000ull;
+static constexpr uint64_t k_allocation_gap = 2ull << 20;
+static constexpr uint64_t k_device_table_base = 0x7e0000000000ull;  // below the allocations
+static constexpr uint32_t k_shared_tile_bytes = 16 * 1024;
+static constexpr uint32_t k_spill_slots = 16;
+static constexpr uint32_t k_max_resident_ctas = 256;
+static constexpr uint32_t k_flag_read = 0x1;
+static constexpr uint32_t k_flag_write = 0x2;
+static constexpr uint32_t k_flag_red = 0x3;
+
+static const char* k_pattern_names[TracePatternCount] = {
+    "coalesced",
+    "strided",
+    "random",
+    "shared_tiles",
+    "atomic_hotspot",
+    "many_ctas",
+    "skewed_ctas",
+    "device_table",
+    "register_spills",
+    "shared_columns",
+};
+
+
+const char* trace_pattern_name(TracePattern_t pattern) {
+    return pattern < TracePatternCount ? k_pattern_names[pattern] : "unknown";
+}
+
+
+bool trace_pattern_from_name(const std::string& name, TracePattern_t& pattern) {
+    for (uint32_t i = 0; i < TracePatternCount; i++) {
+        if (name == k_pattern_names[i]) {
+            pattern = static_cast<TracePattern_t>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// unique_address_mask keeps the first active lane of every distinct
+// address, as the pc dependency patch does.
+static void fill_masks(MemoryAccess& access) {
+    uint32_t unique_mask = 0;
+    uint32_t sector_count = 0;
+    for (uint32_t lane = 0; lane < GPU_WARP_SIZE; lane++) {
+        if (!(access.active_mask & (1u << lane))) {
+            continue;
+        }
+        bool new_address = true;
+        bool new_sector = true;
+        for (uint32_t prev = 0; prev < lane && (new_address || new_sector); prev++) {
+            if (!(access.active_mask & (1u << prev))) {
+                continue;
+            }
+            if (access.addresses[prev] == access.addresses[lane]) {
+                new_address = false;
+            }
+            if ((access.addresses[prev] >> 5) == (access.addresses[lane] >> 5)) {
+                new_sector = false;
+            }
+        }
+        if (new_address) {
+            unique_mask |= 1u << lane;
+        }
+        if (new_sector) {
+            sector_count++;
+        }
+    }
+    access.unique_address_mask = unique_mask;
+    access.distinct_sector_count = sector_count;
+}
+
+
+typedef struct CtaState {
+    uint32_t cta_id;
+    uint64_t records_per_warp;
+    uint64_t iteration;
+} CtaState_t;
+
+
+void generate_trace(const TraceConfig_t& config, SyntheticTrace_t& trace) {
+    std::mt19937_64 rng(config.seed);
+    const TracePattern_t pattern = config.pattern;
+    const uint32_t access_size = std::max(1u, config.access_size);
+
+    uint32_t ctas = std::max(1u, config.ctas);
+    uint32_t warps_per_cta = std::max(1u, config.warps_per_cta);
+    if (pattern == TracePattern_MANY_CTAS) {
+        ctas = static_cast<uint32_t>(std::max<uint64_t>(ctas, config.records / 4));
+        warps_per_cta = 1;
+    }
+    trace.grid_dim = ctas;
+    trace.block_dim = warps_per_cta * GPU_WARP_SIZE;
+
+    trace.allocations.clear();
+    const uint32_t allocation_count = std::max(1u, std::min<uint32_t>(config.allocations, MAX_NUM_MEMORY_RANGES));
+    for (uint32_t i = 0; i < allocation_count; i++) {
+        const uint64_t start = k_global_base + i * (config.allocation_size + k_allocation_gap);
+        trace.allocations.push_back({start, start + config.allocation_size});
+    }
+    const uint64_t words_per_allocation = std::max<uint64_t>(1, config.allocation_size / access_size);
+
+    // records per warp of every CTA; skewed CTAs follow 1/(rank+1)
+    std::vector<double> weights(ctas, 1.0);
+    if (pattern == TracePattern_SKEWED_CTAS) {
+        for (uint32_t c = 0; c < ctas; c++) {
+            weights[c] = 1.0 / (c + 1);
+        }
+        std::shuffle(weights.begin(), weights.end(), rng);
+    }
+    double weight_sum = 0;
+    for (double w : weights) {
+        weight_sum += w;
+    }
+    std::vector<CtaState_t> pending;
+    pending.reserve(ctas);
+    for (uint32_t c = 0; c < ctas; c++) {
+        const double share = static_cast<double>(config.records) * weights[c] / weight_sum / warps_per_cta;
+        pending.push_back({c, std::max<uint64_t>(1, static_cast<uint64_t>(share + 0.5)), 0});
+    }
+
+    trace.accesses.clear();
+    trace.accesses.reserve(config.records + static_cast<uint64_t>(ctas) * warps_per_cta + GPU_WARP_SIZE);
+    trace.warp_records = 0;
+    trace.active_lanes = 0;
+
+    const uint64_t grid_threads = static_cast<uint64_t>(ctas) * trace.block_dim;
+    std::vector<CtaState_t> resident;
+    size_t next_cta = 0;
+    while (next_cta < pending.size() || !resident.empty()) {
+        while (resident.size() < k_max_resident_ctas && next_cta < pending.size()) {
+            resident.push_back(pending[next_cta++]);
+        }
+
+        for (size_t r = 0; r < resident.size();) {
+            CtaState_t& cta = resident[r];
+            if (cta.iteration == cta.records_per_warp) {
+                // retire the CTA: one BlockExit per warp
+                for (uint32_t w = 0; w < warps_per_cta; w++) {
+                    MemoryAccess exit_record;
+                    memset(&exit_record, 0, sizeof(exit_record));
+                    exit_record.type = MemoryType::BlockExit;
+                    exit_record.ctaId = cta.cta_id;
+                    exit_record.warpId = w;
+                    exit_record.active_mask = 0xFFFFFFFFu;
+                    trace.accesses.push_back(exit_record);
+                }
+                resident[r] = resident.back();
+                resident.pop_back();
+                continue;
+            }
+
+            const uint64_t i = cta.iteration++;
+            const uint32_t pc_idx = static_cast<uint32_t>(i % std::max(1u, config.pcs));
+            for (uint32_t w = 0; w < warps_per_cta; w++) {
+                MemoryAccess access;
+                memset(&access, 0, sizeof(access));
+                access.pc = 0x1000 + pc_idx * 16;
+                access.flags = (pc_idx & 1) ? k_flag_write : k_flag_read;
+                access.accessSize = access_size;
+                access.active_mask = 0xFFFFFFFFu;
+                access.type = MemoryType::Global;
+                access.ctaId = cta.cta_id;
+                access.warpId = w;
+
+                const uint64_t warp_thread = (static_cast<uint64_t>(cta.cta_id) * warps_per_cta + w) * GPU_WARP_SIZE;
+                const MemoryRange& allocation = trace.allocations[(cta.cta_id + i) % trace.allocations.size()];
+                switch (pattern) {
+                    case TracePattern_COALESCED:
+                    case TracePattern_MANY_CTAS:
+                    case TracePattern_SKEWED_CTAS:
+                        for (uint32_t lane = 0; lane < GPU_WARP_SIZE; lane++) {
+                            const uint64_t word = (i * grid_threads + warp_thread + lane) % words_per_allocation;
+                            access.addresses[lane] = allocation.start + word * access_size;
+                        }
+                        break;
+                    case TracePattern_STRIDED:
+                        for (uint32_t lane = 0; lane < GPU_WARP_SIZE; lane++) {
+                            const uint64_t offset = ((warp_thread + lane) * config.stride + i * access_size)
+                                                    % (words_per_allocation * access_size);
+                            access.addresses[lane] = allocation.start + offset / access_size * access_size;
+                        }
+                        break;
+                    case TracePattern_RANDOM: {
+                        const MemoryRange& target = trace.allocations[rng() % trace.allocations.size()];
+                        access.active_mask = static_cast<uint32_t>(rng()) | 1u;
+                        for (uint32_t lane = 0; lane < GPU_WARP_SIZE; lane++) {
+                            access.addresses[lane] = target.start + (rng() % words_per_allocation) * access_size;
+                        }
+                        break;
+                    }
+                    case TracePattern_SHARED_TILES:
+                        access.type = MemoryType::Shared;
+                        for (uint32_t lane = 0; lane < GPU_WARP_SIZE; lane++) {
+                            const uint64_t word = (w * GPU_WARP_SIZE + lane + i * GPU_WARP_SIZE)
+                                                  % (k_shared_tile_bytes / access_size);
+                            access.addresses[lane] = word * access_size;
+                        }
+                        break;
+                    case TracePattern_ATOMIC_HOTSPOT:
+                        access.flags = k_flag_red;
+                        for (uint32_t lane = 0; lane < GPU_WARP_SIZE; lane++) {
+                            access.addresses[lane] = trace.allocations[0].start
+                                                     + (lane % std::max(1u, config.hot_words)) * access_size;
+                        }
+                        break;
+                    case TracePattern_DEVICE_TABLE: {
+                        const uint64_t table_words = std::max<uint64_t>(1, config.table_bytes / access_size);
+                        for (uint32_t lane = 0; lane < GPU_WARP_SIZE; lane++) {
+                            access.addresses[lane] = k_device_table_base + (rng() % table_words) * access_size;
+                        }
+                        break;
+                    }
+                    case TracePattern_SHARED_COLUMNS:
+                        access.type = MemoryType::Shared;
+                        for (uint32_t lane = 0; lane < GPU_WARP_SIZE; lane++) {
+                            const uint64_t word = (lane * GPU_WARP_SIZE + (w + i) % GPU_WARP_SIZE)
+                                                  % (k_shared_tile_bytes / access_size);
+                            access.addresses[lane] = word * access_size;
+                        }
+                        break;
+                    case TracePattern_REGISTER_SPILLS:
+                        // every lane spills to the same offset of its own local memory
+                        access.type = MemoryType::Local;
+                        access.flags = (i & 1) ? k_flag_read : k_flag_write;
+                        for (uint32_t lane = 0; lane < GPU_WARP_SIZE; lane++) {
+                            access.addresses[lane] = (i / 2 % k_spill_slots) * access_size;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                fill_masks(access);
+                trace.accesses.push_back(access);
+                trace.warp_records++;
+                trace.active_lanes += __builtin_popcount(access.active_mask);
+            }
+            r++;
+        }
+    }
+}
+
+
+void fill_tracker(const SyntheticTrace_t& trace, MemoryAccessState& access_state,
+                  TensorAccessState& tensor_state, MemoryAccessTracker& tracker) {
+    const uint32_t count = static_cast<uint32_t>(trace.allocations.size());
+    access_state.size = count;
+    tensor_state.size = count;
+    for (uint32_t i = 0; i < count; i++) {
+        access_state.start_end[i] = trace.allocations[i];
+        tensor_state.start_end[i] = trace.allocations[i];
+        access_state.touch[i] = 0;
+        tensor_state.touch[i] = 0;
+    }
+    uint64_t access_bytes = 0;
+    for (const MemoryAccess& access : trace.accesses) {
+        if (access.type != MemoryType::Global || access.active_mask == 0) {
+            continue;
+        }
+        const uint64_t address = access.addresses[__builtin_ctz(access.active_mask)];
+        for (uint32_t i = 0; i < count; i++) {
+            if (address >= trace.allocations[i].start && address < trace.allocations[i].end) {
+                access_state.touch[i] = 1;
+                tensor_state.touch[i] = 1;
+                break;
+            }
+        }
+        access_bytes += static_cast<uint64_t>(__builtin_popcount(access.active_mask)) * access.accessSize;
+    }
+    tracker.accessCount = trace.active_lanes;
+    tracker.accessSize = access_bytes;
+    tracker.access_state = &access_state;
+    tracker.tensor_access_state = &tensor_state;
+    tracker.access = const_cast<MemoryAccess*>(trace.accesses.data());
+}
+
+}   // yosemite
@@ -0,0 +1,70 @@
+#ifndef YOSEMITE_BENCH_TRACE_GENERATOR_H
+#define YOSEMITE_BENCH_TRACE_GENERATOR_H
+
+#include "gpu_patch.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace yosemite {
+
+/* Synthetic GPU trace buffers for the bench.
+
+Records are laid out the way the pc dependency patch emits them: warps of
+all resident CTAs interleaved, unique_address_mask and distinct_sector_count
+filled in, and one BlockExit record per warp when its CTA retires.
+*/
+
+typedef enum {
+    TracePattern_COALESCED = 0,     // consecutive lanes, consecutive words
+    TracePattern_STRIDED = 1,       // one sector per lane
+    TracePattern_RANDOM = 2,        // uniform over the allocations
+    TracePattern_SHARED_TILES = 3,  // shared memory tiles, reused per CTA
+    TracePattern_ATOMIC_HOTSPOT = 4,// all lanes on a handful of words
+    TracePattern_MANY_CTAS = 5,     // one warp per CTA, short CTAs
+    TracePattern_SKEWED_CTAS = 6,   // few CTAs own most of the warps
+    TracePattern_DEVICE_TABLE = 7,  // lookups into a __device__ table outside the allocations
+    TracePattern_REGISTER_SPILLS = 8,   // local memory stores, each reloaded by the next record
+    TracePattern_SHARED_COLUMNS = 9,    // column walks of an unpadded shared tile, 32-way bank conflicts
+    TracePatternCount = 10,
+} TracePattern_t;
+
+const char* trace_pattern_name(TracePattern_t pattern);
+
+bool trace_pattern_from_name(const std::string& name, TracePattern_t& pattern);
+
+typedef struct TraceConfig {
+    TracePattern_t pattern = TracePattern_COALESCED;
+    uint64_t records = 1 << 20;         // warp records, block exits not included
+    uint32_t ctas = 1024;
+    uint32_t warps_per_cta = 8;
+    uint32_t access_size = 4;
+    uint32_t stride = 128;
+    uint32_t pcs = 64;
+    uint32_t allocations = 16;
+    uint64_t allocation_size = 64ull << 20;
+    uint32_t hot_words = 4;
+    uint32_t table_bytes = 64 * 1024;
+    uint64_t seed = 1;
+} TraceConfig_t;
+
+typedef struct SyntheticTrace {
+    std::vector<MemoryAccess> accesses;
+    std::vector<MemoryRange> allocations;
+    uint32_t block_dim = 0;
+    uint32_t grid_dim = 0;
+    uint64_t warp_records = 0;
+    uint64_t active_lanes = 0;
+} SyntheticTrace_t;
+
+void generate_trace(const TraceConfig_t& config, SyntheticTrace_t& trace);
+
+// Fills the range-touch summaries the tracker patches produce
+// (app_metric, app_analysis, uvm_advisor, roofline_size).
+void fill_tracker(const SyntheticTrace_t& trace, MemoryAccessState& access_state,
+                  TensorAccessState& tensor_state, MemoryAccessTracker& tracker);
+
+}   // yosemite
+
+#endif // YOSEMITE_BENCH_TRACE_GENERATOR_H
@@ -9,9 +9,13 @@ typedef enum {
     YOSEMITE_SUCCESS = 0,
     YOSEMITE_ERROR = 1,
     YOSEMITE_NOT_IMPLEMENTED = 2,
-    YOSEMITE_CUDA_MEMFREE_ZERO = 3
+    YOSEMITE_CUDA_MEMFREE_ZERO = 3,
+    YOSEMITE_PENDING = 4
 } YosemiteResult_t;
 
+// Completion token for yosemite_gpu_data_analysis_async; 0 is always complete.
+typedef uint64_t YosemiteToken_t;
+
 
 typedef enum {
     GPU_NO_PATCH = 0,
@@ -38,6 +42,13 @@ typedef struct AccelProfOptions {
     bool torch_prof_enabled = false;
     uint64_t grid_launch_id = 0;
     uint32_t sample_rate = 1;
+    // Set by yosemite_kernel_start_callback for every launch: false when the
+    // kernel filters (YOSEMITE_KERNEL_*) skip it, so it should run unpatched.
+    // One field serves all threads: read it on the launching thread right
+    // after its kernel_start call returns, before that thread launches again,
+    // and only when launches on other threads cannot interleave with that
+    // read (e.g. under the frontend's launch lock).
+    bool kernel_selected = true;
 
     AccelProfOptions() = default;
     ~AccelProfOptions() = default;
@@ -65,8 +76,26 @@ YosemiteResult_t yosemite_kernel_start_callback(
 
 YosemiteResult_t yosemite_kernel_end_callback(std::string kernel_name, int device_id);
 
+// Buffer of the device of the calling thread's last kernel launch.
 YosemiteResult_t yosemite_gpu_data_analysis(void* data, uint64_t size);
 
+// device_id -1 stands for the device of the calling thread's last kernel launch.
+YosemiteResult_t yosemite_gpu_data_analysis(void* data, uint64_t size, int device_id);
+
+// Leases `data` to the analyzer and returns without waiting for the tools.
+// The buffer must not be refilled until its token completes. Falls back to
+// the synchronous path (token 0) unless YOSEMITE_ASYNC_GPU_DATA=1 or
+// YOSEMITE_DEVICE_SHARDS=1.
+YosemiteResult_t yosemite_gpu_data_analysis_async(void* data, uint64_t size, YosemiteToken_t* token);
+
+YosemiteResult_t yosemite_gpu_data_analysis_async(void* data, uint64_t size, YosemiteToken_t* token,
+                                                  int device_id);
+
+// YOSEMITE_SUCCESS once the buffer behind `token` may be reused, YOSEMITE_PENDING otherwise.
+YosemiteResult_t yosemite_gpu_data_poll(YosemiteToken_t token);
+
+YosemiteResult_t yosemite_gpu_data_wait(YosemiteToken_t token);
+
 YosemiteResult_t yosemite_init(AccelProfOptions_t& options);
 
 YosemiteResult_t yosemite_terminate();
@@ -19,8 +19,6 @@ public:
 
     ~AppAnalysis();
 
-    void evt_callback(EventPtr_t evt);
-
     void gpu_data_analysis(void* data, uint64_t size);
 
     void query_ranges(void* ranges, uint32_t limit, uint32_t* count);
@@ -30,28 +28,24 @@ public:
     void flush();
 
 private :
-    void init();
-
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
-
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
-
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_KERNEL_LAUNCH) | event_bit(EventType_KERNEL_END) |
+        event_bit(EventType_MEM_ALLOC) | event_bit(EventType_MEM_FREE) |
+        event_bit(EventType_TEN_ALLOC) | event_bit(EventType_TEN_FREE);
 
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
-
-    void mem_cpy_callback(std::shared_ptr<MemCpy_t> mem);
+    void init();
 
-    void mem_set_callback(std::shared_ptr<MemSet_t> mem);
+    void kernel_start_callback(const EventRecord_t& record) override;
 
-    void ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten);
+    void kernel_end_callback(const EventRecord_t& record) override;
 
-    void ten_free_callback(std::shared_ptr<TenFree_t> ten);
+    void mem_alloc_callback(const EventRecord_t& record) override;
 
-    void op_start_callback(std::shared_ptr<OpStart_t> op);
+    void mem_free_callback(const EventRecord_t& record) override;
 
-    void op_end_callback(std::shared_ptr<OpEnd_t> op);
+    void ten_alloc_callback(const EventRecord_t& record) override;
 
+    void ten_free_callback(const EventRecord_t& record) override;
 
 /*
 ********************************* variables *********************************
@@ -89,10 +83,6 @@ private :
         uint64_t free_size = 0;
     };
     TenStats ten_stats;
-
-    // for overhead comparison
-    int max_num_kernel_monitored = -1;
-
 };  
 
 }   // yosemite
@@ -4,6 +4,7 @@
 
 #include "tools/tool.h"
 #include "utils/event.h"
+#include "utils/interval_index.h"
 
 #include <map>
 #include <vector>
@@ -21,8 +22,6 @@ public:
 
     ~AppAnalysisCPU();
 
-    void evt_callback(EventPtr_t evt);
-
     void gpu_data_analysis(void* data, uint64_t size);
 
     void query_ranges(void* ranges, uint32_t limit, uint32_t* count);
@@ -32,31 +31,25 @@ public:
     void flush();
 
 private :
-    void init();
-
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
-
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_KERNEL_LAUNCH) | event_bit(EventType_KERNEL_END) |
+        event_bit(EventType_MEM_ALLOC) | event_bit(EventType_MEM_FREE) |
+        event_bit(EventType_TEN_ALLOC) | event_bit(EventType_TEN_FREE);
 
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
-
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
-
-    void mem_cpy_callback(std::shared_ptr<MemCpy_t> mem);
+    void init();
 
-    void mem_set_callback(std::shared_ptr<MemSet_t> mem);
+    void kernel_start_callback(const EventRecord_t& record) override;
 
-    void ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten);
+    void kernel_end_callback(const EventRecord_t& record) override;
 
-    void ten_free_callback(std::shared_ptr<TenFree_t> ten);
+    void mem_alloc_callback(const EventRecord_t& record) override;
 
-    void op_start_callback(std::shared_ptr<OpStart_t> op);
+    void mem_free_callback(const EventRecord_t& record) override;
 
-    void op_end_callback(std::shared_ptr<OpEnd_t> op);
+    void ten_alloc_callback(const EventRecord_t& record) override;
 
-    std::shared_ptr<MemAlloc_t> query_memory_ranges_cpu(uint64_t ptr);
+    void ten_free_callback(const EventRecord_t& record) override;
 
-    std::shared_ptr<TenAlloc_t> query_tensor_ranges_cpu(uint64_t ptr);
 
 /*
 ********************************* variables *********************************
@@ -64,10 +57,12 @@ private :
 
     Timer_t _timer;
 
-    std::map<DevPtr, std::shared_ptr<MemAlloc_t>> active_memories;
+    IntervalIndex memory_index;
+    std::vector<std::shared_ptr<MemAlloc_t>> active_memories;   // by memory_index id
     std::set<std::shared_ptr<MemAlloc_t>> touched_memories;
 
-    std::map<DevPtr, std::shared_ptr<TenAlloc_t>> active_tensors;
+    IntervalIndex tensor_index;
+    std::vector<std::shared_ptr<TenAlloc_t>> active_tensors;    // by tensor_index id
     std::set<std::shared_ptr<TenAlloc_t>> touched_tensors;
 
     struct KernelStats {
@@ -96,8 +91,6 @@ private :
         uint64_t free_size = 0;
     };
     TenStats ten_stats;
-
-    int max_num_kernel_monitored = -1;
 };  
 
 }   // yosemite
@@ -4,6 +4,7 @@
 
 #include "tools/tool.h"
 #include "utils/event.h"
+#include "utils/interval_index.h"
 
 #include <map>
 #include <vector>
@@ -21,8 +22,6 @@ public:
 
     ~AppAnalysisNVBIT();
 
-    void evt_callback(EventPtr_t evt);
-
     void gpu_data_analysis(void* data, uint64_t size);
 
     void query_ranges(void* ranges, uint32_t limit, uint32_t* count);
@@ -32,31 +31,24 @@ public:
     void flush();
 
 private :
-    void init();
-
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
-
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
-
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_KERNEL_LAUNCH) | event_bit(EventType_KERNEL_END) |
+        event_bit(EventType_MEM_ALLOC) | event_bit(EventType_MEM_FREE) |
+        event_bit(EventType_TEN_ALLOC) | event_bit(EventType_TEN_FREE);
 
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
-
-    void mem_cpy_callback(std::shared_ptr<MemCpy_t> mem);
-
-    void mem_set_callback(std::shared_ptr<MemSet_t> mem);
+    void init();
 
-    void ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten);
+    void kernel_start_callback(const EventRecord_t& record) override;
 
-    void ten_free_callback(std::shared_ptr<TenFree_t> ten);
+    void kernel_end_callback(const EventRecord_t& record) override;
 
-    void op_start_callback(std::shared_ptr<OpStart_t> op);
+    void mem_alloc_callback(const EventRecord_t& record) override;
 
-    void op_end_callback(std::shared_ptr<OpEnd_t> op);
+    void mem_free_callback(const EventRecord_t& record) override;
 
-    std::shared_ptr<MemAlloc_t> query_memory_ranges_cpu(uint64_t ptr, uint64_t grid_launch_id);
+    void ten_alloc_callback(const EventRecord_t& record) override;
 
-    std::shared_ptr<TenAlloc_t> query_tensor_ranges_cpu(uint64_t ptr, uint64_t grid_launch_id);
+    void ten_free_callback(const EventRecord_t& record) override;
 
     void kernel_grid_launch_id_transition();
 
@@ -66,15 +58,17 @@ private :
 
     Timer_t _timer;
 
-    using active_mem_map = std::map<DevPtr, std::shared_ptr<MemAlloc_t>>;
-    active_mem_map active_memories;
+    // live allocations, indexed by address; ids index the payload tables
+    struct ActiveAllocs {
+        IntervalIndex memory_index;
+        std::vector<std::shared_ptr<MemAlloc_t>> memories;
+        IntervalIndex tensor_index;
+        std::vector<std::shared_ptr<TenAlloc_t>> tensors;
+    };
+    ActiveAllocs active_allocs;
+    std::map<uint64_t, ActiveAllocs> active_allocs_per_kernel_snapshot;
     std::set<std::shared_ptr<MemAlloc_t>> touched_memories;
-    std::map<uint64_t, active_mem_map> active_memories_per_kernel_snapshot;
-
-    using active_ten_map = std::map<DevPtr, std::shared_ptr<TenAlloc_t>>;
-    active_ten_map active_tensors;
     std::set<std::shared_ptr<TenAlloc_t>> touched_tensors;
-    std::map<uint64_t, active_ten_map> active_tensors_per_kernel_snapshot;
 
     struct KernelStats {
         std::shared_ptr<KernelLaunch_t> kernel_launch;
@@ -10,12 +10,10 @@ namespace yosemite {
 
 class AppMetrics final : public Tool {
 public:
-    AppMetrics() : Tool(APP_METRICE) {}
+    AppMetrics() : Tool(APP_METRICE, k_event_mask) {}
 
     ~AppMetrics() {}
 
-    void evt_callback(EventPtr_t evt);
-
     void gpu_data_analysis(void* data, uint64_t size);
 
     void query_ranges(void* ranges, uint32_t limit, uint32_t* count);
@@ -25,13 +23,15 @@ public:
     void flush();
 
 private:
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_KERNEL_LAUNCH) | event_bit(EventType_MEM_ALLOC) |
+        event_bit(EventType_MEM_FREE);
 
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
+    void kernel_start_callback(const EventRecord_t& record) override;
 
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
+    void mem_alloc_callback(const EventRecord_t& record) override;
 
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
+    void mem_free_callback(const EventRecord_t& record) override;
 
 
 /*
@@ -10,14 +10,12 @@ namespace yosemite {
 
 class CodeCheck final : public Tool {
 public:
-    CodeCheck() : Tool(CODE_CHECK) {
+    CodeCheck() : Tool(CODE_CHECK, k_event_mask) {
         init();
     }
 
     ~CodeCheck() {}
 
-    void evt_callback(EventPtr_t evt);
-
     void gpu_data_analysis(void* data, uint64_t size) override {};
 
     void query_ranges(void* ranges, uint32_t limit, uint32_t* count) override {};
@@ -27,28 +25,32 @@ public:
     void flush();
 
 private:
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_KERNEL_LAUNCH) | event_bit(EventType_MEM_ALLOC) |
+        event_bit(EventType_MEM_FREE) | event_bit(EventType_MEM_COPY) |
+        event_bit(EventType_MEM_SET) | event_bit(EventType_TEN_ALLOC) |
+        event_bit(EventType_TEN_FREE) | event_bit(EventType_OP_START) |
+        event_bit(EventType_OP_END);
 
     void init();
 
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
-
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
+    void kernel_start_callback(const EventRecord_t& record) override;
 
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
+    void mem_alloc_callback(const EventRecord_t& record) override;
 
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
+    void mem_free_callback(const EventRecord_t& record) override;
 
-    void mem_cpy_callback(std::shared_ptr<MemCpy_t> mem);
+    void mem_cpy_callback(const EventRecord_t& record) override;
 
-    void mem_set_callback(std::shared_ptr<MemSet_t> mem);
+    void mem_set_callback(const EventRecord_t& record) override;
 
-    void ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten);
+    void ten_alloc_callback(const EventRecord_t& record) override;
 
-    void ten_free_callback(std::shared_ptr<TenFree_t> ten);
+    void ten_free_callback(const EventRecord_t& record) override;
 
-    void op_start_callback(std::shared_ptr<OpStart_t> op);
+    void op_start_callback(const EventRecord_t& record) override;
 
-    void op_end_callback(std::shared_ptr<OpEnd_t> op);
+    void op_end_callback(const EventRecord_t& record) override;
 
 
 /*
@@ -12,32 +12,39 @@ namespace yosemite {
 
 class MemTrace final : public Tool {
 public:
-    MemTrace();
+    MemTrace(const std::string& shard_directory = "");
 
     ~MemTrace();
 
-    void gpu_data_analysis(void* data, uint64_t size);
+    std::shared_ptr<Tool> make_shard(int device_id, uint32_t device_count) override;
+
+    void gpu_data_analysis(void* data, uint64_t size) override {};
+
+    void gpu_trace_analysis(const AccessBatch_t& batch) override;
 
     void query_ranges(void* ranges, uint32_t limit, uint32_t* count) override {};
 
     void query_tensors(void* ranges, uint32_t limit, uint32_t* count) override {};
 
-    void evt_callback(EventPtr_t evt);
-
     void flush();
 
 private:
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_KERNEL_LAUNCH) | event_bit(EventType_KERNEL_END) |
+        event_bit(EventType_MEM_ALLOC) | event_bit(EventType_MEM_FREE) |
+        event_bit(EventType_TEN_ALLOC) | event_bit(EventType_TEN_FREE);
+
+    void kernel_start_callback(const EventRecord_t& record) override;
 
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
+    void kernel_end_callback(const EventRecord_t& record) override;
 
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
+    void mem_alloc_callback(const EventRecord_t& record) override;
 
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
+    void mem_free_callback(const EventRecord_t& record) override;
 
-    void ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten);
+    void ten_alloc_callback(const EventRecord_t& record) override;
 
-    void ten_free_callback(std::shared_ptr<TenFree_t> ten);
+    void ten_free_callback(const EventRecord_t& record) override;
 
     void kernel_trace_flush(std::shared_ptr<KernelLaunch_t> kernel);
 
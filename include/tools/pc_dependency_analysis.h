@@ -5,6 +5,7 @@
 #include "tools/tool.h"
 #include "utils/event.h"
 #include "gpu_patch.h"
+#include "utils/dependency_graph.h"
 #include "parallel_hashmap/phmap.h"
 
 #include <map>
@@ -17,47 +18,19 @@
 #include <string>
 #include <memory>
 #include <cassert>
+#include <atomic>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
+#include <deque>
 #include <cstring>
+#include <limits>
+#include <tuple>
 #include <sys/mman.h>
 
 constexpr uint32_t shared_memory_upper_bound = 108*1024;
 
 
-#ifndef SANITIZER_MEMORY_DEVICE_FLAG_READ
-#define SANITIZER_MEMORY_DEVICE_FLAG_READ 0x1
-#endif
-
-#ifndef SANITIZER_MEMORY_DEVICE_FLAG_WRITE
-#define SANITIZER_MEMORY_DEVICE_FLAG_WRITE 0x2
-#endif
-
-#ifndef SANITIZER_MEMORY_DEVICE_FLAG_RED
-#define SANITIZER_MEMORY_DEVICE_FLAG_RED 0x3
-#endif
-
-#ifndef SANITIZER_MEMORY_DEVICE_FLAG_ATOMIC
-#define SANITIZER_MEMORY_DEVICE_FLAG_ATOMIC 0x4
-#endif
-
-#ifndef SANITIZER_MEMORY_DEVICE_FLAG_PREFETCH
-#define SANITIZER_MEMORY_DEVICE_FLAG_PREFETCH 0x8
-#endif
-
-#ifndef SANITIZER_MEMORY_GLOBAL
-#define SANITIZER_MEMORY_GLOBAL 0x10
-#endif
-
-#ifndef SANITIZER_MEMORY_SHARED
-#define SANITIZER_MEMORY_SHARED 0x20
-#endif
-
-#ifndef SANITIZER_MEMORY_LOCAL
-#define SANITIZER_MEMORY_LOCAL 0x40
-#endif
-
 namespace yosemite {
 
 /* we choose to use PC offset instead of PC because the PC is too long for shadow memory and it is not necessary to track the original PC.
@@ -131,61 +104,723 @@ public:
     uint32_t generation = 0;     // kernel generation
 };
 
+class local_shadow_memory_entry{
+public:
+    uint32_t pc_offset = 0;     // last store
+    uint32_t time = 0;          // record of the last store in the kernel trace
+};
+
+/* Local memory of the threads of one CTA: (warp:lane << 32 | local address)
+-> last store. Local addresses are offsets in the thread's local window, so
+they are the same in every thread and only make sense with the thread id.
+Holds the stores of register spills until the CTA exits. */
+class local_shadow_memory{
+public:
+    phmap::flat_hash_map<uint64_t, local_shadow_memory_entry> entries;
+    uint32_t active_threads = 0;
+};
+
+/* Resident bytes of the shadow memories of one tool instance against the
+YOSEMITE_SHADOW_BUDGET_MB budget. A chunk reserves its bytes before it is
+mapped and gives up when the reservation would exceed the budget, so the
+resident shadow never grows past it, even within a batch. */
+class shadow_budget{
+public:
+    void set_limit(uint64_t limit) { _limit = limit; }
+    bool reserve(uint64_t bytes) {
+        // a full budget refuses without touching the shared counter
+        if (_limit != 0 && _resident.load(std::memory_order_relaxed) + bytes > _limit) {
+            refuse();
+            return false;
+        }
+        const uint64_t resident = _resident.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        if (_limit != 0 && resident > _limit) {
+            _resident.fetch_sub(bytes, std::memory_order_relaxed);
+            refuse();
+            return false;
+        }
+        return true;
+    }
+    void release(uint64_t bytes) {
+        _resident.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    uint64_t limit() const { return _limit; }
+    uint64_t resident() const { return _resident.load(std::memory_order_relaxed); }
+    // whether a chunk was refused since the last call
+    bool take_refused() { return _refused.exchange(false, std::memory_order_relaxed); }
+
+private:
+    void refuse() {
+        if (!_refused.load(std::memory_order_relaxed)) {
+            _refused.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t _limit = 0;    // 0: unlimited
+    std::atomic<uint64_t> _resident{0};
+    std::atomic<bool> _refused{false};
+};
+
+
+/* Shadow memory of one allocation, one entry per `granularity` bytes
+(YOSEMITE_SHADOW_GRANULARITY: 1, 4, 8, 16 or 32). Granularity 1 keeps an
+entry for every byte although accesses are only sampled every 4 bytes;
+coarser granularities shrink the shadow by that factor, at the price of
+merging accesses to the same word or sector.
+
+Entries live in chunks of 2^chunk_bits entries that are mapped on first
+touch, so the resident shadow follows the part of the allocation kernels
+actually use rather than its reserved size. The chunk directory is an
+array of atomic pointers; workers racing on a new chunk keep the first one
+published. A chunk that does not fit in the budget is not mapped and
+get_entry() returns null.
+
+Each chunk records the stamp of the last batch that touched it so the
+owner can evict the least recently used chunks under the budget. An
+evicted chunk is unmapped; when `lossy`, it is flagged so that entries it
+comes back with read as lost rather than cold until forget_evictions().
+
+With `times`, a chunk also holds the logical time of each entry's last
+write (YOSEMITE_REUSE_TIME_HISTOGRAM), after its entries. */
 class shadow_memory{
 public:
-    shadow_memory(uint64_t size) 
+    static constexpr uint32_t k_max_chunk_bits = 16;    // 64K entries, 512KB per chunk
+
+    shadow_memory(uint64_t size, shadow_budget& budget, uint32_t granularity = 1, bool times = false,
+                  uint32_t chunk_bits = k_max_chunk_bits)
     :_size(size),
-    _size_celled((size + 3) / 4 * 4),
+    _granularity_shift(__builtin_ctz(granularity)),
+    _size_celled(granularity == 1 ? (size + 3) / 4 * 4 : (size + granularity - 1) >> _granularity_shift),
     _stride(_size_celled / 4),
-    _entries_bytes(std::max<uint64_t>(1, _size_celled * sizeof(shadow_memory_entry))) {
-        _shadow_memory_entries = static_cast<shadow_memory_entry*>(
-            mmap(nullptr, _entries_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
-        );
-        assert(_shadow_memory_entries != MAP_FAILED);
+    _time_bytes(times ? sizeof(uint32_t) : 0),
+    _entries_bytes(std::max<uint64_t>(1, _size_celled * (sizeof(shadow_memory_entry) + _time_bytes))),
+    _chunk_bits(chunk_bits),
+    _chunk_entries(1ull << chunk_bits),
+    _chunk_count(std::max<uint64_t>(1, (_size_celled + _chunk_entries - 1) >> chunk_bits)),
+    _budget(budget),
+    _chunks(new std::atomic<shadow_memory_entry*>[_chunk_count]),
+    _chunk_last_use(new std::atomic<uint32_t>[_chunk_count]),
+    _chunk_lossy(new std::atomic<bool>[_chunk_count]) {
+        for (uint64_t chunk = 0; chunk < _chunk_count; chunk++) {
+            _chunks[chunk].store(nullptr, std::memory_order_relaxed);
+            _chunk_last_use[chunk].store(0, std::memory_order_relaxed);
+            _chunk_lossy[chunk].store(false, std::memory_order_relaxed);
+        }
 
-        printf("[PC_DEPENDENCY] Shadow memory entries: %lu\n", size);
+        printf("[PC_DEPENDENCY] Shadow memory entries: %lu\n", _size_celled);
         printf("[PC_DEPENDENCY] Shadow memory per entry size: %lu\n", sizeof(shadow_memory_entry));
-        printf("[PC_DEPENDENCY] Shadow memory size: %lu\n", size*sizeof(shadow_memory_entry));
+        printf("[PC_DEPENDENCY] Shadow memory size: %lu (%lu chunks, mapped on first touch)\n", _entries_bytes, _chunk_count);
       };
     ~shadow_memory() {
-        if (_shadow_memory_entries != nullptr && _shadow_memory_entries != MAP_FAILED) {
-            munmap(_shadow_memory_entries, _entries_bytes);
-            _shadow_memory_entries = nullptr;
+        for (uint64_t chunk = 0; chunk < _chunk_count; chunk++) {
+            shadow_memory_entry* entries = _chunks[chunk].load(std::memory_order_relaxed);
+            if (entries != nullptr) {
+                munmap(entries, chunk_bytes(chunk));
+            }
         }
+        _budget.release(_resident_bytes.load(std::memory_order_relaxed));
     }
     void reset_entries() {
-        if (madvise(_shadow_memory_entries, _entries_bytes, MADV_DONTNEED) != 0) {
-            std::memset(_shadow_memory_entries, 0, _entries_bytes);
+        for (uint64_t chunk = 0; chunk < _chunk_count; chunk++) {
+            shadow_memory_entry* entries = _chunks[chunk].load(std::memory_order_relaxed);
+            if (entries != nullptr && madvise(entries, chunk_bytes(chunk), MADV_DONTNEED) != 0) {
+                std::memset(entries, 0, chunk_bytes(chunk));
+            }
         }
     };
-    shadow_memory_entry& get_entry(uint64_t offset) {
+    // `stamp` is recorded as the chunk's last use. `lossy` is set when the
+    // chunk came back after a lossy eviction, so a zero entry was lost rather
+    // than never written. `time` receives the entry's time slot, when the
+    // shadow keeps times. Null when the chunk does not fit in the budget.
+    shadow_memory_entry* get_entry(uint64_t offset, uint32_t stamp = 0, bool* lossy = nullptr,
+                                   uint32_t** time = nullptr) {
         assert(offset < _size);
-        //update layout: use offset/4 + offset%4 * _size/4 to make every 4 bytes adjacent in one cache line
-        return _shadow_memory_entries[(offset/4) + (offset%4) * _stride];
-        // return _shadow_memory_entries[offset];
+        uint64_t index;
+        if (_granularity_shift != 0) {
+            index = offset >> _granularity_shift;
+        } else {
+            //update layout: use offset/4 + offset%4 * _size/4 to make every 4 bytes adjacent in one cache line
+            index = (offset/4) + (offset%4) * _stride;
+        }
+        const uint64_t chunk = index >> _chunk_bits;
+        shadow_memory_entry* entries = _chunks[chunk].load(std::memory_order_acquire);
+        if (entries == nullptr) {
+            entries = materialize_chunk(chunk);
+            if (entries == nullptr) {
+                return nullptr;
+            }
+        }
+        if (_chunk_last_use[chunk].load(std::memory_order_relaxed) != stamp) {
+            _chunk_last_use[chunk].store(stamp, std::memory_order_relaxed);
+        }
+        if (lossy != nullptr) {
+            *lossy = _chunk_lossy[chunk].load(std::memory_order_relaxed);
+        }
+        if (time != nullptr) {
+            *time = reinterpret_cast<uint32_t*>(entries + chunk_entries(chunk)) + (index & (_chunk_entries - 1));
+        }
+        return &entries[index & (_chunk_entries - 1)];
+    }
+    uint64_t touched_chunks() const {
+        return _touched_chunks.load(std::memory_order_relaxed);
+    }
+    uint64_t resident_bytes() const {
+        return _resident_bytes.load(std::memory_order_relaxed);
+    }
+    bool chunk_mapped(uint64_t chunk) const {
+        return _chunks[chunk].load(std::memory_order_relaxed) != nullptr;
+    }
+    uint32_t chunk_last_use(uint64_t chunk) const {
+        return _chunk_last_use[chunk].load(std::memory_order_relaxed);
+    }
+    // Only while no worker runs. Returns the bytes released.
+    uint64_t evict_chunk(uint64_t chunk, bool lossy) {
+        shadow_memory_entry* entries = _chunks[chunk].load(std::memory_order_relaxed);
+        if (entries == nullptr) {
+            return 0;
+        }
+        const uint64_t bytes = chunk_bytes(chunk);
+        munmap(entries, bytes);
+        _chunks[chunk].store(nullptr, std::memory_order_relaxed);
+        if (lossy) {
+            _chunk_lossy[chunk].store(true, std::memory_order_relaxed);
+        }
+        _resident_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        _budget.release(bytes);
+        return bytes;
+    }
+    // Chunks evicted during an earlier kernel hold nothing the next one can
+    // tell apart from a cold miss. Only while no worker runs.
+    void forget_evictions() {
+        for (uint64_t chunk = 0; chunk < _chunk_count; chunk++) {
+            _chunk_lossy[chunk].store(false, std::memory_order_relaxed);
+        }
     }
     uint64_t _size;
-    uint64_t _size_celled;
+    uint32_t _granularity_shift;
+    uint64_t _size_celled;     // entries
     uint64_t _stride;
+    uint64_t _time_bytes;       // per entry, 0 without times
     uint64_t _entries_bytes;
-    shadow_memory_entry* _shadow_memory_entries = nullptr;
+    uint32_t _chunk_bits;
+    uint64_t _chunk_entries;
+    uint64_t _chunk_count;
+
+private:
+    uint64_t chunk_entries(uint64_t chunk) const {
+        return std::min(_chunk_entries, _size_celled - (chunk << _chunk_bits));
+    }
+    uint64_t chunk_bytes(uint64_t chunk) const {
+        return chunk_entries(chunk) * (sizeof(shadow_memory_entry) + _time_bytes);
+    }
+    shadow_memory_entry* materialize_chunk(uint64_t chunk) {
+        const uint64_t bytes = chunk_bytes(chunk);
+        if (!_budget.reserve(bytes)) {
+            return nullptr;
+        }
+        shadow_memory_entry* entries = static_cast<shadow_memory_entry*>(
+            mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+        );
+        assert(entries != MAP_FAILED);
+        shadow_memory_entry* expected = nullptr;
+        if (!_chunks[chunk].compare_exchange_strong(expected, entries, std::memory_order_acq_rel)) {
+            munmap(entries, bytes);
+            _budget.release(bytes);
+            return expected;
+        }
+        if (!_chunk_lossy[chunk].load(std::memory_order_relaxed)) {
+            _touched_chunks.fetch_add(1, std::memory_order_relaxed);
+        }
+        _resident_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        return entries;
+    }
+
+    shadow_budget& _budget;
+    std::unique_ptr<std::atomic<shadow_memory_entry*>[]> _chunks;
+    std::unique_ptr<std::atomic<uint32_t>[]> _chunk_last_use;   // batch stamp
+    std::unique_ptr<std::atomic<bool>[]> _chunk_lossy;          // evicted while in use by this kernel
+    std::atomic<uint64_t> _touched_chunks{0};
+    std::atomic<uint64_t> _resident_bytes{0};
+};
+
+
+/* Radix page table from device address to shadow memory.
+
+Addresses are split into 64KB pages; the top level is indexed by addr >> 32
+and each leaf by the 16 page bits below, so a translation is two dependent
+loads. A page entry holds the shadow memory and start of the only region
+touching the page. Pages shared by several regions (small allocations)
+are marked mixed and resolved through the region map instead. Entries are
+only written from the alloc/free callbacks, never while workers run.
+*/
+class shadow_page_entry{
+public:
+    static constexpr uint64_t k_mixed = 1;
+    shadow_memory* shadow = nullptr;
+    uint64_t start = 0;     // region start, k_mixed on pages of several regions (shadow is null then)
+};
+
+class shadow_page_table{
+public:
+    static constexpr uint32_t k_page_bits = 16;
+    static constexpr uint32_t k_leaf_bits = 16;
+    static constexpr uint32_t k_address_bits = 49;
+    static constexpr uint64_t k_leaf_entries = 1ull << k_leaf_bits;
+    static constexpr uint64_t k_top_entries = 1ull << (k_address_bits - k_page_bits - k_leaf_bits);
+
+    shadow_page_table() : _top(k_top_entries, empty_leaf()) {};
+
+    const shadow_page_entry& lookup(uint64_t addr) const {
+        const uint64_t top = addr >> (k_page_bits + k_leaf_bits);
+        if (top >= k_top_entries) {
+            return mixed_entry();
+        }
+        return _top[top][(addr >> k_page_bits) & (k_leaf_entries - 1)];
+    };
+
+    // Pages beyond the address bits are left alone; lookup reports them mixed.
+    void set(uint64_t page, shadow_memory* shadow, uint64_t start) {
+        const uint64_t top = page >> k_leaf_bits;
+        if (top >= k_top_entries) {
+            return;
+        }
+        if (_top[top] == empty_leaf()) {
+            _leaves.emplace_back(new shadow_page_entry[k_leaf_entries]);
+            _top[top] = _leaves.back().get();
+        }
+        shadow_page_entry& entry = _top[top][page & (k_leaf_entries - 1)];
+        entry.shadow = shadow;
+        entry.start = start;
+    };
+
+private:
+    static shadow_page_entry* empty_leaf() {
+        static shadow_page_entry leaf[k_leaf_entries];
+        return leaf;
+    };
+    static const shadow_page_entry& mixed_entry() {
+        static const shadow_page_entry entry = {nullptr, shadow_page_entry::k_mixed};
+        return entry;
+    };
+
+    std::vector<shadow_page_entry*> _top;
+    std::vector<std::unique_ptr<shadow_page_entry[]>> _leaves;
 };
 
 
+/* Shadow of global addresses outside every tracked allocation (static
+__device__ variables, VMM mappings), keyed by absolute sampled address.
+
+A lock-free open-addressing table of 24-byte slots: a key word holding
+(epoch << 55 | address), the packed shadow entry of shadow_memory_entry and
+the time of its last write, as in shadow_memory.
+Slots whose epoch is not the current one are empty, so set_epoch() clears
+the table in O(1); within an epoch keys are only claimed, with a CAS, and
+never removed, which keeps linear probing correct without locks. The entry
+itself is swapped with one atomic exchange.
+
+Slots live in mmap'ed segments. A probe that finds neither its key nor an
+empty slot within k_probe_limit slots moves on to the next segment, each
+twice the size of the previous one and appended under a lock when needed.
+Between batches, maintain() rehashes an overflowed chain into one segment
+twice its total size, so a run settles on a single segment sized for its
+hottest kernel. Addresses above 2^55 alias lower ones (GPU virtual
+addresses are 49-bit).
+*/
+class unknown_shadow_table{
+public:
+    static constexpr uint32_t k_address_bits = 55;
+    static constexpr uint32_t k_first_segment_bits = 12;   // 4096 slots, 96KB
+    static constexpr uint32_t k_max_segments = 24;
+    static constexpr uint32_t k_probe_limit = 32;
+
+    unknown_shadow_table() {
+        for (auto& segment : _segments) {
+            segment.store(nullptr, std::memory_order_relaxed);
+        }
+    };
+
+    ~unknown_shadow_table() {
+        release_segments();
+    };
+
+    unknown_shadow_table(const unknown_shadow_table&) = delete;
+    unknown_shadow_table& operator=(const unknown_shadow_table&) = delete;
+
+    // Epochs are 1..511; slots of any other epoch read as empty. Only called
+    // while no worker runs.
+    void set_epoch(uint32_t epoch) {
+        _epoch = static_cast<uint64_t>(epoch) << k_address_bits;
+    };
+
+    // Zeroes every segment, for when an epoch is about to be reused.
+    void reset() {
+        for (uint32_t seg = 0; seg < _segment_count.load(std::memory_order_relaxed); ++seg) {
+            madvise(_segments[seg].load(std::memory_order_relaxed), segment_bytes(seg), MADV_DONTNEED);
+        }
+    };
+
+    // Stores `packed` for `addr` and returns the previous entry, 0 if the
+    // address is new in this epoch. `time` receives the entry's time slot.
+    uint64_t exchange(uint64_t addr, uint64_t packed, uint32_t** time = nullptr) {
+        const uint64_t key = _epoch | (addr & k_address_mask);
+        for (uint32_t seg = 0; seg < k_max_segments; ++seg) {
+            slot* slots = segment(seg);
+            if (slots == nullptr) {
+                if (time != nullptr) {
+                    *time = &_lost_time;
+                }
+                return 0;
+            }
+            const uint64_t mask = segment_slots(seg) - 1;
+            uint64_t idx = hash(key, seg) & mask;
+            for (uint32_t probe = 0; probe < k_probe_limit; ++probe, idx = (idx + 1) & mask) {
+                uint64_t seen = __atomic_load_n(&slots[idx].key, __ATOMIC_ACQUIRE);
+                if (seen != key && (seen & ~k_address_mask) != _epoch) {
+                    // Stale or empty: claim it. Losing the race to our own
+                    // key is as good as winning.
+                    if (__atomic_compare_exchange_n(&slots[idx].key, &seen, key, false,
+                                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                        // The entry left behind has an older kernel
+                        // generation, or is 0, and reads as a cold miss.
+                        seen = key;
+                    }
+                }
+                if (seen == key) {
+                    if (time != nullptr) {
+                        *time = &slots[idx].time;
+                    }
+                    return __atomic_exchange_n(&slots[idx].packed, packed, __ATOMIC_ACQ_REL);
+                }
+            }
+        }
+        if (time != nullptr) {
+            *time = &_lost_time;
+        }
+        return 0;
+    };
+
+    // Folds an overflowed chain of segments into one. Only called while no
+    // worker runs.
+    void maintain() {
+        const uint32_t count = _segment_count.load(std::memory_order_relaxed);
+        if (count <= 1) {
+            return;
+        }
+        // Every key must stay within k_probe_limit of its hash; a table
+        // where one does not is discarded for one twice as large.
+        for (uint32_t bits = _first_bits + count; bits < 40; ++bits) {
+            slot* table = rehash(bits);
+            if (table == nullptr) {
+                continue;
+            }
+            release_segments();
+            _first_bits = bits;
+            _segments[0].store(table, std::memory_order_relaxed);
+            _segment_count.store(1, std::memory_order_relaxed);
+            return;
+        }
+    };
+
+    uint32_t segment_count() const { return _segment_count.load(std::memory_order_relaxed); };
+
+private:
+    static constexpr uint64_t k_address_mask = (1ull << k_address_bits) - 1;
+
+    typedef struct slot {
+        uint64_t key;
+        uint64_t packed;
+        uint32_t time;
+        uint32_t unused;
+    } slot;
+
+    uint64_t segment_slots(uint32_t seg) const {
+        return 1ull << (_first_bits + seg);
+    };
+
+    size_t segment_bytes(uint32_t seg) const {
+        return segment_slots(seg) * sizeof(slot);
+    };
+
+    static uint64_t hash(uint64_t key, uint32_t seg) {
+        uint64_t h = (key & k_address_mask) + (static_cast<uint64_t>(seg) + 1) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return h;
+    };
+
+    // The current epoch's keys in a new table of 2^bits slots, null if it
+    // cannot be mapped or a key would fall beyond the probe limit.
+    slot* rehash(uint32_t bits) const {
+        const size_t bytes = (static_cast<size_t>(1) << bits) * sizeof(slot);
+        void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) {
+            return nullptr;
+        }
+        slot* table = static_cast<slot*>(mapped);
+        const uint64_t mask = (1ull << bits) - 1;
+        for (uint32_t seg = 0; seg < _segment_count.load(std::memory_order_relaxed); ++seg) {
+            const slot* slots = _segments[seg].load(std::memory_order_relaxed);
+            for (uint64_t idx = 0; idx < segment_slots(seg); ++idx) {
+                if ((slots[idx].key & ~k_address_mask) != _epoch) {
+                    continue;
+                }
+                uint64_t pos = hash(slots[idx].key, 0) & mask;
+                uint32_t probe = 0;
+                while (table[pos].key != 0 && probe < k_probe_limit) {
+                    pos = (pos + 1) & mask;
+                    ++probe;
+                }
+                if (probe == k_probe_limit) {
+                    munmap(mapped, bytes);
+                    return nullptr;
+                }
+                table[pos] = slots[idx];
+            }
+        }
+        return table;
+    };
+
+    // Segment `seg`, appended if it is the first one past the end.
+    slot* segment(uint32_t seg) {
+        slot* slots = _segments[seg].load(std::memory_order_acquire);
+        if (slots != nullptr) {
+            return slots;
+        }
+        std::lock_guard<std::mutex> guard(_grow_mutex);
+        slots = _segments[seg].load(std::memory_order_acquire);
+        if (slots == nullptr) {
+            void* mapped = mmap(nullptr, segment_bytes(seg), PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapped == MAP_FAILED) {
+                return nullptr;
+            }
+            slots = static_cast<slot*>(mapped);
+            _segments[seg].store(slots, std::memory_order_release);
+            _segment_count.store(seg + 1, std::memory_order_relaxed);
+        }
+        return slots;
+    };
+
+    void release_segments() {
+        for (uint32_t seg = 0; seg < _segment_count.load(std::memory_order_relaxed); ++seg) {
+            munmap(_segments[seg].load(std::memory_order_relaxed), segment_bytes(seg));
+            _segments[seg].store(nullptr, std::memory_order_relaxed);
+        }
+        _segment_count.store(0, std::memory_order_relaxed);
+    };
+
+    uint64_t _epoch = 1ull << k_address_bits;
+    uint32_t _lost_time = 0;    // time slot of addresses the table cannot hold
+    uint32_t _first_bits = k_first_segment_bits;
+    std::array<std::atomic<slot*>, k_max_segments> _segments;
+    std::atomic<uint32_t> _segment_count{0};
+    std::mutex _grow_mutex;
+};
+
 class PC_statisitics{
 public:
-    std::array<uint64_t, 5> dist = {0, 0, 0, 0, 0}; 
+    std::array<uint64_t, 7> dist = {0, 0, 0, 0, 0, 0, 0};
     // 0: intra thread
     // 1: intra instance launch
     // 2: intra warp
     // 3: intra block
     // 4: intra grid
+    // 5: evicted (the last access was lost to a shadow budget eviction, or
+    //    the budget had no room to record this one)
+    // 6: local (a local-memory load and the store of its thread it reads back)
+};
+
+/* Edge tables split into k_pc_shards by current pc.
+
+Each worker fills its own copy during a kernel. At kernel end every worker
+merges a disjoint set of shards of all copies into the kernel tables, so
+the merge runs in parallel without locks; the copies are cleared at the
+next kernel start.
+*/
+constexpr uint32_t k_pc_shard_bits = 6;
+constexpr uint32_t k_pc_shards = 1u << k_pc_shard_bits;
+
+template <typename Map>
+class pc_sharded_map {
+public:
+    typedef typename Map::key_type key_type;
+    typedef typename Map::mapped_type mapped_type;
+
+    // Keys are a pc offset or (current pc offset << 32 | ancient pc offset).
+    static uint32_t shard_of(key_type key) {
+        const uint32_t pc = static_cast<uint32_t>(static_cast<uint64_t>(key) >> (sizeof(key_type) > 4 ? 32 : 0));
+        return (pc * 0x9E3779B1u) >> (32 - k_pc_shard_bits);
+    };
+
+    mapped_type& operator[](key_type key) {
+        return _shards[shard_of(key)][key];
+    };
+
+    const mapped_type* find(key_type key) const {
+        const Map& shard = _shards[shard_of(key)];
+        auto it = shard.find(key);
+        return it != shard.end() ? &it->second : nullptr;
+    };
+
+    Map& shard(uint32_t idx) { return _shards[idx]; };
+
+    const Map& shard(uint32_t idx) const { return _shards[idx]; };
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& shard : _shards) {
+            total += shard.size();
+        }
+        return total;
+    };
+
+    void clear() {
+        for (auto& shard : _shards) {
+            shard.clear();
+        }
+    };
+
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for (const auto& shard : _shards) {
+            for (const auto& kv : shard) {
+                fn(kv.first, kv.second);
+            }
+        }
+    };
+
+private:
+    std::array<Map, k_pc_shards> _shards;
+};
+
+// (current pc offset << 32 | ancient pc offset) -> PC_statisitics
+typedef pc_sharded_map<phmap::flat_hash_map<uint64_t, PC_statisitics>> pc_statistics_map;
+
+// Same keys -> reuse time counts by dependency_reuse_bin, for
+// YOSEMITE_REUSE_TIME_HISTOGRAM=1. Only edges with an ancient pc in global
+// memory and local fills are timed.
+typedef std::array<uint64_t, k_dependency_reuse_bins> PC_reuse_times;
+typedef pc_sharded_map<phmap::flat_hash_map<uint64_t, PC_reuse_times>> pc_reuse_time_map;
+
+
+typedef enum {
+    PcHistogram_SECTORS = 0,    // distinct sector count 1..32, bin count - 1
+    PcHistogram_LANES = 1,      // active lane count 0..32
+    PcHistogram_ADDRESSES = 2,  // distinct address count 1..32, bin count - 1
+    PcHistogram_BANK_CONFLICTS = 3, // shared memory n-way bank conflict 1..32, bin n - 1
+    PcHistogram_BANK_REPLAYS = 4,   // shared memory wavefronts beyond the conflict-free ones, 0..31
+    PcHistogramCount = 5,
+} PcHistogram_t;
+
+constexpr uint32_t k_pc_histogram_bins[PcHistogramCount] = {32, 33, 32, 32, 32};
+
+/* Per-kernel pc dictionary with the per-pc tables in structure-of-arrays
+layout.
+
+A pc offset gets a dense id the first time it is seen. Its flags, access
+size and histograms are rows indexed by that id, so a warp record
+costs one hash lookup instead of one per table. Workers count in 32 bits;
+a counter that wraps carries into a side map, which histogram() adds back
+when the worker tables are merged into the 64-bit kernel table.
+*/
+template <typename Counter>
+class pc_table {
+public:
+    static constexpr uint32_t k_no_pc = 0xFFFFFFFFu;
+
+    uint32_t intern(uint32_t pc) {
+        auto result = _ids.try_emplace(pc, static_cast<uint32_t>(_pcs.size()));
+        if (result.second) {
+            _pcs.push_back(pc);
+            _flags.push_back(0);
+            _access_sizes.push_back(0);
+            for (uint32_t kind = 0; kind < PcHistogramCount; ++kind) {
+                _histograms[kind].resize(_histograms[kind].size() + k_pc_histogram_bins[kind], 0);
+            }
+        }
+        return result.first->second;
+    };
+
+    uint32_t find(uint32_t pc) const {
+        auto it = _ids.find(pc);
+        return it != _ids.end() ? it->second : k_no_pc;
+    };
+
+    uint32_t size() const { return static_cast<uint32_t>(_pcs.size()); };
+
+    uint32_t pc(uint32_t id) const { return _pcs[id]; };
+
+    uint32_t flags(uint32_t id) const { return _flags[id]; };
+
+    uint32_t access_size(uint32_t id) const { return _access_sizes[id]; };
+
+    // Flags are or-ed, the access size is the largest seen.
+    void add_access(uint32_t id, uint32_t flags, uint32_t access_size) {
+        _flags[id] |= flags;
+        _access_sizes[id] = std::max(_access_sizes[id], access_size);
+    };
+
+    void count(PcHistogram_t kind, uint32_t id, uint32_t bin) {
+        const size_t idx = static_cast<size_t>(id) * k_pc_histogram_bins[kind] + bin;
+        if (++_histograms[kind][idx] == 0) {
+            _carries[idx * PcHistogramCount + kind] += static_cast<uint64_t>(std::numeric_limits<Counter>::max()) + 1u;
+        }
+    };
+
+    uint64_t histogram(PcHistogram_t kind, uint32_t id, uint32_t bin) const {
+        const size_t idx = static_cast<size_t>(id) * k_pc_histogram_bins[kind] + bin;
+        uint64_t value = _histograms[kind][idx];
+        if (!_carries.empty()) {
+            auto it = _carries.find(idx * PcHistogramCount + kind);
+            if (it != _carries.end()) {
+                value += it->second;
+            }
+        }
+        return value;
+    };
+
+    // Adds the rows of other to the rows of the same pcs. Only for 64-bit
+    // tables, which never carry.
+    template <typename OtherCounter>
+    void merge(const pc_table<OtherCounter>& other) {
+        static_assert(sizeof(Counter) == 8, "merge into a 64-bit table");
+        for (uint32_t other_id = 0; other_id < other.size(); ++other_id) {
+            const uint32_t id = intern(other.pc(other_id));
+            add_access(id, other.flags(other_id), other.access_size(other_id));
+            for (uint32_t kind = 0; kind < PcHistogramCount; ++kind) {
+                const uint32_t bins = k_pc_histogram_bins[kind];
+                Counter* row = &_histograms[kind][static_cast<size_t>(id) * bins];
+                for (uint32_t bin = 0; bin < bins; ++bin) {
+                    row[bin] += other.histogram(static_cast<PcHistogram_t>(kind), other_id, bin);
+                }
+            }
+        }
+    };
+
+    void clear() {
+        _ids.clear();
+        _pcs.clear();
+        _flags.clear();
+        _access_sizes.clear();
+        for (auto& histogram : _histograms) {
+            histogram.clear();
+        }
+        _carries.clear();
+    };
+
+private:
+    phmap::flat_hash_map<uint32_t, uint32_t> _ids;  // pc offset -> id
+    std::vector<uint32_t> _pcs;
+    std::vector<uint32_t> _flags;
+    std::vector<uint32_t> _access_sizes;
+    std::array<std::vector<Counter>, PcHistogramCount> _histograms;   // id * bins + bin
+    phmap::flat_hash_map<uint64_t, uint64_t> _carries;  // (idx * PcHistogramCount + kind) -> wrapped counts
 };
 
 struct worker_shared_shadow_state {
     static constexpr uint32_t k_invalid_object = 0xFFFFFFFFu;
-    // local_cta_slot -> pooled object index, initialized on each kernel launch.
-    std::vector<uint32_t> cta_slot_to_object;
     // Each object holds an array of shared_shadow_memory_entry entries indexed by 4-byte word offset.
     std::vector<shared_shadow_memory_entry*> object_entries;
     std::vector<uint64_t> object_owner_cta;
@@ -195,13 +830,93 @@ struct worker_shared_shadow_state {
     uint64_t pool_miss_count = 0;
 };
 
+/* Work-stealing queue of CTA tasks.
+
+A task holds all records of one CTA in a batch, so a CTA's records stay in
+order on whichever worker runs it. Tasks are filled in before the workers
+start and none are added while they run, so the queue is the [head, tail)
+range packed in one word: the owner pops from the head and thieves take
+from the tail, both with a CAS.
+*/
+struct alignas(64) worker_task_queue {
+    std::vector<uint32_t> tasks;
+    std::atomic<uint64_t> bounds{0};    // head | tail << 32
+    uint64_t stolen_tasks = 0;          // taken from other queues by this worker
+
+    void reset(uint32_t count) {
+        bounds.store(static_cast<uint64_t>(count) << 32, std::memory_order_relaxed);
+    };
+
+    bool pop(uint32_t& task) {
+        uint64_t current = bounds.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(current) < static_cast<uint32_t>(current >> 32)) {
+            if (bounds.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel)) {
+                task = tasks[static_cast<uint32_t>(current)];
+                return true;
+            }
+        }
+        return false;
+    };
+
+    bool steal(uint32_t& task) {
+        uint64_t current = bounds.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(current) < static_cast<uint32_t>(current >> 32)) {
+            if (bounds.compare_exchange_weak(current, current - (1ull << 32), std::memory_order_acq_rel)) {
+                task = tasks[static_cast<uint32_t>(current >> 32) - 1u];
+                return true;
+            }
+        }
+        return false;
+    };
+};
+
+typedef struct CtaTask {
+    uint64_t cta_id;
+    uint64_t begin;     // range of pipeline_batch::task_traces
+    uint64_t end;
+} CtaTask_t;
+
+/* One trace batch in flight through the PcDependency pipeline.
+
+The caller's buffer is only valid during gpu_trace_analysis, so the records
+are copied in, then partitioned into CTA tasks on the calling thread while
+the workers analyze the previous batch. The pool holds
+YOSEMITE_PIPELINE_DEPTH of these; the caller waits for a free one.
+*/
+struct pipeline_batch {
+    std::vector<MemoryAccess> accesses;
+    std::vector<DecodedAccess_t> decoded;
+    AccessBatch_t batch;        // view over the copies
+    uint64_t max_cta_id = 0;
+    uint64_t first_record = 0;  // position of the batch in the kernel trace
+
+    std::vector<CtaTask_t> tasks;
+    std::vector<uint64_t> task_traces;  // record indices grouped by task
+    std::vector<worker_task_queue> worker_tasks;
+};
+
+/* Launches of one kernel merged into a single graph
+(YOSEMITE_DEPENDENCY_AGGREGATE=1), keyed by kernel name and launch geometry.
+*/
+typedef std::tuple<std::string, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t> KernelIdentity_t;
+
+typedef struct KernelAggregate {
+    uint64_t index = 0;             // written as aggregate_<index>
+    uint64_t written_launches = 0;  // launch count of the last file written
+    DependencyGraph_t graph;
+} KernelAggregate_t;
+
 class PcDependency final : public Tool {
 public:
-    PcDependency();
+    PcDependency(const std::string& shard_directory = "");
 
     ~PcDependency();
 
-    void gpu_data_analysis(void* data, uint64_t size);
+    std::shared_ptr<Tool> make_shard(int device_id, uint32_t device_count) override;
+
+    void gpu_data_analysis(void* data, uint64_t size) override {};
+
+    void gpu_trace_analysis(const AccessBatch_t& batch) override;
 
     void query_ranges(void* ranges, uint32_t limit, uint32_t* count) override {};
 
@@ -211,36 +926,62 @@ public:
 
     void deallocation_callback(uint64_t ptr);
 
-    void evt_callback(EventPtr_t evt);
+    void merge(Tool& shard) override;
 
     void flush();
 
 private:
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_KERNEL_LAUNCH) | event_bit(EventType_KERNEL_END) |
+        event_bit(EventType_MEM_ALLOC) | event_bit(EventType_MEM_FREE) |
+        event_bit(EventType_TEN_ALLOC) | event_bit(EventType_TEN_FREE);
 
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
+    void kernel_start_callback(const EventRecord_t& record) override;
 
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
+    void kernel_end_callback(const EventRecord_t& record) override;
 
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
+    void mem_alloc_callback(const EventRecord_t& record) override;
 
-    void ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten);
+    void mem_free_callback(const EventRecord_t& record) override;
 
-    void ten_free_callback(std::shared_ptr<TenFree_t> ten);
+    void ten_alloc_callback(const EventRecord_t& record) override;
+
+    void ten_free_callback(const EventRecord_t& record) override;
 
     void kernel_trace_flush(std::shared_ptr<KernelLaunch_t> kernel);
 
+    void build_dependency_graph(const KernelLaunch_t& kernel, DependencyGraph_t& graph);
+
+    // Writes <path>.ydg and/or <path>.json, per YOSEMITE_DEPENDENCY_FORMAT.
+    void write_graph_files(const std::string& path, const DependencyGraph_t& graph) const;
+
+    void write_kernel_aggregate(KernelAggregate_t& aggregate) const;
+
     void unit_access(
         uint64_t ptr,
         uint32_t pc_offset,
         uint64_t current_block_id,
         uint32_t current_warp_id,
         uint32_t current_lane_id,
-        memory_region& memory_region_target,
+        shadow_memory& shadow_memory,
         int access_size,
-        phmap::flat_hash_map<uint64_t, PC_statisitics>& local_pc_statistics
+        uint32_t now,
+        pc_statistics_map& local_pc_statistics,
+        pc_reuse_time_map* local_reuse_times
     );
 
+    // Region containing addr through the region map, for mixed pages.
+    shadow_page_entry find_shadow_region(uint64_t addr) const;
+
+    // Recomputes the page table entry of a page after a region change.
+    void update_shadow_page(uint64_t page);
+
+    void map_shadow_region(uint64_t start, uint64_t end);
+
+    // Evicts least recently used shadow chunks while over
+    // YOSEMITE_SHADOW_BUDGET_MB. Only between batches.
+    void enforce_shadow_budget();
+
     void unit_access_shared(
         uint64_t ptr,
         uint32_t pc_offset,
@@ -249,16 +990,29 @@ private:
         uint32_t current_warp_id,
         uint32_t current_lane_id,
         int access_size,
-        phmap::flat_hash_map<uint64_t, PC_statisitics>& local_pc_statistics,
-        worker_shared_shadow_state& local_shadow_memory_shared
+        pc_statistics_map& local_pc_statistics
     );
 
-    void unit_access_local(uint64_t ptr, uint32_t pc_offset, uint64_t current_block_id, uint32_t current_warp_id, uint32_t current_lane_id, int access_size);
+    // Pairs local-memory loads with the last store of the same thread to
+    // the address: spill -> fill edges, counted as dist[6].
+    void unit_access_local(
+        uint64_t ptr,
+        uint32_t pc_offset,
+        bool is_store,
+        local_shadow_memory& shadow,
+        uint32_t current_warp_id,
+        uint32_t current_lane_id,
+        int access_size,
+        uint32_t now,
+        pc_statistics_map& local_pc_statistics,
+        pc_reuse_time_map* local_reuse_times
+    );
 
     // Fallback for global-memory accesses whose base allocation was not captured
-    // (e.g. __device__ static globals, VMM-mapped memory).  Uses a concurrent
-    // hashmap keyed by absolute device address instead of a pre-allocated shadow
-    // array, so no prior registration is required.
+    // (e.g. __device__ static globals, VMM-mapped memory).  Uses the lock-free
+    // unknown_shadow_table keyed by (kernel epoch, absolute device address)
+    // instead of a pre-allocated shadow array, so no prior registration is
+    // required.
     void unit_access_unknown(
         uint64_t abs_addr,
         uint32_t pc_offset,
@@ -266,20 +1020,34 @@ private:
         uint32_t current_warp_id,
         uint32_t current_lane_id,
         int access_size,
-        phmap::flat_hash_map<uint64_t, PC_statisitics>& local_pc_statistics
+        uint32_t now,
+        pc_statistics_map& local_pc_statistics,
+        pc_reuse_time_map* local_reuse_times
     );
+    // Workers, their tables, the shared-memory shadow objects and the
+    // pipeline batches. Started by the first kernel, so an instance that
+    // only merges device shards never starts one.
+    void start_worker_pool();
     void worker_loop(uint64_t worker_idx);
-    uint32_t acquire_shared_shadow_object(worker_shared_shadow_state& local_shadow_memory_shared, uint64_t cta_id);
-    void release_shared_shadow_object(
-        worker_shared_shadow_state& local_shadow_memory_shared,
-        uint64_t cta_id,
-        uint32_t exiting_threads
-    );
-    shared_shadow_memory_entry& get_shared_shadow_entry(
-        worker_shared_shadow_state& local_shadow_memory_shared,
-        uint32_t object_idx,
-        uint32_t addr
-    );
+    // Runs the kernel-end merge of the per-worker tables on the pool.
+    void merge_worker_statistics();
+    void merge_statistics_shards(uint64_t worker_idx);
+    // Next task of a worker: its own queue first, then the other queues.
+    bool next_task(pipeline_batch& job, uint64_t worker_idx, uint32_t& task);
+    // Groups the records of a batch into CTA tasks and seeds the queues.
+    void build_cta_tasks(pipeline_batch& job);
+    // Hands the next ready batch to the workers. With _worker_pool_mutex
+    // held and no batch being analyzed.
+    void start_next_batch();
+    // Run by the worker that completes a batch.
+    void finish_batch();
+    // Waits until every batch handed in is analyzed.
+    void drain_pipeline();
+    uint32_t acquire_shared_shadow_object(uint64_t cta_id);
+    void release_shared_shadow_object(uint64_t cta_id, uint32_t exiting_threads);
+    shared_shadow_memory_entry& get_shared_shadow_entry(uint32_t object_idx, uint32_t addr);
+    local_shadow_memory& acquire_local_shadow(uint64_t cta_id);
+    void release_local_shadow(uint64_t cta_id, uint32_t exiting_threads);
     uint64_t pack_pc_ancient_pairs(uint32_t current_pc_offset, uint32_t ancient_pc_offset){
         return static_cast<uint64_t>(current_pc_offset) << 32 | static_cast<uint64_t>(ancient_pc_offset);
     };
@@ -298,6 +1066,32 @@ private:
     std::string output_directory;
     uint32_t kernel_id = 0;
     uint8_t _kernel_generation = 0;
+    uint32_t _shadow_granularity = 1;   // bytes per global shadow entry
+    uint32_t _sample_stride = 4;        // bytes between sampled addresses of an access
+    // YOSEMITE_DEPENDENCY_FORMAT: binary (kernel_N.ydg), json or both.
+    bool _write_graph_binary = true;
+    bool _write_graph_json = false;
+    // Aggregation: a launch that differs from its kernel's aggregate by more
+    // than YOSEMITE_DEPENDENCY_DELTA_PERCENT is also written on its own.
+    bool _aggregate_launches = false;
+    double _aggregate_delta = 0.05;
+    std::map<KernelIdentity_t, KernelAggregate_t> _kernel_aggregates;
+    // YOSEMITE_REUSE_TIME_HISTOGRAM: time shadow writes with the position
+    // of their record in the kernel trace.
+    bool _reuse_times = false;
+    uint64_t _kernel_records = 0;
+
+    // Shadow budget: chunks last used before _kernel_first_stamp only hold
+    // entries of earlier kernels and are evicted without loss.
+    // Chunks are sized so the budget holds about k_shadow_budget_chunks.
+    static constexpr uint64_t k_shadow_budget_chunks = 1024;
+    static constexpr uint32_t k_min_shadow_chunk_bits = 10;
+    shadow_budget _shadow_budget;
+    uint32_t _shadow_chunk_bits = shadow_memory::k_max_chunk_bits;
+    uint32_t _shadow_stamp = 0;         // current batch
+    uint32_t _kernel_first_stamp = 0;
+    uint64_t _kernel_evicted_chunks = 0;
+    uint64_t _kernel_lossy_evicted_chunks = 0;
     uint32_t _shared_kernel_generation = 0;
     uint64_t _current_kernel_cta_count = 0;
 
@@ -309,47 +1103,54 @@ private:
     std::map<uint64_t, std::shared_ptr<TenAlloc>> tensor_events;
     std::map<DevPtr, std::shared_ptr<TenAlloc>> active_tensors;
 
-
-    std::vector<memory_region> _memory_regions;
-
     std::map<memory_region, std::unique_ptr<shadow_memory>> _shadow_memories; // memory region, shadow memory
+    shadow_page_table _shadow_pages;
 
-    // Per-kernel fallback shadow for addresses outside all tracked allocations.
-    // Keyed by absolute device address (sampled at 4-byte stride), value is
-    // the same packed shadow entry format as shadow_memory_entry::packed.
-    // Use parallel_flat_hash_map_m (std::mutex per shard) so concurrent
-    // worker threads can safely call try_emplace_l on the same shard.
-    phmap::parallel_flat_hash_map_m<uint64_t, uint64_t> _unknown_region_shadow;
+    // Per-kernel fallback shadow for addresses outside all tracked allocations,
+    // cleared by moving to the epoch of the next kernel generation.
+    unknown_shadow_table _unknown_region_shadow;
 
     // std::unordered_map<uint32_t, std::unordered_map<uint32_t, PC_statisitics>> _pc_statistics; // current pc offset, ancient pc offset, PC_statisitics
     // std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> _pc_flags; // pc offset, flags, size of the access
-    phmap::flat_hash_map<uint64_t, PC_statisitics> _pc_statistics; // (current pc offset<<32 || ancient pc offset), PC_statisitics
-    phmap::flat_hash_map<uint32_t, std::pair<uint32_t, uint32_t>> _pc_flags; // pc offset, flags, size of the access
-    // Index [0..31] stores distinct sector count 1..32.
-    // Index [32..64] stores active lane count 0..32.
-    // Index [0..31]:  distinct sector count 1..32.
-    // Index [32..64]: active lane count 0..32.
-    // Index [65..96]: distinct address count 1..32.
-    std::unordered_map<uint32_t, std::array<uint64_t, 97>> _distinct_sector_count;
-
-    // Persistent worker pool and per-worker shared-memory shadow state.
+    // Kernel tables, filled by merge_worker_statistics at kernel end.
+    pc_statistics_map _pc_statistics; // (current pc offset<<32 || ancient pc offset), PC_statisitics
+    pc_table<uint64_t> _pc_table;     // flags, access size and histograms by pc
+    pc_reuse_time_map _pc_reuse_times;
+
+    // Per-worker tables, accumulated over a kernel.
+    std::vector<pc_statistics_map> _worker_pc_statistics;
+    std::vector<pc_table<uint32_t>> _worker_pc_tables;
+    std::vector<pc_reuse_time_map> _worker_pc_reuse_times;
+
+    // Persistent worker pool and the shared-memory shadow objects. A CTA
+    // can run on a different worker in every batch, so objects are bound to
+    // CTAs in a grid-wide table; only the worker running a CTA's task reads
+    // or writes its slot, and the free list is taken under a lock.
     uint64_t _worker_count = 1;
     std::vector<std::thread> _workers;
-    std::vector<worker_shared_shadow_state> _worker_shadow_memory_shared;
-    uint32_t _shared_shadow_object_cap_per_worker = 128;
+    worker_shared_shadow_state _shadow_memory_shared;
+    std::vector<uint32_t> _cta_shared_object;   // cta id -> pooled object index
+    std::mutex _shared_shadow_pool_mutex;
+    uint32_t _shared_shadow_object_cap = 128;
     uint32_t _shared_shadow_bytes_per_object = 102400;
     uint32_t _current_block_thread_count = 0;
-
-    // Per-batch job data produced by gpu_data_analysis and consumed by workers.
-    const MemoryAccess* _job_accesses_buffer = nullptr;
-    std::vector<std::vector<uint64_t>> _job_worker_trace_indices;
-    std::vector<phmap::flat_hash_map<uint64_t, PC_statisitics>> _job_worker_pc_statistics;
-    std::vector<std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>>> _job_worker_pc_flags;
-    std::vector<std::unordered_map<uint32_t, std::array<uint64_t, 97>>> _job_worker_distinct_sector_count;
+    // Local-memory shadow of the running CTAs, bound the same way.
+    std::vector<std::unique_ptr<local_shadow_memory>> _cta_local_shadow;  // cta id -> shadow
+
+    // Pipeline: free -> (partition on the caller) -> ready -> (workers)
+    // -> free, under _worker_pool_mutex. The statistics are merged once,
+    // at kernel end.
+    std::vector<std::unique_ptr<pipeline_batch>> _pipeline_batches;
+    std::deque<pipeline_batch*> _pipeline_free;
+    std::deque<pipeline_batch*> _pipeline_ready;
+    pipeline_batch* _job_slot = nullptr;        // batch the workers analyze
+    bool _job_merge = false;                    // the workers merge shards
+    std::vector<uint32_t> _job_cta_task;        // cta id -> task, while partitioning
+    uint64_t _kernel_stolen_tasks = 0;
 
     std::mutex _worker_pool_mutex;
     std::condition_variable _worker_pool_cv;
-    std::condition_variable _worker_pool_done_cv;
+    std::condition_variable _pipeline_cv;       // a batch or the merge completed
     bool _worker_pool_shutdown = false;
     uint64_t _worker_job_generation = 0;
     uint64_t _worker_pending_jobs = 0;
@@ -10,12 +10,10 @@ namespace yosemite {
 
 class RooflineFlops final : public Tool {
 public:
-    RooflineFlops() : Tool(ROOFLINE_FLOPS) {}
+    RooflineFlops() : Tool(ROOFLINE_FLOPS, k_event_mask) {}
 
     ~RooflineFlops() {}
 
-    void evt_callback(EventPtr_t evt);
-
     void gpu_data_analysis(void* data, uint64_t size);
 
     void query_ranges(void* ranges, uint32_t limit, uint32_t* count);
@@ -25,13 +23,12 @@ public:
     void flush();
 
 private:
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
-
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_KERNEL_LAUNCH) | event_bit(EventType_KERNEL_END);
 
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
+    void kernel_start_callback(const EventRecord_t& record) override;
 
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
+    void kernel_end_callback(const EventRecord_t& record) override;
 
     /*
     ********************************* variables *********************************
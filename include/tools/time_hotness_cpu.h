@@ -21,7 +21,9 @@ public:
 
     ~TimeHotnessCPU();
 
-    void evt_callback(EventPtr_t evt);
+    std::shared_ptr<Tool> make_shard(int device_id, uint32_t device_count) override;
+
+    void merge(Tool& shard) override;
 
     void gpu_data_analysis(void* data, uint64_t size);
 
@@ -32,27 +34,14 @@ public:
     void flush();
 
 private :
-    void init();
-
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
-
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
-
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_MEM_ALLOC) | event_bit(EventType_MEM_FREE);
 
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
-
-    void mem_cpy_callback(std::shared_ptr<MemCpy_t> mem);
-
-    void mem_set_callback(std::shared_ptr<MemSet_t> mem);
-
-    void ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten);
-
-    void ten_free_callback(std::shared_ptr<TenFree_t> ten);
+    void init();
 
-    void op_start_callback(std::shared_ptr<OpStart_t> op);
+    void mem_alloc_callback(const EventRecord_t& record) override;
 
-    void op_end_callback(std::shared_ptr<OpEnd_t> op);
+    void mem_free_callback(const EventRecord_t& record) override;
 
     std::shared_ptr<MemAlloc_t> query_memory_ranges_cpu(uint64_t ptr);
 
@@ -2,20 +2,79 @@
 #define YOSEMITE_TOOL_H
 
 #include "utils/event.h"
+#include "utils/event_pool.h"
+#include "utils/access_trace.h"
 #include "tools/tool_type.h"
 
+#include <memory>
+
 namespace yosemite {
 
+constexpr uint32_t event_bit(EventType_t type) {
+    return 1u << type;
+}
+
+constexpr uint32_t k_all_events = (1u << EventTypeCount) - 1u;
+
 class Tool {
 public:
-    Tool(AnalysisTool_t tool) : _tool(tool) {}
+    // event_mask is the set of host events this tool subscribes to
+    // (an OR of event_bit()); the dispatcher only calls the hooks below
+    // for those event types, so unsubscribed events cost the tool nothing.
+    Tool(AnalysisTool_t tool, uint32_t event_mask = k_all_events)
+        : _tool(tool), _event_mask(event_mask) {}
 
     virtual ~Tool() = default;
 
-    virtual void evt_callback(EventPtr_t evt) = 0;
+    uint32_t event_mask() const { return _event_mask; }
+
+    // One hook per host event type. The record is shared by every tool and
+    // only valid for the duration of the call; tools that keep events around
+    // lift it with make_event<...>(record).
+    virtual void kernel_start_callback(const EventRecord_t& record) {}
+
+    virtual void kernel_end_callback(const EventRecord_t& record) {}
+
+    virtual void mem_alloc_callback(const EventRecord_t& record) {}
+
+    virtual void mem_free_callback(const EventRecord_t& record) {}
+
+    virtual void mem_cpy_callback(const EventRecord_t& record) {}
+
+    virtual void mem_set_callback(const EventRecord_t& record) {}
+
+    virtual void ten_alloc_callback(const EventRecord_t& record) {}
+
+    virtual void ten_free_callback(const EventRecord_t& record) {}
+
+    virtual void op_start_callback(const EventRecord_t& record) {}
+
+    virtual void op_end_callback(const EventRecord_t& record) {}
 
     virtual void gpu_data_analysis(void* data, uint64_t size) = 0;
 
+    // Tools that consume MemoryAccess traces set _access_trace and get the
+    // buffer here instead, decoded once by the dispatcher and shared with
+    // every other trace tool enabled in the same run.
+    virtual void gpu_trace_analysis(const AccessBatch_t& batch) {
+        gpu_data_analysis(const_cast<MemoryAccess*>(batch.accesses), batch.size);
+    }
+
+    bool access_trace() const { return _access_trace; }
+
+    // Device sharding (YOSEMITE_DEVICE_SHARDS=1). Tools that set
+    // _device_shards get one instance per device from make_shard(); each
+    // shard sees only its device's events and GPU buffers and runs on that
+    // device's analysis thread. Before flush() the dispatcher moves every
+    // shard's results into the instance created at startup with merge().
+    // device_count is the number of devices expected to get a shard, for
+    // tools that split a thread budget between them.
+    bool device_shards() const { return _device_shards; }
+
+    virtual std::shared_ptr<Tool> make_shard(int device_id, uint32_t device_count) { return nullptr; }
+
+    virtual void merge(Tool& shard) {}
+
     virtual void query_ranges(void* ranges, uint32_t limit, uint32_t* count) = 0;
 
     virtual void query_tensors(void* ranges, uint32_t limit, uint32_t* count) = 0;
@@ -24,8 +83,14 @@ public:
 protected:
     AnalysisTool_t _tool;
 
+    uint32_t _event_mask;
+
+    bool _access_trace = false;
+
+    bool _device_shards = false;
+
     bool _torch_enabled = false;
 };
 
 }   // yosemite
-#endif // YOSEMITE_TOOL_H
\ No newline at end of file
+#endif // YOSEMITE_TOOL_H
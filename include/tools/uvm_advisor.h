@@ -4,6 +4,7 @@
 
 #include "tools/tool.h"
 #include "utils/event.h"
+#include "utils/interval_index.h"
 
 #include <map>
 #include <vector>
@@ -21,8 +22,6 @@ public:
 
     ~UVMAdvisor();
 
-    void evt_callback(EventPtr_t evt);
-
     void gpu_data_analysis(void* data, uint64_t size);
 
     void query_ranges(void* ranges, uint32_t limit, uint32_t* count);
@@ -32,27 +31,29 @@ public:
     void flush();
 
 private :
-    void init();
+    static constexpr uint32_t k_event_mask =
+        event_bit(EventType_KERNEL_LAUNCH) | event_bit(EventType_KERNEL_END) |
+        event_bit(EventType_MEM_ALLOC) | event_bit(EventType_MEM_FREE) |
+        event_bit(EventType_TEN_ALLOC) | event_bit(EventType_TEN_FREE) |
+        event_bit(EventType_OP_START) | event_bit(EventType_OP_END);
 
-    void kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel);
-
-    void kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel);
+    void init();
 
-    void mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem);
+    void kernel_start_callback(const EventRecord_t& record) override;
 
-    void mem_free_callback(std::shared_ptr<MemFree_t> mem);
+    void kernel_end_callback(const EventRecord_t& record) override;
 
-    void mem_cpy_callback(std::shared_ptr<MemCpy_t> mem);
+    void mem_alloc_callback(const EventRecord_t& record) override;
 
-    void mem_set_callback(std::shared_ptr<MemSet_t> mem);
+    void mem_free_callback(const EventRecord_t& record) override;
 
-    void ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten);
+    void ten_alloc_callback(const EventRecord_t& record) override;
 
-    void ten_free_callback(std::shared_ptr<TenFree_t> ten);
+    void ten_free_callback(const EventRecord_t& record) override;
 
-    void op_start_callback(std::shared_ptr<OpStart_t> op);
+    void op_start_callback(const EventRecord_t& record) override;
 
-    void op_end_callback(std::shared_ptr<OpEnd_t> op);
+    void op_end_callback(const EventRecord_t& record) override;
 
     bool find_uvm_tensor(uint64_t ptr);
 
@@ -65,6 +66,7 @@ private :
 
     std::map<uint64_t, std::shared_ptr<MemAlloc_t>> alloc_events;
     std::map<DevPtr, std::shared_ptr<MemAlloc_t>> active_memories;
+    IntervalIndex uvm_index;
 
     std::map<uint64_t, std::shared_ptr<TenAlloc_t>> tenalloc_events;
     std::map<DevPtr, std::shared_ptr<TenAlloc_t>> active_tensors;
@@ -0,0 +1,60 @@
+#ifndef YOSEMITE_UTILS_ACCESS_TRACE_H
+#define YOSEMITE_UTILS_ACCESS_TRACE_H
+
+#include "gpu_patch.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace yosemite {
+
+/* Decode-once view of a MemoryAccess trace buffer.
+
+When several trace tools are enabled together they all walk the same
+buffer. The per-warp facts they each used to recompute (active lanes,
+lanes repeating an earlier lane's address, the kind of record) are
+computed once per record by AccessTraceDecoder and handed to every tool
+alongside the raw records.
+*/
+
+// Kinds other than ACCESS only come from typed patches. Shared and local
+// records hold offsets in the CTA's shared or the thread's local memory,
+// not device addresses, so tools of global memory skip them.
+typedef enum {
+    DecodedKind_ACCESS = 0,     // global memory
+    DecodedKind_BLOCK_EXIT = 1,
+    DecodedKind_SHARED = 2,
+    DecodedKind_LOCAL = 3,
+} DecodedKind_t;
+
+typedef struct DecodedAccess {
+    uint32_t active_lanes;      // popcount(active_mask)
+    uint32_t repeat_lanes;      // active lanes whose address repeats an earlier lane
+    DecodedKind_t kind;
+} DecodedAccess_t;
+
+typedef struct AccessBatch {
+    const MemoryAccess* accesses = nullptr;
+    uint64_t size = 0;
+    const DecodedAccess_t* decoded = nullptr;
+} AccessBatch_t;
+
+class AccessTraceDecoder {
+public:
+    // typed: the GPU patch fills MemoryAccess::type, so shared, local and
+    // block-exit records are told apart from global ones
+    void set_typed(bool typed) { _typed = typed; }
+
+    bool typed() const { return _typed; }
+
+    const AccessBatch_t& decode(const MemoryAccess* accesses, uint64_t size);
+
+private:
+    bool _typed = false;
+    std::vector<DecodedAccess_t> _decoded;
+    AccessBatch_t _batch;
+};
+
+}   // yosemite
+
+#endif // YOSEMITE_UTILS_ACCESS_TRACE_H
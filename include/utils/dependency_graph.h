@@ -0,0 +1,142 @@
+#ifndef YOSEMITE_UTILS_DEPENDENCY_GRAPH_H
+#define YOSEMITE_UTILS_DEPENDENCY_GRAPH_H
+
+#include "gpu_patch.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace yosemite {
+
+/* PC dependency graph of one kernel launch, or of all launches of a kernel
+merged, as written by PcDependency.
+
+File layout (version 4), all integers varints unless noted:
+  magic "YSMDEPG\0", uint32 version (little endian)
+  kernel: kernel_id, string kernel_name, signed device_id, kernel_pc,
+          grid_dim[3], grid_cta_count, block_dim[3], block_thread_count,
+          shadow_granularity, sample_stride, shadow_budget_bytes,
+          shadow_evicted_chunks, shadow_lossy_evicted_chunks,
+          launch_count (version 2, 1 in version 1 files),
+          reuse_times (version 3, 0 before)
+  nodes:  count, then in pc order: pc delta to the previous node,
+          one byte has_info, and with info: flags, access_size and for
+          each histogram (sectors, lanes, addresses and, from version 4,
+          bank conflicts and bank replays) the number of non-zero bins
+          followed by (bin, count) pairs
+  edges:  dist count (6 before local edges), edge count, then in (current pc, ancient pc) order:
+          current pc delta to the previous edge, ancient pc (0: cold
+          miss), the dist counts and, with reuse_times, the number of
+          non-zero reuse time bins followed by (bin, count) pairs
+  strings are a varint length followed by the bytes, signed values are
+  zigzag encoded.
+
+write_dependency_graph_json renders the JSON the tool used to write, so
+kernel_N.ydg files convert back to kernel_N.json for the CFG joins.
+*/
+
+constexpr uint32_t k_dependency_graph_version = 4;
+
+typedef enum {
+    DependencyHistogram_SECTORS = 0,    // distinct sector count 1..32, bin count - 1
+    DependencyHistogram_LANES = 1,      // active lane count 0..32
+    DependencyHistogram_ADDRESSES = 2,  // distinct address count 1..32, bin count - 1
+    DependencyHistogram_BANK_CONFLICTS = 3, // shared memory n-way bank conflict 1..32, bin n - 1
+    DependencyHistogram_BANK_REPLAYS = 4,   // shared memory wavefronts beyond the conflict-free ones, 0..31
+    DependencyHistogramCount = 5,
+} DependencyHistogram_t;
+
+constexpr uint32_t k_dependency_histogram_bins[DependencyHistogramCount] = {32, 33, 32, 32, 32};
+
+typedef enum {
+    DependencyDist_INTRA_THREAD = 0,
+    DependencyDist_INTRA_INSTANCE_LAUNCH = 1,
+    DependencyDist_INTRA_WARP = 2,
+    DependencyDist_INTRA_BLOCK = 3,
+    DependencyDist_INTRA_GRID = 4,
+    DependencyDist_EVICTED = 5,         // the last access was lost to a shadow eviction
+    DependencyDist_LOCAL = 6,           // local-memory load of the value its thread stored (spill/fill)
+    DependencyDistCount = 7,
+} DependencyDist_t;
+
+const char* dependency_dist_name(uint32_t dist);
+
+// Reuse time of an edge: distance in warp records of the kernel trace
+// between the two accesses, log2-bucketed. Bin 0 holds a distance of 0, bin b > 0 distances
+// in [2^(b-1), 2^b).
+constexpr uint32_t k_dependency_reuse_bins = 33;
+
+inline uint32_t dependency_reuse_bin(uint32_t distance) {
+    return distance == 0 ? 0 : 32 - __builtin_clz(distance);
+}
+
+typedef struct DependencyGraphKernel {
+    uint64_t kernel_id = 0;
+    std::string kernel_name;
+    int32_t device_id = 0;
+    uint64_t kernel_pc = 0;
+    uint32_t grid_dim[3] = {0, 0, 0};
+    uint64_t grid_cta_count = 0;
+    uint32_t block_dim[3] = {0, 0, 0};
+    uint32_t block_thread_count = 0;
+    uint32_t shadow_granularity = 0;
+    uint32_t sample_stride = 0;
+    uint64_t shadow_budget_bytes = 0;
+    uint64_t shadow_evicted_chunks = 0;
+    uint64_t shadow_lossy_evicted_chunks = 0;
+    uint64_t launch_count = 1;  // launches merged into the graph
+    bool reuse_times = false;   // edges carry reuse time histograms
+} DependencyGraphKernel_t;
+
+typedef struct DependencyGraphNode {
+    uint32_t pc = 0;
+    bool has_info = false;      // false for ancient pcs never seen as current
+    uint32_t flags = 0;
+    uint32_t access_size = 0;
+    std::array<std::array<uint64_t, 33>, DependencyHistogramCount> histograms{};
+} DependencyGraphNode_t;
+
+typedef struct DependencyGraphEdge {
+    uint32_t current_pc = 0;
+    uint32_t ancient_pc = 0;    // 0: cold miss
+    std::array<uint64_t, DependencyDistCount> dist{};
+    std::array<uint64_t, k_dependency_reuse_bins> reuse_time{};    // intra warp, block and grid reuse of global memory, local fills
+} DependencyGraphEdge_t;
+
+typedef struct DependencyGraph {
+    DependencyGraphKernel_t kernel;
+    std::vector<DependencyGraphNode_t> nodes;   // by pc
+    std::vector<DependencyGraphEdge_t> edges;   // by current pc, then ancient pc
+} DependencyGraph_t;
+
+// Shared memory replays of a node, the sum of its bank replay histogram.
+inline uint64_t dependency_bank_replays(const DependencyGraphNode_t& node) {
+    uint64_t replays = 0;
+    for (uint32_t bin = 1; bin < k_dependency_histogram_bins[DependencyHistogram_BANK_REPLAYS]; ++bin) {
+        replays += bin * node.histograms[DependencyHistogram_BANK_REPLAYS][bin];
+    }
+    return replays;
+}
+
+bool write_dependency_graph(const std::string& path, const DependencyGraph_t& graph);
+
+// False (with a message on stderr) if the file is missing, not a graph of
+// a known version, or truncated.
+bool read_dependency_graph(const std::string& path, DependencyGraph_t& graph);
+
+bool write_dependency_graph_json(const std::string& path, const DependencyGraph_t& graph);
+
+// Adds the counts of `graph` to `into`, a graph of the same kernel: edge
+// histogram and reuse time counts, evicted chunks and launches are summed, flags are
+// or-ed and the access size is the largest seen.
+void merge_dependency_graph(DependencyGraph_t& into, const DependencyGraph_t& graph);
+
+// Total variation distance, in [0, 1], between the edge distributions
+// (each edge weighted by the sum of its dist counts) of two graphs.
+double dependency_graph_distance(const DependencyGraph_t& a, const DependencyGraph_t& b);
+
+}   // yosemite
+
+#endif // YOSEMITE_UTILS_DEPENDENCY_GRAPH_H
@@ -0,0 +1,267 @@
+#ifndef YOSEMITE_UTILS_EVENT_POOL_H
+#define YOSEMITE_UTILS_EVENT_POOL_H
+
+#include "utils/event.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+namespace yosemite {
+
+/* Compact host event records.
+
+Every yosemite_*_callback builds exactly one EventRecord, taken from a
+pooled free list, and hands the same record to every enabled tool.
+The payload layouts mirror the Event hierarchy in utils/event.h, minus the
+per-tool scratch fields (key, end_time, ...) and with strings replaced by
+ids into the process-wide EventNameTable, so a record is trivially copyable
+and never touches the heap.
+
+Tools that still keep the heavyweight Event objects get them through
+make_event(), which lifts a record back into the matching Event subclass.
+*/
+
+constexpr uint32_t k_invalid_event_name = 0xFFFFFFFFu;
+
+typedef struct KernelLaunchRecord {
+    uint32_t name_id;
+    uint32_t grid_dim_x;
+    uint32_t grid_dim_y;
+    uint32_t grid_dim_z;
+    uint32_t block_dim_x;
+    uint32_t block_dim_y;
+    uint32_t block_dim_z;
+    uint32_t block_thread_count;
+    uint64_t grid_cta_count;
+} KernelLaunchRecord_t;
+
+typedef struct KernelEndRecord {
+    uint32_t name_id;
+} KernelEndRecord_t;
+
+typedef struct MemAllocRecord {
+    DevPtr addr;
+    uint64_t size;
+    int alloc_type;
+} MemAllocRecord_t;
+
+typedef struct MemFreeRecord {
+    DevPtr addr;
+    uint64_t size;
+    int alloc_type;
+} MemFreeRecord_t;
+
+typedef struct MemCpyRecord {
+    uint64_t src_addr;
+    uint64_t dst_addr;
+    uint64_t size;
+    uint32_t direction;
+    bool is_async;
+} MemCpyRecord_t;
+
+typedef struct MemSetRecord {
+    uint64_t addr;
+    uint64_t size;
+    uint32_t value;
+    bool is_async;
+} MemSetRecord_t;
+
+typedef struct TenAllocRecord {
+    DevPtr addr;
+    int64_t size;
+    int64_t allocated_size;
+    int64_t reserved_size;
+} TenAllocRecord_t;
+
+typedef struct TenFreeRecord {
+    DevPtr addr;
+    int64_t size;
+    int64_t allocated_size;
+    int64_t reserved_size;
+} TenFreeRecord_t;
+
+typedef struct OpStartRecord {
+    uint32_t name_id;
+    void* ctx;
+} OpStartRecord_t;
+
+typedef struct OpEndRecord {
+    uint32_t name_id;
+    void* ctx;
+} OpEndRecord_t;
+
+typedef struct EventRecord {
+    uint64_t timestamp;     // global callback sequence number
+    EventType_t evt_type;
+    int device_id;
+    union {
+        KernelLaunchRecord_t kernel_launch;
+        KernelEndRecord_t kernel_end;
+        MemAllocRecord_t mem_alloc;
+        MemFreeRecord_t mem_free;
+        MemCpyRecord_t mem_cpy;
+        MemSetRecord_t mem_set;
+        TenAllocRecord_t ten_alloc;
+        TenFreeRecord_t ten_free;
+        OpStartRecord_t op_start;
+        OpEndRecord_t op_end;
+    };
+} EventRecord_t;
+
+static_assert(std::is_trivially_copyable<EventRecord_t>::value,
+              "EventRecord must stay a POD so it can be pooled and copied around freely");
+
+
+/* Process-wide string interning for kernel and operator names.
+Ids are dense and stable for the lifetime of the process; name() is
+lock-free so tools can resolve ids from any thread.
+*/
+class EventNameTable {
+public:
+    static EventNameTable& instance();
+
+    uint32_t intern(const std::string& name);
+
+    const std::string& name(uint32_t id) const;
+
+    uint32_t size() const { return _count.load(std::memory_order_acquire); }
+
+private:
+    EventNameTable() = default;
+
+    static constexpr uint32_t k_chunk_bits = 12;
+    static constexpr uint32_t k_chunk_size = 1u << k_chunk_bits;
+    static constexpr uint32_t k_max_chunks = 4096;
+
+    mutable std::shared_mutex _mutex;
+    std::unordered_map<std::string, uint32_t> _ids;
+    std::atomic<std::string*> _chunks[k_max_chunks] = {};
+    std::atomic<uint32_t> _count{0};
+};
+
+inline const std::string& event_name(uint32_t id) {
+    return EventNameTable::instance().name(id);
+}
+
+
+/* Fixed-slot record pool with a lock-free (Treiber) free list.
+
+Slots live in slabs that are never returned to the OS, so a slot index is
+always dereferenceable and the free list only needs an ABA tag in the
+upper half of the head word.  Each slot carries a reference count; the
+record goes back on the free list when the last EventRecordRef drops it.
+*/
+class EventPool {
+public:
+    EventPool();
+
+    ~EventPool();
+
+    EventPool(const EventPool&) = delete;
+    EventPool& operator=(const EventPool&) = delete;
+
+    uint32_t acquire();
+
+    void retain(uint32_t slot);
+
+    void release(uint32_t slot);
+
+    EventRecord_t& record(uint32_t slot) {
+        return slot_at(slot).record;
+    }
+
+    uint64_t capacity() const {
+        return static_cast<uint64_t>(_slab_count.load(std::memory_order_acquire)) * k_slab_size;
+    }
+
+    uint64_t in_use() const { return _in_use.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Slot {
+        EventRecord_t record;
+        std::atomic<uint32_t> refs{0};
+        std::atomic<uint32_t> next{k_empty};
+    };
+
+    static constexpr uint32_t k_empty = 0xFFFFFFFFu;
+    static constexpr uint32_t k_slab_bits = 10;
+    static constexpr uint32_t k_slab_size = 1u << k_slab_bits;
+    static constexpr uint32_t k_max_slabs = 4096;
+
+    Slot& slot_at(uint32_t slot) {
+        return _slabs[slot >> k_slab_bits].load(std::memory_order_acquire)[slot & (k_slab_size - 1)];
+    }
+
+    static uint64_t pack_head(uint32_t tag, uint32_t slot) {
+        return (static_cast<uint64_t>(tag) << 32) | slot;
+    }
+
+    void push_free(uint32_t slot);
+
+    bool pop_free(uint32_t& slot);
+
+    void grow();
+
+    std::atomic<uint64_t> _free_head;
+    std::atomic<Slot*> _slabs[k_max_slabs] = {};
+    std::atomic<uint32_t> _slab_count{0};
+    std::atomic<uint64_t> _in_use{0};
+    std::mutex _grow_mutex;
+};
+
+
+/* Shared handle to a pooled record, the pooled equivalent of EventPtr_t. */
+class EventRecordRef {
+public:
+    EventRecordRef() = default;
+
+    explicit EventRecordRef(EventPool& pool) : _pool(&pool), _slot(pool.acquire()) {}
+
+    EventRecordRef(const EventRecordRef& other) : _pool(other._pool), _slot(other._slot) {
+        if (_pool) _pool->retain(_slot);
+    }
+
+    EventRecordRef(EventRecordRef&& other) noexcept : _pool(other._pool), _slot(other._slot) {
+        other._pool = nullptr;
+    }
+
+    EventRecordRef& operator=(EventRecordRef other) noexcept {
+        std::swap(_pool, other._pool);
+        std::swap(_slot, other._slot);
+        return *this;
+    }
+
+    ~EventRecordRef() {
+        if (_pool) _pool->release(_slot);
+    }
+
+    EventRecord_t& operator*() const { return _pool->record(_slot); }
+
+    EventRecord_t* operator->() const { return &_pool->record(_slot); }
+
+    explicit operator bool() const { return _pool != nullptr; }
+
+private:
+    EventPool* _pool = nullptr;
+    uint32_t _slot = 0;
+};
+
+
+/* Lift a record into the legacy Event hierarchy (one heap allocation). */
+EventPtr_t make_event(const EventRecord_t& record);
+
+/* Typed lift for per-event-type hooks, where the record type is already known. */
+template <typename EventT>
+inline std::shared_ptr<EventT> make_event(const EventRecord_t& record) {
+    return std::static_pointer_cast<EventT>(make_event(record));
+}
+
+}   // yosemite
+
+#endif // YOSEMITE_UTILS_EVENT_POOL_H
@@ -0,0 +1,144 @@
+#ifndef YOSEMITE_UTILS_EVENT_QUEUE_H
+#define YOSEMITE_UTILS_EVENT_QUEUE_H
+
+#include "utils/event_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace yosemite {
+
+/* Asynchronous host event pipeline.
+
+Callbacks push pooled records into a bounded multi-producer ring; a single
+consumer thread pops them in ring order and hands them to the dispatcher in
+batches. While a batch is being dispatched the consumer holds the dispatch
+mutex, so code that calls into the tools directly (gpu_data_analysis,
+query_ranges, flush) first drain()s the queue and then runs under the same
+mutex.
+
+When the ring is full the backpressure policy decides what happens:
+  block - the producer waits for a free slot (lossless, default)
+  drop  - memcpy/memset records are dropped and counted; paired events
+          (alloc/free, kernel start/end, tensor, operator) still block,
+          because tools assume they always arrive in pairs
+  spill - the record goes to an unbounded overflow list that the consumer
+          drains after the ring; once spilling starts every producer
+          spills until the consumer catches up, so ordering is preserved
+*/
+
+typedef enum {
+    EventBackpressure_BLOCK = 0,
+    EventBackpressure_DROP = 1,
+    EventBackpressure_SPILL = 2,
+} EventBackpressure_t;
+
+const char* event_backpressure_name(EventBackpressure_t policy);
+
+class EventQueue {
+public:
+    typedef std::function<void(const EventRecord_t&)> Handler_t;
+
+    EventQueue(uint32_t capacity, EventBackpressure_t policy);
+
+    ~EventQueue();
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    void start(Handler_t handler);
+
+    // Joins the consumer thread, then dispatches everything still queued,
+    // including records of producers that were mid-push. Records pushed
+    // afterwards are dispatched inline, in the pushing thread.
+    void stop();
+
+    void push(EventRecordRef record);
+
+    // Waits until every record pushed before the call has been dispatched
+    // and returns the dispatch lock, which keeps the consumer out of the
+    // tools until it is released.
+    std::unique_lock<std::mutex> drain();
+
+    uint32_t capacity() const { return _capacity; }
+
+    EventBackpressure_t policy() const { return _policy; }
+
+    uint64_t dispatched() const { return _dispatched.load(std::memory_order_relaxed); }
+
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    uint64_t spilled() const { return _spilled.load(std::memory_order_relaxed); }
+
+    uint64_t blocked() const { return _blocked.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<uint64_t> seq{0};
+        EventRecordRef record;
+    };
+
+    static constexpr uint32_t k_batch_size = 256;
+
+    bool try_enqueue(EventRecordRef& record);
+
+    bool try_dequeue(EventRecordRef& record);
+
+    void enqueue(EventRecordRef record);
+
+    uint32_t dispatch_batch();
+
+    void push_spill(EventRecordRef record);
+
+    void wake_consumer();
+
+    void consumer_loop();
+
+    bool drained(uint64_t ring_target, uint64_t spill_target) const;
+
+    const uint32_t _capacity;
+    const uint64_t _mask;
+    const EventBackpressure_t _policy;
+    std::unique_ptr<Cell[]> _cells;
+
+    alignas(64) std::atomic<uint64_t> _tail{0};
+    alignas(64) std::atomic<uint64_t> _head{0};    // dispatched ring position
+    uint64_t _read_pos = 0;                         // consumer-only
+
+    // overflow list for EventBackpressure_SPILL
+    std::mutex _spill_mutex;
+    std::deque<EventRecordRef> _spill;
+    std::atomic<bool> _spilling{false};
+    std::atomic<uint64_t> _spill_pushed{0};
+    std::atomic<uint64_t> _spill_popped{0};
+
+    Handler_t _handler;
+    std::thread _consumer;
+    std::mutex _dispatch_mutex;
+
+    std::mutex _wake_mutex;
+    std::condition_variable _wake_cv;
+    std::condition_variable _drain_cv;
+    std::atomic<bool> _consumer_sleeping{false};
+    std::atomic<uint32_t> _drain_waiters{0};
+    std::atomic<bool> _stop{false};
+    // set once the consumer has exited; producers inside push() are counted
+    // so stop() can wait for their records
+    std::atomic<bool> _stopped{false};
+    std::atomic<uint32_t> _producers{0};
+
+    std::atomic<uint64_t> _dispatched{0};
+    std::atomic<uint64_t> _dropped{0};
+    std::atomic<uint64_t> _spilled{0};
+    std::atomic<uint64_t> _blocked{0};
+};
+
+}   // yosemite
+
+#endif // YOSEMITE_UTILS_EVENT_QUEUE_H
@@ -0,0 +1,122 @@
+#ifndef YOSEMITE_UTILS_GPU_INGEST_H
+#define YOSEMITE_UTILS_GPU_INGEST_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace yosemite {
+
+// What the frontend hands to gpu_data_analysis(data, size) for a patch.
+typedef enum {
+    GpuDataLayout_NONE = 0,         // only `size` is meaningful
+    GpuDataLayout_ACCESSES = 1,     // `size` MemoryAccess records
+    GpuDataLayout_TRACKER = 2,      // one MemoryAccessTracker and its two state tables
+    GpuDataLayout_ACCESS_STATE = 3, // one MemoryAccessState
+    GpuDataLayout_NVBIT_ACCESS = 4, // one nvbit_mem_access_t
+} GpuDataLayout_t;
+
+GpuDataLayout_t gpu_data_layout(uint32_t patch_name);
+
+/* Asynchronous ingestion of GPU trace buffers.
+
+submit() leases the caller's buffer to the analyzer and returns a token
+right away; a dedicated thread runs the tools over the buffers in
+submission order and releases each lease when the tools are done with it.
+At most max_in_flight buffers are leased at once (2 = double buffering).
+
+When all leases are taken, submit() either blocks until the oldest one is
+released or, if a spill file is configured, appends the raw buffer to the
+file and releases the lease immediately. Spilled buffers are read back and
+analyzed in their original order, so the GPU side never waits on analysis
+for longer than one buffer copy. Spilling needs flat buffers of `size`
+records of record_bytes each; with record_bytes == 0 submit() always blocks.
+*/
+class GpuDataIngest {
+public:
+    typedef std::function<void(void* data, uint64_t size)> Handler_t;
+
+    GpuDataIngest(uint32_t max_in_flight, const std::string& spill_path, uint64_t record_bytes, Handler_t handler);
+
+    ~GpuDataIngest();
+
+    GpuDataIngest(const GpuDataIngest&) = delete;
+    GpuDataIngest& operator=(const GpuDataIngest&) = delete;
+
+    uint64_t submit(void* data, uint64_t size);
+
+    // True once the buffer behind the token may be reused by the caller.
+    bool poll(uint64_t token);
+
+    void wait(uint64_t token);
+
+    // Blocks until every submitted buffer, spilled ones included, has been analyzed.
+    void drain();
+
+    void stop();
+
+    uint32_t max_in_flight() const { return _max_in_flight; }
+
+    uint64_t submitted() const { return _next_token - 1; }
+
+    uint64_t spilled() const { return _spilled; }
+
+    uint64_t spilled_bytes() const { return _spilled_bytes; }
+
+    uint64_t blocked() const { return _blocked; }
+
+private:
+    typedef struct Job {
+        uint64_t token;
+        void* data;
+        uint64_t size;
+        bool spilled;
+        uint64_t file_offset;
+        uint64_t file_bytes;
+    } Job_t;
+
+    bool spill(Job_t& job);
+
+    void worker_loop();
+
+    const uint32_t _max_in_flight;
+    const std::string _spill_path;
+    const uint64_t _record_bytes;
+    Handler_t _handler;
+
+    std::mutex _mutex;
+    std::condition_variable _job_cv;
+    std::condition_variable _done_cv;
+    std::deque<Job_t> _jobs;
+    bool _busy = false;
+    bool _stop = false;
+
+    uint64_t _next_token = 1;
+    uint32_t _leased = 0;
+    // tokens whose lease ended at submission time because they were spilled
+    std::set<uint64_t> _released_early;
+    std::atomic<uint64_t> _processed{0};    // tokens are analyzed in order
+
+    FILE* _spill_file = nullptr;
+    uint64_t _spill_offset = 0;
+    uint64_t _spill_pending = 0;
+    std::vector<uint8_t> _spill_buffer;
+
+    uint64_t _spilled = 0;
+    uint64_t _spilled_bytes = 0;
+    uint64_t _blocked = 0;
+
+    std::thread _worker;
+};
+
+}   // yosemite
+
+#endif // YOSEMITE_UTILS_GPU_INGEST_H
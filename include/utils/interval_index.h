@@ -0,0 +1,64 @@
+#ifndef YOSEMITE_UTILS_INTERVAL_INDEX_H
+#define YOSEMITE_UTILS_INTERVAL_INDEX_H
+
+#include "gpu_patch.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace yosemite {
+
+/* Address -> allocation lookup shared by the tools.
+
+Holds disjoint [start, end) intervals (the live allocations or tensors of a
+tool) ordered by start, so inserting, erasing and finding the interval of
+an address are O(log n). Each interval gets a compact id, reused after the
+interval is erased, that tools use to index their own per-allocation data.
+
+find_batch resolves the lanes of a warp record at once; lanes falling into
+the interval of the previous hit (the common case, a coalesced access)
+skip the tree search.
+*/
+
+constexpr uint32_t k_no_interval = 0xFFFFFFFFu;
+
+class IntervalIndex {
+public:
+    // Returns the id of the new interval. An interval starting at the same
+    // address is replaced.
+    uint32_t insert(uint64_t start, uint64_t size);
+
+    // Returns the id the interval had, k_no_interval if none starts there.
+    uint32_t erase(uint64_t start);
+
+    uint32_t find(uint64_t addr) const;
+
+    // ids[i] = find(addrs[i]); zero addresses (inactive lanes) give
+    // k_no_interval. Returns the number of addresses found.
+    uint32_t find_batch(const uint64_t* addrs, uint32_t count, uint32_t* ids) const;
+
+    const MemoryRange& range(uint32_t id) const { return _ranges[id]; }
+
+    // Upper bound of the ids in use, for sizing per-id tables.
+    uint32_t id_limit() const { return static_cast<uint32_t>(_ranges.size()); }
+
+    size_t size() const { return _intervals.size(); }
+
+    void clear();
+
+private:
+    typedef struct Interval {
+        uint64_t end;
+        uint32_t id;
+    } Interval_t;
+
+    std::map<uint64_t, Interval_t> _intervals;  // by start
+    std::vector<MemoryRange> _ranges;           // by id
+    std::vector<uint32_t> _free_ids;
+};
+
+}   // yosemite
+
+#endif // YOSEMITE_UTILS_INTERVAL_INDEX_H
@@ -0,0 +1,77 @@
+#ifndef YOSEMITE_UTILS_KERNEL_FILTER_H
+#define YOSEMITE_UTILS_KERNEL_FILTER_H
+
+#include <cstdint>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace yosemite {
+
+/* Selection of the kernel launches to analyze.
+
+Every launch gets a global index (0, 1, 2, ... in launch order) and an
+index among the launches of the same kernel name. A launch is selected
+when all configured conditions hold:
+  YOSEMITE_KERNEL_INCLUDE   regex that must match the mangled or demangled name
+  YOSEMITE_KERNEL_EXCLUDE   regex that must match neither name
+  YOSEMITE_KERNEL_WINDOWS   global index windows, e.g. "500-600,1000-,42"
+                            (bounds inclusive, an open end runs to the last launch)
+  YOSEMITE_KERNEL_EVERY     N: every Nth launch of each kernel, starting with the first
+MAX_NUM_KERNEL_MONITORED=N is kept as a shorthand for the window "0-(N-1)".
+
+Name conditions are evaluated once per distinct kernel name.
+*/
+
+typedef struct KernelWindow {
+    uint64_t first;
+    uint64_t last;      // inclusive
+} KernelWindow_t;
+
+class KernelFilter {
+public:
+    // Reads the YOSEMITE_KERNEL_* variables. False on a malformed setting.
+    bool configure();
+
+    bool active() const { return _active; }
+
+    // Counts the launch and returns whether it is selected.
+    bool select(const std::string& kernel_name);
+
+    std::string describe() const;
+
+    uint64_t launches() const { return _launches; }
+
+    uint64_t selected() const { return _selected; }
+
+private:
+    typedef struct KernelState {
+        bool name_selected;
+        uint64_t launches;
+    } KernelState_t;
+
+    bool match_name(const std::string& kernel_name) const;
+
+    bool in_windows(uint64_t index) const;
+
+    bool _active = false;
+    bool _has_include = false;
+    bool _has_exclude = false;
+    std::regex _include;
+    std::regex _exclude;
+    std::string _include_text;
+    std::string _exclude_text;
+    std::vector<KernelWindow_t> _windows;
+    uint64_t _every = 1;
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, KernelState_t> _kernels;
+    uint64_t _launches = 0;
+    uint64_t _selected = 0;
+};
+
+}   // yosemite
+
+#endif // YOSEMITE_UTILS_KERNEL_FILTER_H
@@ -0,0 +1,185 @@
+#ifndef YOSEMITE_UTILS_SELF_PROFILE_H
+#define YOSEMITE_UTILS_SELF_PROFILE_H
+
+#include "utils/event.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace yosemite {
+
+/* Self-profiling of the analyzer.
+
+The dispatcher times every call it makes into a tool and files the latency
+under (tool, phase) in a log-linear histogram. Phases are the host event
+types followed by gpu_data, query_ranges, query_tensors and flush. With
+hardware counters enabled, CPU cycles and LLC misses of the calling thread
+are read around each call through perf_event_open.
+
+Calls into one tool instance are serialized by the dispatcher (tools are
+not reentrant), so entries are updated without locking. add_owner() hands
+out the owner's rows once, under a lock; the dispatcher keeps them next to
+the tool and passes them to every ProfileScope, so timed calls never look
+an owner up.
+*/
+
+typedef enum {
+    ProfilePhase_GPU_DATA = EventTypeCount,
+    ProfilePhase_QUERY_RANGES,
+    ProfilePhase_QUERY_TENSORS,
+    ProfilePhase_FLUSH,
+    ProfilePhaseCount,
+} ProfilePhase_t;
+
+const char* profile_phase_name(uint32_t phase);
+
+
+/* Histogram with 16 linear sub-buckets per power of two: values below 16
+are exact, larger ones are within 1/16 of their bucket's lower bound. */
+class LatencyHistogram {
+public:
+    static constexpr uint32_t k_sub_bits = 4;
+    static constexpr uint32_t k_sub_buckets = 1u << k_sub_bits;
+    static constexpr uint32_t k_bucket_count = (64 - k_sub_bits + 1) * k_sub_buckets;
+
+    static uint32_t bucket_index(uint64_t value);
+
+    static uint64_t bucket_lower(uint32_t index);
+
+    static uint64_t bucket_upper(uint32_t index);
+
+    void record(uint64_t value);
+
+    // Upper bound of the bucket holding the given quantile, at most max().
+    uint64_t percentile(double quantile) const;
+
+    uint64_t bucket(uint32_t index) const { return _buckets[index]; }
+
+    uint64_t count() const { return _count; }
+
+    uint64_t sum() const { return _sum; }
+
+    uint64_t min() const { return _count ? _min : 0; }
+
+    uint64_t max() const { return _max; }
+
+private:
+    std::array<uint64_t, k_bucket_count> _buckets{};
+    uint64_t _count = 0;
+    uint64_t _sum = 0;
+    uint64_t _min = UINT64_MAX;
+    uint64_t _max = 0;
+};
+
+
+typedef struct CounterSample {
+    uint64_t cycles = 0;
+    uint64_t llc_misses = 0;
+} CounterSample_t;
+
+typedef struct ProfileEntry {
+    LatencyHistogram latency;   // nanoseconds
+    uint64_t cycles = 0;
+    uint64_t llc_misses = 0;
+} ProfileEntry_t;
+
+
+class SelfProfiler {
+public:
+    explicit SelfProfiler(bool counters);
+
+    SelfProfiler(const SelfProfiler&) = delete;
+    SelfProfiler& operator=(const SelfProfiler&) = delete;
+
+    // Registers a tool (or other timed component) under a display name and
+    // returns its rows, indexed by phase, valid for the profiler's lifetime.
+    ProfileEntry_t* add_owner(const void* owner, const std::string& name);
+
+    bool counters() const { return _counters.load(std::memory_order_relaxed); }
+
+    // False when the counters cannot be opened on this thread; they are
+    // then turned off for the rest of the run.
+    bool read_counters(CounterSample_t& sample);
+
+    void add_events(uint64_t count) { _events.fetch_add(count, std::memory_order_relaxed); }
+
+    void add_gpu_data(uint64_t records, uint64_t bytes) {
+        _gpu_buffers.fetch_add(1, std::memory_order_relaxed);
+        _gpu_records.fetch_add(records, std::memory_order_relaxed);
+        _gpu_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void print_summary(FILE* out) const;
+
+    bool write_json(const std::string& path) const;
+
+private:
+    typedef struct Owner {
+        const void* owner;
+        std::string name;
+        std::vector<ProfileEntry_t> entries;    // indexed by phase
+    } Owner_t;
+
+    uint64_t analyzer_ns() const;
+
+    double wall_seconds() const;
+
+    mutable std::mutex _owners_mutex;
+    std::deque<Owner_t> _owners;    // owners never move, so rows handed out stay valid
+    std::atomic<bool> _counters;
+    std::chrono::steady_clock::time_point _start;
+    std::atomic<uint64_t> _events{0};
+    std::atomic<uint64_t> _gpu_buffers{0};
+    std::atomic<uint64_t> _gpu_records{0};
+    std::atomic<uint64_t> _gpu_bytes{0};
+};
+
+
+// Times one call into the owner of `rows` (from add_owner); does nothing
+// when `profiler` or `rows` is null.
+class ProfileScope {
+public:
+    ProfileScope(SelfProfiler* profiler, ProfileEntry_t* rows, uint32_t phase)
+        : _profiler(rows ? profiler : nullptr) {
+        if (!_profiler) {
+            return;
+        }
+        _entry = &rows[phase];
+        _counted = _profiler->counters() && _profiler->read_counters(_counters);
+        _start = std::chrono::steady_clock::now();
+    }
+
+    ~ProfileScope() {
+        if (!_profiler) {
+            return;
+        }
+        const auto end = std::chrono::steady_clock::now();
+        _entry->latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - _start).count());
+        CounterSample_t counters;
+        if (_counted && _profiler->read_counters(counters)) {
+            _entry->cycles += counters.cycles - _counters.cycles;
+            _entry->llc_misses += counters.llc_misses - _counters.llc_misses;
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    SelfProfiler* _profiler;
+    ProfileEntry_t* _entry = nullptr;
+    bool _counted = false;
+    CounterSample_t _counters;
+    std::chrono::steady_clock::time_point _start;
+};
+
+}   // yosemite
+
+#endif // YOSEMITE_UTILS_SELF_PROFILE_H
@@ -0,0 +1,181 @@
+#ifndef YOSEMITE_UTILS_TRACE_CAPTURE_H
+#define YOSEMITE_UTILS_TRACE_CAPTURE_H
+
+#include "utils/event_pool.h"
+#include "utils/gpu_ingest.h"
+#include "gpu_patch.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace yosemite {
+
+/* Binary capture of everything that enters the analyzer.
+
+File layout (version 2):
+  magic "YSMCAPT\0", uint32 version (little endian)
+  header: varint patch_name, varint sample_rate, string tool_names
+  items:  one kind byte followed by its payload
+    0..9   host event, kind == EventType_t, fields as varints in the
+           order of the matching *Record_t in utils/event_pool.h
+           (signed fields zigzag encoded, names as capture name ids)
+    NAME   varint id, string          (first use of a kernel/op name)
+    DATA   varint size, signed device, varint byte count, bytes
+                                      (one gpu_data_analysis call, packed
+                                      according to the header's patch)
+    QUERY_RANGES / QUERY_TENSORS      varint limit
+    END                               (written by yosemite_terminate)
+  strings are a varint length followed by the bytes.
+
+Record timestamps are not stored, replay renumbers them in file order.
+Version 1 DATA items have no device; the reader reports them as device -1.
+*/
+
+constexpr uint32_t k_capture_version = 2;
+constexpr uint32_t k_capture_min_version = 1;  // oldest version the reader accepts
+
+// Bytes of analyzer input behind one gpu_data_analysis(data, size) call.
+uint64_t gpu_data_bytes(GpuDataLayout_t layout, uint64_t size);
+
+typedef enum {
+    CaptureItem_EVENT = 0,
+    CaptureItem_GPU_DATA = 1,
+    CaptureItem_QUERY_RANGES = 2,
+    CaptureItem_QUERY_TENSORS = 3,
+    CaptureItem_END = 4,
+} CaptureItemKind_t;
+
+typedef struct CaptureHeader {
+    uint32_t version = k_capture_version;
+    uint32_t patch_name = 0;
+    uint32_t sample_rate = 1;
+    std::string tool_names;
+} CaptureHeader_t;
+
+typedef struct CaptureItem {
+    CaptureItemKind_t kind;
+    EventRecord_t record;       // CaptureItem_EVENT, name ids index CaptureReader::name()
+    void* data;                 // CaptureItem_GPU_DATA, arguments for gpu_data_analysis,
+    uint64_t size;              // valid until the next call to next()
+    uint64_t bytes;             // packed size of the buffer in the capture
+    int device_id;              // device the buffer came from, -1 if unknown
+    uint32_t limit;             // CaptureItem_QUERY_*
+} CaptureItem_t;
+
+
+class CaptureWriter {
+public:
+    CaptureWriter() = default;
+
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    bool open(const std::string& path, const CaptureHeader_t& header);
+
+    // Writes the END marker and closes the file.
+    void close();
+
+    void write_event(const EventRecord_t& record);
+
+    // `data` and `size` as passed to gpu_data_analysis, `device_id` the
+    // device the buffer was analyzed for.
+    void write_gpu_data(const void* data, uint64_t size, int device_id);
+
+    void write_query(CaptureItemKind_t kind, uint32_t limit);
+
+    uint64_t items() const { return _items; }
+
+    uint64_t bytes() const { return _bytes; }
+
+private:
+    static constexpr size_t k_buffer_size = 1 << 20;
+
+    uint32_t capture_name(uint32_t name_id);
+
+    void put_varint(uint64_t value);
+
+    void put_signed(int64_t value);
+
+    void put_string(const std::string& value);
+
+    void put_bytes(const void* data, uint64_t size);
+
+    void flush_buffer();
+
+    std::mutex _mutex;
+    FILE* _file = nullptr;
+    std::string _path;
+    GpuDataLayout_t _layout = GpuDataLayout_NONE;
+    std::vector<uint8_t> _buffer;
+    // EventNameTable id -> capture name id
+    std::unordered_map<uint32_t, uint32_t> _names;
+    uint64_t _items = 0;
+    uint64_t _bytes = 0;
+};
+
+
+class CaptureReader {
+public:
+    CaptureReader() = default;
+
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    bool open(const std::string& path);
+
+    const CaptureHeader_t& header() const { return _header; }
+
+    // False at the end of the capture. A capture cut short (e.g. the
+    // application crashed) ends at its last complete item.
+    bool next(CaptureItem_t& item);
+
+    const std::string& name(uint32_t id) const;
+
+    bool truncated() const { return _truncated; }
+
+private:
+    static constexpr size_t k_buffer_size = 1 << 20;
+
+    bool fill(size_t count);
+
+    bool get_bytes(void* dst, size_t count);
+
+    bool get_varint(uint64_t& value);
+
+    bool get_signed(int64_t& value);
+
+    bool get_string(std::string& value);
+
+    bool read_event(EventType_t evt_type, EventRecord_t& record);
+
+    bool read_gpu_data(CaptureItem_t& item);
+
+    FILE* _file = nullptr;
+    std::vector<uint8_t> _buffer;
+    size_t _pos = 0;
+    size_t _end = 0;
+    GpuDataLayout_t _layout = GpuDataLayout_NONE;
+    std::vector<uint8_t> _data;
+    // GpuDataLayout_TRACKER: the tracker handed out points at these
+    MemoryAccessTracker _tracker;
+    std::unique_ptr<MemoryAccessState> _access_state;
+    std::unique_ptr<TensorAccessState> _tensor_state;
+    std::vector<std::string> _names;
+    CaptureHeader_t _header;
+    uint64_t _sequence = 0;
+    bool _done = false;
+    bool _truncated = false;
+};
+
+}   // yosemite
+
+#endif // YOSEMITE_UTILS_TRACE_CAPTURE_H
@@ -0,0 +1,74 @@
+/* sanalyzer-depgraph: convert the binary dependency graphs PcDependency
+writes (kernel_N.ydg) to the JSON the CFG joins read, next to each input.
+
+    sanalyzer-depgraph dependency_app/kernel_*.ydg
+
+With -s, only print a one-line summary of each graph.
+*/
+#include "utils/dependency_graph.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace yosemite;
+
+
+static void print_summary(const std::string& path, const DependencyGraph_t& graph) {
+    uint64_t dist[DependencyDistCount] = {};
+    for (const auto& edge : graph.edges) {
+        for (uint32_t idx = 0; idx < DependencyDistCount; ++idx) {
+            dist[idx] += edge.dist[idx];
+        }
+    }
+    fprintf(stdout, "%s: kernel %lu %s, %zu nodes, %zu edges",
+            path.c_str(), graph.kernel.kernel_id, graph.kernel.kernel_name.c_str(),
+            graph.nodes.size(), graph.edges.size());
+    for (uint32_t idx = 0; idx < DependencyDistCount; ++idx) {
+        fprintf(stdout, ", %s %lu", dependency_dist_name(idx), dist[idx]);
+    }
+    uint64_t bank_replays = 0;
+    for (const auto& node : graph.nodes) {
+        bank_replays += dependency_bank_replays(node);
+    }
+    fprintf(stdout, ", bank replays %lu\n", bank_replays);
+}
+
+
+int main(int argc, char** argv) {
+    int first = 1;
+    bool summary = false;
+    if (argc > 1 && strcmp(argv[1], "-s") == 0) {
+        summary = true;
+        first = 2;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "Usage: %s [-s] <graph_file>...\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int idx = first; idx < argc; ++idx) {
+        const std::string path = argv[idx];
+        DependencyGraph_t graph;
+        if (!read_dependency_graph(path, graph)) {
+            failed++;
+            continue;
+        }
+        if (summary) {
+            print_summary(path, graph);
+            continue;
+        }
+        const size_t dot = path.rfind('.');
+        const size_t slash = path.rfind('/');
+        const bool has_ext = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+        const std::string json_path = (has_ext ? path.substr(0, dot) : path) + ".json";
+        if (!write_dependency_graph_json(json_path, graph)) {
+            failed++;
+            continue;
+        }
+        fprintf(stdout, "[SANALYZER INFO] Wrote %s.\n", json_path.c_str());
+    }
+    fflush(stdout);
+    return failed ? 1 : 0;
+}
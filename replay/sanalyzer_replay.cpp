@@ -0,0 +1,143 @@
+/* sanalyzer-replay: feed a capture written with YOSEMITE_CAPTURE_FILE back
+through the yosemite_* interface, without a GPU or the original application.
+
+    YOSEMITE_TOOL_NAME=pc_dependency_analysis sanalyzer-replay app.yscap
+
+Tools are selected with the usual environment variables; when
+YOSEMITE_TOOL_NAME is not set, the tools of the recorded run are used.
+A capture only holds the launches the kernel filters (YOSEMITE_KERNEL_*)
+selected while recording, so replay it without them.
+*/
+#include "sanalyzer.h"
+#include "utils/trace_capture.h"
+#include "gpu_patch.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace yosemite;
+
+
+static void replay_event(const CaptureReader& reader, const EventRecord_t& record) {
+    const int device_id = record.device_id;
+    switch (record.evt_type) {
+        case EventType_KERNEL_LAUNCH: {
+            const auto& r = record.kernel_launch;
+            yosemite_kernel_start_callback(reader.name(r.name_id), device_id,
+                                           r.grid_dim_x, r.grid_dim_y, r.grid_dim_z,
+                                           r.block_dim_x, r.block_dim_y, r.block_dim_z);
+            break;
+        }
+        case EventType_KERNEL_END:
+            yosemite_kernel_end_callback(reader.name(record.kernel_end.name_id), device_id);
+            break;
+        case EventType_MEM_ALLOC: {
+            const auto& r = record.mem_alloc;
+            yosemite_alloc_callback(r.addr, r.size, r.alloc_type, device_id);
+            break;
+        }
+        case EventType_MEM_FREE: {
+            const auto& r = record.mem_free;
+            yosemite_free_callback(r.addr, r.size, r.alloc_type, device_id);
+            break;
+        }
+        case EventType_MEM_COPY: {
+            const auto& r = record.mem_cpy;
+            yosemite_memcpy_callback(r.dst_addr, r.src_addr, r.size, r.is_async, r.direction, device_id);
+            break;
+        }
+        case EventType_MEM_SET: {
+            const auto& r = record.mem_set;
+            yosemite_memset_callback(r.addr, static_cast<uint32_t>(r.size), static_cast<int>(r.value), r.is_async, device_id);
+            break;
+        }
+        case EventType_TEN_ALLOC: {
+            const auto& r = record.ten_alloc;
+            yosemite_tensor_malloc_callback(r.addr, r.size, r.allocated_size, r.reserved_size, device_id);
+            break;
+        }
+        case EventType_TEN_FREE: {
+            const auto& r = record.ten_free;
+            yosemite_tensor_free_callback(r.addr, r.size, r.allocated_size, r.reserved_size, device_id);
+            break;
+        }
+        case EventType_OP_START:
+            yosemite_operator_start_callback(record.op_start.ctx, reader.name(record.op_start.name_id));
+            break;
+        case EventType_OP_END:
+            yosemite_operator_end_callback(record.op_end.ctx, reader.name(record.op_end.name_id));
+            break;
+        default:
+            break;
+    }
+}
+
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <capture_file>\n", argv[0]);
+        return 1;
+    }
+
+    CaptureReader reader;
+    if (!reader.open(argv[1])) {
+        return 1;
+    }
+    const CaptureHeader_t& header = reader.header();
+    if (!std::getenv("YOSEMITE_TOOL_NAME")) {
+        setenv("YOSEMITE_TOOL_NAME", header.tool_names.c_str(), 1);
+    }
+    fprintf(stdout, "[SANALYZER INFO] Replaying %s, recorded with tools %s.\n", argv[1], header.tool_names.c_str());
+    fflush(stdout);
+
+    AccelProfOptions_t options;
+    if (yosemite_init(options) != YOSEMITE_SUCCESS) {
+        return 1;
+    }
+    if (options.patch_name != GPU_NO_PATCH && options.patch_name != header.patch_name) {
+        fprintf(stderr, "[SANALYZER ERROR] The tools expect GPU patch %d but the capture holds data of patch %u.\n",
+                options.patch_name, header.patch_name);
+        fflush(stderr);
+    }
+
+    uint64_t events = 0;
+    uint64_t buffers = 0;
+    uint64_t bytes = 0;
+    std::vector<MemoryRange> ranges;
+    const auto start = std::chrono::steady_clock::now();
+
+    CaptureItem_t item;
+    while (reader.next(item)) {
+        if (item.kind == CaptureItem_EVENT) {
+            replay_event(reader, item.record);
+            events++;
+        } else if (item.kind == CaptureItem_GPU_DATA) {
+            yosemite_gpu_data_analysis(item.data, item.size, item.device_id);
+            buffers++;
+            bytes += item.bytes;
+        } else if (item.kind == CaptureItem_QUERY_RANGES || item.kind == CaptureItem_QUERY_TENSORS) {
+            ranges.resize(item.limit);
+            uint32_t count = 0;
+            if (item.kind == CaptureItem_QUERY_RANGES) {
+                yosemite_query_active_ranges(ranges.data(), item.limit, &count);
+            } else {
+                yosemite_query_active_tensors(ranges.data(), item.limit, &count);
+            }
+        }
+    }
+    if (reader.truncated()) {
+        fprintf(stderr, "[SANALYZER ERROR] Capture %s is truncated, replayed up to the last complete item.\n", argv[1]);
+        fflush(stderr);
+    }
+
+    yosemite_terminate();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stdout, "[SANALYZER INFO] Replayed %lu events and %lu GPU buffers (%lu bytes) in %.3f s, %.1f MB/s.\n",
+            events, buffers, bytes, seconds, seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+    fflush(stdout);
+    return 0;
+}
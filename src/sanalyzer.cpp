@@ -2,6 +2,13 @@
 
 #include "tools/tool.h"
 #include "utils/event.h"
+#include "utils/event_pool.h"
+#include "utils/event_queue.h"
+#include "utils/gpu_ingest.h"
+#include "utils/access_trace.h"
+#include "utils/trace_capture.h"
+#include "utils/self_profile.h"
+#include "utils/kernel_filter.h"
 #include "tools/code_check.h"
 #include "tools/app_metric.h"
 #include "tools/roofline_flops.h"
@@ -23,118 +30,794 @@
 #include <memory>
 #include <map>
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <algorithm>
+#include <dirent.h>
 
 using namespace yosemite;
 
 static std::map<AnalysisTool_t, std::shared_ptr<Tool>> _tools;
+static std::map<AnalysisTool_t, std::string> _tool_names;
 
+// A tool the dispatcher calls, with its self-profile rows (null unless
+// YOSEMITE_SELF_PROFILE=1), resolved once when the tool is registered.
+typedef struct ToolSlot {
+    Tool* tool;
+    ProfileEntry_t* profile;
+} ToolSlot_t;
 
-YosemiteResult_t yosemite_tool_enable(AnalysisTool_t& tool) {
-    const char* tool_name = std::getenv("YOSEMITE_TOOL_NAME");
-    if (!tool_name) {
-        fprintf(stdout, "[SANALYZER ERROR] No tool name specified.\n");
-        return YOSEMITE_NOT_IMPLEMENTED;
+// Self-profile rows of the tools created at startup.
+static std::map<AnalysisTool_t, ProfileEntry_t*> _tool_profiles;
+
+// Flat per-event-type subscriber lists, built once from Tool::event_mask()
+// after the tools are enabled. Indexed by EventType_t.
+static std::vector<ToolSlot_t> _event_subscribers[EventTypeCount];
+
+// Tools the dispatcher calls directly: all of them, or with device shards
+// only those without shard support.
+static std::vector<ToolSlot_t> _tool_list;
+
+typedef void (Tool::*EventHook_t)(const EventRecord_t&);
+
+static const EventHook_t _event_hooks[EventTypeCount] = {
+    &Tool::kernel_start_callback,   // EventType_KERNEL_LAUNCH
+    &Tool::kernel_end_callback,     // EventType_KERNEL_END
+    &Tool::mem_alloc_callback,      // EventType_MEM_ALLOC
+    &Tool::mem_free_callback,       // EventType_MEM_FREE
+    &Tool::mem_cpy_callback,        // EventType_MEM_COPY
+    &Tool::mem_set_callback,        // EventType_MEM_SET
+    &Tool::ten_alloc_callback,      // EventType_TEN_ALLOC
+    &Tool::ten_free_callback,       // EventType_TEN_FREE
+    &Tool::op_start_callback,       // EventType_OP_START
+    &Tool::op_end_callback,         // EventType_OP_END
+};
+
+static EventPool _event_pool;
+static std::atomic<uint64_t> _event_sequence{0};
+
+// Non-null when YOSEMITE_ASYNC_EVENTS=1: callbacks only enqueue records and
+// a background consumer runs the tools.
+static std::unique_ptr<EventQueue> _event_queue;
+
+// Non-null when YOSEMITE_ASYNC_GPU_DATA=1: GPU buffers are analyzed on the
+// ingest thread and returned to the frontend through completion tokens.
+static std::unique_ptr<GpuDataIngest> _gpu_ingest;
+
+// Shared MemoryAccess decoding for the trace tools; tracks device allocations
+// itself so region lookups happen once per record for all of them.
+static AccessTraceDecoder _access_decoder;
+static ProfileEntry_t* _access_decoder_profile = nullptr;
+static bool _access_trace_enabled = false;
+
+// Non-null when YOSEMITE_CAPTURE_FILE is set: every host event and GPU
+// buffer is also written to a capture file for sanalyzer-replay.
+static std::unique_ptr<CaptureWriter> _capture;
+
+// Non-null when YOSEMITE_SELF_PROFILE=1: every call into a tool is timed.
+static std::unique_ptr<SelfProfiler> _self_profile;
+static GpuDataLayout_t _gpu_data_layout = GpuDataLayout_NONE;
+
+// Options passed to yosemite_init; kernel_selected is reported through them,
+// overwritten by every launching thread (see AccelProfOptions_t).
+static AccelProfOptions_t* _options = nullptr;
+
+static KernelFilter _kernel_filter;
+// devices whose running kernel was filtered out, its end is dropped too
+static std::mutex _filtered_mutex;
+static std::unordered_set<int> _filtered_devices;
+
+// YOSEMITE_DEVICE_SHARDS=1: tools supporting it (Tool::device_shards) get
+// one instance per device. Each device has its own trace decoder and
+// analysis thread, so buffers of different GPUs are analyzed concurrently;
+// the instances created at startup only collect the shards' results at flush.
+typedef struct ShardTool {
+    Tool* startup;                  // instance the shard is merged into
+    std::shared_ptr<Tool> shard;
+    ProfileEntry_t* profile;
+} ShardTool_t;
+
+typedef struct DeviceShard {
+    int device_id;
+    uint32_t index;
+    std::vector<ShardTool_t> tools;
+    std::vector<ToolSlot_t> event_subscribers[EventTypeCount];
+    AccessTraceDecoder access_decoder;
+    ProfileEntry_t* access_decoder_profile = nullptr;
+    std::unique_ptr<GpuDataIngest> ingest;
+} DeviceShard_t;
+
+static bool _device_shards_enabled = false;
+static uint32_t _device_shard_in_flight = 2;
+static uint32_t _device_shard_count = 1;   // devices expected to get shards
+static uint32_t _shard_event_mask = 0;
+static std::mutex _device_shards_mutex;
+static std::vector<std::unique_ptr<DeviceShard_t>> _device_shards;
+// tools without shards can be reached from every device thread
+static std::mutex _unsharded_mutex;
+// device of the calling thread's last kernel launch
+static thread_local int _thread_device = 0;
+
+// async tokens of a shard carry its index + 1 in the top bits
+static constexpr uint32_t k_shard_token_shift = 48;
+
+
+static inline EventRecordRef new_event_record(EventType_t evt_type, int device_id) {
+    EventRecordRef record(_event_pool);
+    record->timestamp = _event_sequence.fetch_add(1, std::memory_order_relaxed);
+    record->evt_type = evt_type;
+    record->device_id = device_id;
+    return record;
+}
+
+
+static inline ProfileEntry_t* tool_profile(AnalysisTool_t tool) {
+    auto it = _tool_profiles.find(tool);
+    return it != _tool_profiles.end() ? it->second : nullptr;
+}
+
+
+static void build_event_subscribers() {
+    for (uint32_t type = 0; type < EventTypeCount; type++) {
+        _event_subscribers[type].clear();
+    }
+    _tool_list.clear();
+    _shard_event_mask = 0;
+    for (auto &tool : _tools) {
+        const uint32_t mask = tool.second->event_mask();
+        if (_device_shards_enabled && tool.second->device_shards()) {
+            _shard_event_mask |= mask;
+            continue;
+        }
+        const ToolSlot_t slot = {tool.second.get(), tool_profile(tool.first)};
+        _tool_list.push_back(slot);
+        for (uint32_t type = 0; type < EventTypeCount; type++) {
+            if (mask & event_bit(static_cast<EventType_t>(type))) {
+                _event_subscribers[type].push_back(slot);
+            }
+        }
+    }
+}
+
+
+static inline bool has_event_subscribers(EventType_t evt_type) {
+    return !_event_subscribers[evt_type].empty() || (_shard_event_mask & event_bit(evt_type));
+}
+
+
+// A capture keeps every event so it can be replayed into any tool later.
+static inline bool event_wanted(EventType_t evt_type) {
+    return has_event_subscribers(evt_type) || _capture;
+}
+
+
+// Tools are not reentrant: host events, queries and flushes wait for the
+// GPU buffers submitted before them to be analyzed.
+static inline void sync_gpu_ingest() {
+    if (_gpu_ingest) {
+        _gpu_ingest->drain();
+    }
+}
+
+
+static inline void run_tool_gpu_data(const ToolSlot_t& slot, const AccessBatch_t* batch, void* data, uint64_t size) {
+    Tool* tool = slot.tool;
+    ProfileScope scope(_self_profile.get(), slot.profile, ProfilePhase_GPU_DATA);
+    if (batch && tool->access_trace()) {
+        tool->gpu_trace_analysis(*batch);
+    } else {
+        tool->gpu_data_analysis(data, size);
+    }
+}
+
+
+static inline void count_gpu_data(uint64_t size) {
+    if (_self_profile) {
+        const uint64_t records = _gpu_data_layout == GpuDataLayout_ACCESSES ? size : 1;
+        _self_profile->add_gpu_data(records, gpu_data_bytes(_gpu_data_layout, size));
+    }
+}
+
+
+// Runs on the shard's ingest thread.
+static void shard_gpu_data_analysis(DeviceShard_t& shard, void* data, uint64_t size) {
+    count_gpu_data(size);
+    const AccessBatch_t* batch = nullptr;
+    if (_access_trace_enabled) {
+        ProfileScope scope(_self_profile.get(), shard.access_decoder_profile, ProfilePhase_GPU_DATA);
+        batch = &shard.access_decoder.decode(static_cast<const MemoryAccess*>(data), size);
+    }
+    for (auto &tool : shard.tools) {
+        run_tool_gpu_data({tool.shard.get(), tool.profile}, batch, data, size);
+    }
+    if (!_tool_list.empty()) {
+        std::lock_guard<std::mutex> guard(_unsharded_mutex);
+        for (const ToolSlot_t& slot : _tool_list) {
+            run_tool_gpu_data(slot, batch, data, size);
+        }
+    }
+}
+
+
+static DeviceShard_t& device_shard(int device_id) {
+    std::lock_guard<std::mutex> guard(_device_shards_mutex);
+    for (auto &shard : _device_shards) {
+        if (shard->device_id == device_id) {
+            return *shard;
+        }
+    }
+
+    auto shard = std::make_unique<DeviceShard_t>();
+    shard->device_id = device_id;
+    shard->index = static_cast<uint32_t>(_device_shards.size());
+    shard->access_decoder.set_typed(_access_decoder.typed());
+    const std::string suffix = "@gpu" + std::to_string(device_id);
+    for (auto &tool : _tools) {
+        if (!tool.second->device_shards()) {
+            continue;
+        }
+        std::shared_ptr<Tool> instance = tool.second->make_shard(device_id, _device_shard_count);
+        ProfileEntry_t* profile = nullptr;
+        if (_self_profile) {
+            profile = _self_profile->add_owner(instance.get(), _tool_names[tool.first] + suffix);
+        }
+        const uint32_t mask = instance->event_mask();
+        for (uint32_t type = 0; type < EventTypeCount; type++) {
+            if (mask & event_bit(static_cast<EventType_t>(type))) {
+                shard->event_subscribers[type].push_back({instance.get(), profile});
+            }
+        }
+        shard->tools.push_back({tool.second.get(), std::move(instance), profile});
+    }
+    if (_self_profile && _access_trace_enabled) {
+        shard->access_decoder_profile =
+            _self_profile->add_owner(&shard->access_decoder, "access_trace_decoder" + suffix);
+    }
+    DeviceShard_t* raw = shard.get();
+    shard->ingest = std::make_unique<GpuDataIngest>(_device_shard_in_flight, "", 0,
+        [raw](void* data, uint64_t size) { shard_gpu_data_analysis(*raw, data, size); });
+    _device_shards.push_back(std::move(shard));
+
+    fprintf(stdout, "[SANALYZER INFO] Device %d: %lu tool shards.\n", device_id, raw->tools.size());
+    fflush(stdout);
+    return *raw;
+}
+
+
+static std::vector<DeviceShard_t*> device_shards_snapshot() {
+    std::lock_guard<std::mutex> guard(_device_shards_mutex);
+    std::vector<DeviceShard_t*> shards;
+    for (auto &shard : _device_shards) {
+        shards.push_back(shard.get());
+    }
+    return shards;
+}
+
+
+static void drain_device_shards() {
+    if (!_device_shards_enabled) {
+        return;
+    }
+    for (DeviceShard_t* shard : device_shards_snapshot()) {
+        shard->ingest->drain();
+    }
+}
+
+
+static void dispatch_shard_event(DeviceShard_t& shard, const EventRecord_t& record) {
+    shard.ingest->drain();
+    const EventHook_t hook = _event_hooks[record.evt_type];
+    for (const ToolSlot_t& slot : shard.event_subscribers[record.evt_type]) {
+        ProfileScope scope(_self_profile.get(), slot.profile, record.evt_type);
+        (slot.tool->*hook)(record);
+    }
+}
+
+
+// Device events go to their device's shard only (after the buffers that
+// device submitted before them); events without a device go to every shard.
+static void dispatch_device_shards(const EventRecord_t& record) {
+    if (record.device_id >= 0) {
+        dispatch_shard_event(device_shard(record.device_id), record);
+    } else {
+        for (DeviceShard_t* shard : device_shards_snapshot()) {
+            dispatch_shard_event(*shard, record);
+        }
+    }
+    if (!_event_subscribers[record.evt_type].empty()) {
+        std::lock_guard<std::mutex> guard(_unsharded_mutex);
+        const EventHook_t hook = _event_hooks[record.evt_type];
+        for (const ToolSlot_t& slot : _event_subscribers[record.evt_type]) {
+            ProfileScope scope(_self_profile.get(), slot.profile, record.evt_type);
+            (slot.tool->*hook)(record);
+        }
+    }
+}
+
+
+static void merge_device_shards() {
+    for (DeviceShard_t* shard : device_shards_snapshot()) {
+        for (auto &tool : shard->tools) {
+            tool.startup->merge(*tool.shard);
+        }
+    }
+}
+
+
+static inline void dispatch_event_record(const EventRecord_t& record) {
+    sync_gpu_ingest();
+    if (_device_shards_enabled) {
+        if (_self_profile) {
+            _self_profile->add_events(1);
+        }
+        dispatch_device_shards(record);
+        return;
+    }
+    if (_self_profile) {
+        _self_profile->add_events(1);
+    }
+    const EventHook_t hook = _event_hooks[record.evt_type];
+    for (const ToolSlot_t& slot : _event_subscribers[record.evt_type]) {
+        ProfileScope scope(_self_profile.get(), slot.profile, record.evt_type);
+        (slot.tool->*hook)(record);
+    }
+}
+
+
+static inline void submit_event_record(EventRecordRef record) {
+    if (_capture) {
+        _capture->write_event(*record);
+        if (!has_event_subscribers(record->evt_type)) {
+            return;
+        }
+    }
+    if (_event_queue) {
+        _event_queue->push(std::move(record));
+    } else {
+        dispatch_event_record(*record);
+    }
+}
+
+
+// Entry points that call into the tools directly hold this for their
+// duration. In async mode it first waits for the consumer to dispatch
+// every pending record, so e.g. query_ranges sees all earlier allocations.
+static inline std::unique_lock<std::mutex> sync_event_queue() {
+    if (!_event_queue) {
+        sync_gpu_ingest();
+        drain_device_shards();
+        return std::unique_lock<std::mutex>();
+    }
+    auto lock = _event_queue->drain();
+    sync_gpu_ingest();
+    drain_device_shards();
+    return lock;
+}
+
+
+// Positive integer setting `name`, or `default_value` when unset or
+// malformed; a malformed value is reported rather than thrown.
+static uint32_t env_u32(const char* name, uint32_t default_value) {
+    const char* value = std::getenv(name);
+    if (!value) {
+        return default_value;
+    }
+    char* end_ptr = nullptr;
+    const unsigned long parsed = std::strtoul(value, &end_ptr, 10);
+    if (end_ptr == value || *end_ptr != '\0' || parsed == 0
+        || parsed > std::numeric_limits<uint32_t>::max()) {
+        fprintf(stderr, "[SANALYZER ERROR] Invalid %s %s, using %u.\n", name, value, default_value);
+        fflush(stderr);
+        return default_value;
+    }
+    return static_cast<uint32_t>(parsed);
+}
+
+
+static void event_queue_enable() {
+    const char* async_events = std::getenv("YOSEMITE_ASYNC_EVENTS");
+    if (!async_events || std::string(async_events) != "1") {
+        return;
+    }
+
+    const uint32_t capacity = env_u32("YOSEMITE_EVENT_QUEUE_SIZE", 65536);
+
+    EventBackpressure_t policy = EventBackpressure_BLOCK;
+    const char* backpressure = std::getenv("YOSEMITE_EVENT_BACKPRESSURE");
+    if (backpressure) {
+        if (std::string(backpressure) == "drop") {
+            policy = EventBackpressure_DROP;
+        } else if (std::string(backpressure) == "spill") {
+            policy = EventBackpressure_SPILL;
+        } else if (std::string(backpressure) != "block") {
+            fprintf(stderr, "[SANALYZER ERROR] Unknown YOSEMITE_EVENT_BACKPRESSURE %s, using block.\n", backpressure);
+            fflush(stderr);
+        }
+    }
+
+    _event_queue = std::make_unique<EventQueue>(capacity, policy);
+    _event_queue->start(dispatch_event_record);
+    fprintf(stdout, "[SANALYZER INFO] Async host events enabled, queue size %u, backpressure %s.\n",
+            _event_queue->capacity(), event_backpressure_name(policy));
+    fflush(stdout);
+}
+
+
+static void run_gpu_data_analysis(void* data, uint64_t size) {
+    count_gpu_data(size);
+    const AccessBatch_t* batch = nullptr;
+    if (_access_trace_enabled) {
+        ProfileScope scope(_self_profile.get(), _access_decoder_profile, ProfilePhase_GPU_DATA);
+        batch = &_access_decoder.decode(static_cast<const MemoryAccess*>(data), size);
+    }
+    for (const ToolSlot_t& slot : _tool_list) {
+        run_tool_gpu_data(slot, batch, data, size);
+    }
+}
+
+
+// YOSEMITE_GPU_DEVICE_COUNT, else the devices CUDA_VISIBLE_DEVICES lists,
+// else the GPUs the NVIDIA driver reports.
+static uint32_t device_shards_count() {
+    const char* device_count = std::getenv("YOSEMITE_GPU_DEVICE_COUNT");
+    if (device_count) {
+        char* end_ptr = nullptr;
+        const unsigned long parsed = std::strtoul(device_count, &end_ptr, 10);
+        if (end_ptr != device_count && *end_ptr == '\0' && parsed > 0
+            && parsed <= std::numeric_limits<uint32_t>::max()) {
+            return static_cast<uint32_t>(parsed);
+        }
+        fprintf(stderr, "[SANALYZER ERROR] Invalid YOSEMITE_GPU_DEVICE_COUNT %s, ignored.\n", device_count);
+        fflush(stderr);
+    }
+    uint32_t count = 0;
+    const char* visible_devices = std::getenv("CUDA_VISIBLE_DEVICES");
+    if (visible_devices && *visible_devices != '\0') {
+        std::stringstream devices(visible_devices);
+        std::string device;
+        while (std::getline(devices, device, ',')) {
+            count += device.empty() ? 0 : 1;
+        }
+        return std::max(1u, count);
+    }
+    if (DIR* gpus = opendir("/proc/driver/nvidia/gpus")) {
+        while (const struct dirent* entry = readdir(gpus)) {
+            count += entry->d_name[0] != '.' ? 1 : 0;
+        }
+        closedir(gpus);
+    }
+    return std::max(1u, count);
+}
+
+
+static void device_shards_configure() {
+    const char* device_shards = std::getenv("YOSEMITE_DEVICE_SHARDS");
+    if (!device_shards || std::string(device_shards) != "1") {
+        return;
+    }
+    _device_shard_in_flight = env_u32("YOSEMITE_GPU_BUFFERS_IN_FLIGHT", _device_shard_in_flight);
+    _device_shard_count = device_shards_count();
+    _device_shards_enabled = true;
+    fprintf(stdout, "[SANALYZER INFO] Per-device tool shards enabled for %u devices, %u buffers in flight per device.\n",
+            _device_shard_count, _device_shard_in_flight);
+    fflush(stdout);
+}
+
+
+static void device_shards_disable() {
+    for (DeviceShard_t* shard : device_shards_snapshot()) {
+        shard->ingest->drain();
+        shard->ingest->stop();
+        fprintf(stdout, "[SANALYZER INFO] Device %d: %lu GPU buffers, blocked %lu.\n",
+                shard->device_id, shard->ingest->submitted(), shard->ingest->blocked());
+        fflush(stdout);
+    }
+}
+
+
+static void gpu_ingest_enable(const AccelProfOptions_t& options) {
+    const char* async_gpu_data = std::getenv("YOSEMITE_ASYNC_GPU_DATA");
+    if (!async_gpu_data || std::string(async_gpu_data) != "1") {
+        return;
+    }
+    // device shards analyze asynchronously on their own threads
+    if (_device_shards_enabled) {
+        return;
+    }
+
+    const uint32_t max_in_flight = env_u32("YOSEMITE_GPU_BUFFERS_IN_FLIGHT", 2);
+
+    // only flat MemoryAccess buffers can be spilled, the others point at GPU-side state
+    const bool flat = gpu_data_layout(options.patch_name) == GpuDataLayout_ACCESSES;
+    std::string spill_path;
+    const char* spill_file = std::getenv("YOSEMITE_GPU_DATA_SPILL_FILE");
+    if (spill_file && flat) {
+        spill_path = spill_file;
+    } else if (spill_file) {
+        fprintf(stdout, "[SANALYZER INFO] GPU patch %d does not produce flat buffers, spilling disabled.\n",
+                options.patch_name);
+        fflush(stdout);
+    }
+
+    _gpu_ingest = std::make_unique<GpuDataIngest>(max_in_flight, spill_path, flat ? sizeof(MemoryAccess) : 0,
+                                                  run_gpu_data_analysis);
+    fprintf(stdout, "[SANALYZER INFO] Async GPU data analysis enabled, %u buffers in flight, spill %s.\n",
+            _gpu_ingest->max_in_flight(), spill_path.empty() ? "off" : spill_path.c_str());
+    fflush(stdout);
+}
+
+
+static void gpu_ingest_disable() {
+    if (!_gpu_ingest) {
+        return;
+    }
+    _gpu_ingest->drain();
+    _gpu_ingest->stop();
+    fprintf(stdout, "[SANALYZER INFO] Async GPU data: buffers %lu, blocked %lu, spilled %lu (%lu bytes).\n",
+            _gpu_ingest->submitted(), _gpu_ingest->blocked(), _gpu_ingest->spilled(), _gpu_ingest->spilled_bytes());
+    fflush(stdout);
+    _gpu_ingest.reset();
+}
+
+
+static void event_queue_disable() {
+    if (!_event_queue) {
+        return;
+    }
+    _event_queue->stop();
+    fprintf(stdout, "[SANALYZER INFO] Async host events: dispatched %lu, blocked %lu, dropped %lu, spilled %lu.\n",
+            _event_queue->dispatched(), _event_queue->blocked(), _event_queue->dropped(), _event_queue->spilled());
+    fflush(stdout);
+}
+
+
+static void capture_enable(const AccelProfOptions_t& options) {
+    const char* capture_file = std::getenv("YOSEMITE_CAPTURE_FILE");
+    if (!capture_file) {
+        return;
     }
 
+    CaptureHeader_t header;
+    header.patch_name = options.patch_name;
+    header.sample_rate = options.sample_rate;
+    header.tool_names = std::getenv("YOSEMITE_TOOL_NAME");
+    auto capture = std::make_unique<CaptureWriter>();
+    if (!capture->open(capture_file, header)) {
+        return;
+    }
+    _capture = std::move(capture);
+    fprintf(stdout, "[SANALYZER INFO] Capturing events and GPU data to %s.\n", capture_file);
+    fflush(stdout);
+}
+
+
+static void capture_disable() {
+    if (!_capture) {
+        return;
+    }
+    _capture->close();
+    fprintf(stdout, "[SANALYZER INFO] Capture: %lu items, %lu bytes.\n", _capture->items(), _capture->bytes());
+    fflush(stdout);
+    _capture.reset();
+}
+
+
+static YosemiteResult_t kernel_filter_enable() {
+    if (!_kernel_filter.configure()) {
+        return YOSEMITE_ERROR;
+    }
+    if (_kernel_filter.active()) {
+        fprintf(stdout, "[SANALYZER INFO] Kernel filter:%s.\n", _kernel_filter.describe().c_str());
+        fflush(stdout);
+    }
+    return YOSEMITE_SUCCESS;
+}
+
+
+static void kernel_filter_disable() {
+    if (!_kernel_filter.active()) {
+        return;
+    }
+    fprintf(stdout, "[SANALYZER INFO] Kernel filter selected %lu of %lu launches.\n",
+            _kernel_filter.selected(), _kernel_filter.launches());
+    fflush(stdout);
+}
+
+
+static void self_profile_enable() {
+    const char* self_profile = std::getenv("YOSEMITE_SELF_PROFILE");
+    if (!self_profile || std::string(self_profile) != "1") {
+        return;
+    }
+    const char* counters = std::getenv("YOSEMITE_SELF_PROFILE_COUNTERS");
+    _self_profile = std::make_unique<SelfProfiler>(counters && std::string(counters) == "1");
+    for (auto &tool : _tools) {
+        _tool_profiles[tool.first] = _self_profile->add_owner(tool.second.get(), _tool_names[tool.first]);
+    }
+    if (_access_trace_enabled) {
+        _access_decoder_profile = _self_profile->add_owner(&_access_decoder, "access_trace_decoder");
+    }
+    fprintf(stdout, "[SANALYZER INFO] Self profiling enabled, hardware counters %s.\n",
+            _self_profile->counters() ? "on" : "off");
+    fflush(stdout);
+}
+
+
+static void self_profile_disable() {
+    if (!_self_profile) {
+        return;
+    }
+    _self_profile->print_summary(stdout);
+    const char* profile_file = std::getenv("YOSEMITE_SELF_PROFILE_FILE");
+    const std::string path = profile_file ? profile_file : "sanalyzer_self_profile.json";
+    if (_self_profile->write_json(path)) {
+        fprintf(stdout, "[SANALYZER INFO] Self profile written to %s.\n", path.c_str());
+        fflush(stdout);
+    }
+    // drop the rows held by the subscriber lists before the profiler goes
+    _tool_profiles.clear();
+    _access_decoder_profile = nullptr;
+    build_event_subscribers();
+    _self_profile.reset();
+}
+
+
+static YosemiteResult_t tool_enable_one(const std::string& tool_name, const std::string& device_name, AnalysisTool_t& tool) {
     // nvbit mode
-    const char* yosemite_device_name = std::getenv("YOSEMITE_DEVICE");
-    if (std::string(yosemite_device_name) == "nvbit") {
-        if (std::string(tool_name) == "app_analysis") {
+    if (device_name == "nvbit") {
+        if (tool_name == "app_analysis") {
             tool = APP_ANALYSIS_NVBIT;
             _tools.emplace(APP_ANALYSIS_NVBIT, std::make_shared<AppAnalysisNVBIT>());
-        } else  if (std::string(tool_name) == "roofline_flops") {
+        } else  if (tool_name == "roofline_flops") {
             tool = ROOFLINE_FLOPS;
             _tools.emplace(ROOFLINE_FLOPS, std::make_shared<RooflineFlops>());
         } else {
-            fprintf(stderr, "[SANALYZER ERROR] Unsupported tool in nvbit mode, %s.\n", tool_name);
+            fprintf(stderr, "[SANALYZER ERROR] Unsupported tool in nvbit mode, %s.\n", tool_name.c_str());
             fflush(stderr);
             return YOSEMITE_NOT_IMPLEMENTED;
         }
 
-        fprintf(stdout, "[SANALYZER INFO] Enabling %s tool in nvbit mode.\n", tool_name);
+        fprintf(stdout, "[SANALYZER INFO] Enabling %s tool in nvbit mode.\n", tool_name.c_str());
         fflush(stdout);
         return YOSEMITE_SUCCESS;
     }
 
     // rocm mode
-    if (std::string(yosemite_device_name) == "rocm") {
-        if (std::string(tool_name) == "event_trace") {
+    if (device_name == "rocm") {
+        if (tool_name == "event_trace") {
             tool = EVENT_TRACE;
             _tools.emplace(EVENT_TRACE, std::make_shared<EventTrace>());
         } else {
-            fprintf(stderr, "[SANALYZER ERROR] Unsupported tool in rocm mode, %s.\n", tool_name);
+            fprintf(stderr, "[SANALYZER ERROR] Unsupported tool in rocm mode, %s.\n", tool_name.c_str());
             fflush(stderr);
             return YOSEMITE_NOT_IMPLEMENTED;
         }
-        fprintf(stdout, "[SANALYZER INFO] Enabling %s tool in rocm mode.\n", tool_name);
+        fprintf(stdout, "[SANALYZER INFO] Enabling %s tool in rocm mode.\n", tool_name.c_str());
         fflush(stdout);
         return YOSEMITE_SUCCESS;
     }
 
-    if (std::string(tool_name) == "code_check") {
+    if (tool_name == "code_check") {
         tool = CODE_CHECK;
         _tools.emplace(CODE_CHECK, std::make_shared<CodeCheck>());
-    } else if (std::string(tool_name) == "app_metric") {
+    } else if (tool_name == "app_metric") {
         tool = APP_METRICE;
         _tools.emplace(APP_METRICE, std::make_shared<AppMetrics>());
-    } else if (std::string(tool_name) == "roofline_size") {
+    } else if (tool_name == "roofline_size") {
         tool = ROOFLINE_SIZE;
         _tools.emplace(ROOFLINE_SIZE, std::make_shared<RooflineSize>());
-    } else if (std::string(tool_name) == "roofline_time") {
+    } else if (tool_name == "roofline_time") {
         tool = ROOFLINE_TIME;
         _tools.emplace(ROOFLINE_TIME, std::make_shared<RooflineTime>());
-    } else if (std::string(tool_name) == "mem_trace") {
+    } else if (tool_name == "mem_trace") {
         tool = MEM_TRACE;
         _tools.emplace(MEM_TRACE, std::make_shared<MemTrace>());
-    } else if (std::string(tool_name) == "hot_analysis") {
+    } else if (tool_name == "hot_analysis") {
         tool = HOT_ANALYSIS;
         _tools.emplace(HOT_ANALYSIS, std::make_shared<HotAnalysis>());
-    } else if (std::string(tool_name) == "uvm_advisor") {
+    } else if (tool_name == "uvm_advisor") {
         tool = UVM_ADVISOR;
         _tools.emplace(UVM_ADVISOR, std::make_shared<UVMAdvisor>());
-    } else if (std::string(tool_name) == "app_analysis") {
+    } else if (tool_name == "app_analysis") {
         tool = APP_ANALYSIS;
         _tools.emplace(APP_ANALYSIS, std::make_shared<AppAnalysis>());
-    } else if (std::string(tool_name) == "app_analysis_cpu") {
+    } else if (tool_name == "app_analysis_cpu") {
         tool = APP_ANALYSIS_CPU;
         _tools.emplace(APP_ANALYSIS_CPU, std::make_shared<AppAnalysisCPU>());
-    } else if (std::string(tool_name) == "time_hotness_cpu") {
+    } else if (tool_name == "time_hotness_cpu") {
         tool = TIME_HOTNESS_CPU;
         _tools.emplace(TIME_HOTNESS_CPU, std::make_shared<TimeHotnessCPU>());
-    } else if (std::string(tool_name) == "event_trace") {
+    } else if (tool_name == "event_trace") {
         tool = EVENT_TRACE;
         _tools.emplace(EVENT_TRACE, std::make_shared<EventTrace>());
-    } else if (std::string(tool_name) == "event_trace_mgpu") {
+    } else if (tool_name == "event_trace_mgpu") {
         tool = EVENT_TRACE_MGPU;
         _tools.emplace(EVENT_TRACE_MGPU, std::make_shared<EventTraceMGPU>());
-    } else if (std::string(tool_name) == "heatmap_analysis") {
+    } else if (tool_name == "heatmap_analysis") {
         tool = HEATMAP_ANALYSIS;
         _tools.emplace(HEATMAP_ANALYSIS, std::make_shared<HeatmapAnalysis>());
-    } else if (std::string(tool_name) == "block_divergence_analysis") {
+    } else if (tool_name == "block_divergence_analysis") {
         tool = BLOCK_DIVERGENCE_ANALYSIS;
         _tools.emplace(BLOCK_DIVERGENCE_ANALYSIS, std::make_shared<BlockDivergenceAnalysis>());
-    } else if (std::string(tool_name) == "pc_dependency_analysis") {
+    } else if (tool_name == "pc_dependency_analysis") {
         tool = PC_DEPENDENCY_ANALYSIS;
         _tools.emplace(PC_DEPENDENCY_ANALYSIS, std::make_shared<PcDependency>());
     } else {
-        fprintf(stderr, "[SANALYZER ERROR] Tool not found.\n");
+        fprintf(stderr, "[SANALYZER ERROR] Tool not found, %s.\n", tool_name.c_str());
         fflush(stderr);
         return YOSEMITE_NOT_IMPLEMENTED;
     }
 
-    fprintf(stdout, "[SANALYZER INFO] Enabling %s tool.\n", tool_name);
+    fprintf(stdout, "[SANALYZER INFO] Enabling %s tool.\n", tool_name.c_str());
     fflush(stdout);
     return YOSEMITE_SUCCESS;
 }
 
 
+// YOSEMITE_TOOL_NAME is a comma-separated list, e.g.
+// "heatmap_analysis,block_divergence_analysis,pc_dependency_analysis";
+// `tool` is set to the first one.
+YosemiteResult_t yosemite_tool_enable(AnalysisTool_t& tool) {
+    const char* tool_name = std::getenv("YOSEMITE_TOOL_NAME");
+    if (!tool_name) {
+        fprintf(stdout, "[SANALYZER ERROR] No tool name specified.\n");
+        return YOSEMITE_NOT_IMPLEMENTED;
+    }
+    const char* yosemite_device_name = std::getenv("YOSEMITE_DEVICE");
+    const std::string device_name = yosemite_device_name ? yosemite_device_name : "";
+
+    const std::string tool_list(tool_name);
+    size_t pos = 0;
+    bool first = true;
+    while (pos <= tool_list.size()) {
+        size_t comma = tool_list.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = tool_list.size();
+        }
+        std::string name = tool_list.substr(pos, comma - pos);
+        pos = comma + 1;
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (name.empty()) {
+            continue;
+        }
+
+        AnalysisTool_t enabled;
+        YosemiteResult_t res = tool_enable_one(name, device_name, enabled);
+        if (res != YOSEMITE_SUCCESS) {
+            return res;
+        }
+        _tool_names.emplace(enabled, name);
+        if (first) {
+            tool = enabled;
+            first = false;
+        }
+    }
+
+    if (first) {
+        fprintf(stderr, "[SANALYZER ERROR] No tool name specified.\n");
+        fflush(stderr);
+        return YOSEMITE_NOT_IMPLEMENTED;
+    }
+    return YOSEMITE_SUCCESS;
+}
+
+
 YosemiteResult_t yosemite_tool_disable() {
     return YOSEMITE_SUCCESS;
 }
 
 
 YosemiteResult_t yosemite_flush() {
+    auto lock = sync_event_queue();
+    merge_device_shards();
     for (auto &tool : _tools) {
+        ProfileScope scope(_self_profile.get(), tool_profile(tool.first), ProfilePhase_FLUSH);
         tool.second->flush();
     }
     return YOSEMITE_SUCCESS;
@@ -154,10 +837,12 @@ YosemiteResult_t yosemite_torch_prof_enable() {
 
 
 YosemiteResult_t yosemite_alloc_callback(uint64_t ptr, uint64_t size, int type, int device_id) {
-    for (auto &tool : _tools) {
-        auto mem_alloc = std::make_shared<MemAlloc_t>(ptr, size, type, device_id);
-        tool.second->evt_callback(mem_alloc);
+    if (!event_wanted(EventType_MEM_ALLOC)) {
+        return YOSEMITE_SUCCESS;
     }
+    auto record = new_event_record(EventType_MEM_ALLOC, device_id);
+    record->mem_alloc = {ptr, size, type};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
@@ -166,28 +851,34 @@ YosemiteResult_t yosemite_free_callback(uint64_t ptr, uint64_t size, int type, i
     if (ptr == 0) {
         return YOSEMITE_CUDA_MEMFREE_ZERO;
     }
-    for (auto &tool : _tools) {
-        auto mem_free = std::make_shared<MemFree_t>(ptr, size, type, device_id);
-        tool.second->evt_callback(mem_free);
+    if (!event_wanted(EventType_MEM_FREE)) {
+        return YOSEMITE_SUCCESS;
     }
+    auto record = new_event_record(EventType_MEM_FREE, device_id);
+    record->mem_free = {ptr, size, type};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
 
 YosemiteResult_t yosemite_memcpy_callback(uint64_t dst, uint64_t src, uint64_t size, bool is_async, uint32_t direction, int device_id) {
-    for (auto &tool : _tools) {
-        auto mem_cpy = std::make_shared<MemCpy_t>(dst, src, size, is_async, direction, device_id);
-        tool.second->evt_callback(mem_cpy);
+    if (!event_wanted(EventType_MEM_COPY)) {
+        return YOSEMITE_SUCCESS;
     }
+    auto record = new_event_record(EventType_MEM_COPY, device_id);
+    record->mem_cpy = {src, dst, size, direction, is_async};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
 
 YosemiteResult_t yosemite_memset_callback(uint64_t dst, uint32_t size, int value, bool is_async, int device_id) {
-    for (auto &tool : _tools) {
-        auto mem_set = std::make_shared<MemSet_t>(dst, size, value, is_async, device_id);
-        tool.second->evt_callback(mem_set);
+    if (!event_wanted(EventType_MEM_SET)) {
+        return YOSEMITE_SUCCESS;
     }
+    auto record = new_event_record(EventType_MEM_SET, device_id);
+    record->mem_set = {dst, size, static_cast<uint32_t>(value), is_async};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
@@ -202,46 +893,166 @@ YosemiteResult_t yosemite_kernel_start_callback(
     uint32_t block_dim_y,
     uint32_t block_dim_z
 ) {
-    for (auto &tool : _tools) {
-        auto grid_cta_count =
-            static_cast<uint64_t>(grid_dim_x) * static_cast<uint64_t>(grid_dim_y) * static_cast<uint64_t>(grid_dim_z);
-        auto block_thread_count = block_dim_x * block_dim_y * block_dim_z;
-
-        auto kernel = std::make_shared<KernelLaunch_t>(kernel_name, device_id,
-                                                        grid_dim_x, grid_dim_y, grid_dim_z,
-                                                        block_dim_x, block_dim_y, block_dim_z,
-                                                        grid_cta_count, block_thread_count);
-
-        tool.second->evt_callback(kernel);
+    _thread_device = device_id;
+    if (_kernel_filter.active()) {
+        const bool selected = _kernel_filter.select(kernel_name);
+        if (_options) {
+            _options->kernel_selected = selected;
+        }
+        if (!selected) {
+            std::lock_guard<std::mutex> guard(_filtered_mutex);
+            _filtered_devices.insert(device_id);
+            return YOSEMITE_SUCCESS;
+        }
     }
+    if (!event_wanted(EventType_KERNEL_LAUNCH)) {
+        return YOSEMITE_SUCCESS;
+    }
+    auto grid_cta_count =
+        static_cast<uint64_t>(grid_dim_x) * static_cast<uint64_t>(grid_dim_y) * static_cast<uint64_t>(grid_dim_z);
+    auto block_thread_count = block_dim_x * block_dim_y * block_dim_z;
+
+    auto record = new_event_record(EventType_KERNEL_LAUNCH, device_id);
+    record->kernel_launch = {EventNameTable::instance().intern(kernel_name),
+                             grid_dim_x, grid_dim_y, grid_dim_z,
+                             block_dim_x, block_dim_y, block_dim_z,
+                             block_thread_count, grid_cta_count};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
 
 YosemiteResult_t yosemite_kernel_end_callback(std::string kernel_name, int device_id) {
-    for (auto &tool : _tools) {
-        auto kernel = std::make_shared<KernelEnd_t>(kernel_name, device_id);
-        tool.second->evt_callback(kernel);
+    if (_kernel_filter.active()) {
+        std::lock_guard<std::mutex> guard(_filtered_mutex);
+        if (_filtered_devices.erase(device_id) > 0) {
+            return YOSEMITE_SUCCESS;
+        }
     }
+    if (!event_wanted(EventType_KERNEL_END)) {
+        return YOSEMITE_SUCCESS;
+    }
+    auto record = new_event_record(EventType_KERNEL_END, device_id);
+    record->kernel_end = {EventNameTable::instance().intern(kernel_name)};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
 
+// buffers without a device belong to the calling thread's last launch
+static inline int gpu_data_device(int device_id) {
+    return device_id >= 0 ? device_id : _thread_device;
+}
+
+
+// A frontend may still patch a launch the filters skipped; its buffers
+// would be analyzed against the previous kernel, so they are dropped.
+static inline bool gpu_data_filtered(int device_id) {
+    if (!_kernel_filter.active()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(_filtered_mutex);
+    return _filtered_devices.count(device_id) > 0;
+}
+
+
 YosemiteResult_t yosemite_gpu_data_analysis(void* data, uint64_t size) {
-    for (auto &tool : _tools) {
-        tool.second->gpu_data_analysis(data, size);
+    return yosemite_gpu_data_analysis(data, size, -1);
+}
+
+
+YosemiteResult_t yosemite_gpu_data_analysis(void* data, uint64_t size, int device_id) {
+    device_id = gpu_data_device(device_id);
+    if (gpu_data_filtered(device_id)) {
+        return YOSEMITE_SUCCESS;
+    }
+    if (_capture) {
+        _capture->write_gpu_data(data, size, device_id);
+    }
+    if (_device_shards_enabled) {
+        DeviceShard_t& shard = device_shard(device_id);
+        uint64_t token;
+        {
+            auto lock = _event_queue ? _event_queue->drain() : std::unique_lock<std::mutex>();
+            token = shard.ingest->submit(data, size);
+        }
+        // other devices' buffers keep being analyzed while this one waits
+        shard.ingest->wait(token);
+        return YOSEMITE_SUCCESS;
     }
+    auto lock = sync_event_queue();
+    run_gpu_data_analysis(data, size);
     return YOSEMITE_SUCCESS;
 }
 
 
-YosemiteResult_t yosemite_init(AccelProfOptions_t& options) {
-    AnalysisTool_t tool;
-    YosemiteResult_t res = yosemite_tool_enable(tool);
-    if (res != YOSEMITE_SUCCESS) {
-        return res;
+YosemiteResult_t yosemite_gpu_data_analysis_async(void* data, uint64_t size, YosemiteToken_t* token) {
+    return yosemite_gpu_data_analysis_async(data, size, token, -1);
+}
+
+
+YosemiteResult_t yosemite_gpu_data_analysis_async(void* data, uint64_t size, YosemiteToken_t* token,
+                                                  int device_id) {
+    device_id = gpu_data_device(device_id);
+    if (gpu_data_filtered(device_id)) {
+        *token = 0;
+        return YOSEMITE_SUCCESS;
     }
+    if (_device_shards_enabled) {
+        if (_capture) {
+            _capture->write_gpu_data(data, size, device_id);
+        }
+        DeviceShard_t& shard = device_shard(device_id);
+        auto lock = _event_queue ? _event_queue->drain() : std::unique_lock<std::mutex>();
+        const uint64_t local_token = shard.ingest->submit(data, size);
+        *token = (static_cast<uint64_t>(shard.index + 1) << k_shard_token_shift) | local_token;
+        return YOSEMITE_SUCCESS;
+    }
+    if (!_gpu_ingest) {
+        *token = 0;
+        return yosemite_gpu_data_analysis(data, size, device_id);
+    }
+    if (_capture) {
+        _capture->write_gpu_data(data, size, device_id);
+    }
+    // host events recorded before this buffer must reach the tools first;
+    // holding the dispatch lock keeps later ones behind it
+    auto lock = _event_queue ? _event_queue->drain() : std::unique_lock<std::mutex>();
+    *token = _gpu_ingest->submit(data, size);
+    return YOSEMITE_SUCCESS;
+}
+
+
+static inline GpuDataIngest* token_ingest(YosemiteToken_t& token) {
+    if (!_device_shards_enabled || token == 0) {
+        return _gpu_ingest.get();
+    }
+    const uint64_t index = (token >> k_shard_token_shift) - 1;
+    token &= (1ull << k_shard_token_shift) - 1;
+    std::lock_guard<std::mutex> guard(_device_shards_mutex);
+    return index < _device_shards.size() ? _device_shards[index]->ingest.get() : nullptr;
+}
+
+
+YosemiteResult_t yosemite_gpu_data_poll(YosemiteToken_t token) {
+    GpuDataIngest* ingest = token_ingest(token);
+    if (token == 0 || !ingest || ingest->poll(token)) {
+        return YOSEMITE_SUCCESS;
+    }
+    return YOSEMITE_PENDING;
+}
 
+
+YosemiteResult_t yosemite_gpu_data_wait(YosemiteToken_t token) {
+    GpuDataIngest* ingest = token_ingest(token);
+    if (token != 0 && ingest) {
+        ingest->wait(token);
+    }
+    return YOSEMITE_SUCCESS;
+}
+
+
+static void tool_patch(AnalysisTool_t tool, AccelProfOptions_t& options) {
     if (tool == CODE_CHECK) {
         options.patch_name = GPU_NO_PATCH;
     } else if (tool == APP_METRICE) {
@@ -290,6 +1101,93 @@ YosemiteResult_t yosemite_init(AccelProfOptions_t& options) {
         // The source file for this tool is nv-compute/gpu_src/gpu_patch_pc_dependency.cu
         options.patch_file = "gpu_patch_pc_dependency.fatbin";
     }
+}
+
+
+// Tools reading MemoryAccess traces can share one instrumented run. The
+// richest patch wins: the pc dependency patch also fills the memory type,
+// unique-address mask and distinct sector count and emits block exits.
+static int access_trace_patch_rank(AnalysisTool_t tool) {
+    switch (tool) {
+        case PC_DEPENDENCY_ANALYSIS:
+            return 4;
+        case MEM_TRACE:
+            return 3;
+        case HEATMAP_ANALYSIS:
+            return 2;
+        case BLOCK_DIVERGENCE_ANALYSIS:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+
+static YosemiteResult_t tool_patch_select(AccelProfOptions_t& options) {
+    options.patch_name = GPU_NO_PATCH;
+    options.patch_file.clear();
+    bool patched = false;
+    AnalysisTool_t patch_tool = TOOL_NUMS;
+    for (auto &tool : _tools) {
+        AccelProfOptions_t tool_options;
+        tool_options.patch_name = GPU_NO_PATCH;
+        tool_patch(tool.first, tool_options);
+        if (tool_options.patch_name == GPU_NO_PATCH) {
+            continue;
+        }
+        if (!patched) {
+            patched = true;
+        } else if (tool_options.patch_name == options.patch_name) {
+            continue;
+        } else if (access_trace_patch_rank(tool.first) == 0 || access_trace_patch_rank(patch_tool) == 0) {
+            fprintf(stderr, "[SANALYZER ERROR] Tools %s and %s need different GPU patches.\n",
+                    _tool_names[patch_tool].c_str(), _tool_names[tool.first].c_str());
+            fflush(stderr);
+            return YOSEMITE_NOT_IMPLEMENTED;
+        } else if (access_trace_patch_rank(tool.first) < access_trace_patch_rank(patch_tool)) {
+            continue;
+        }
+        options.patch_name = tool_options.patch_name;
+        options.patch_file = tool_options.patch_file;
+        patch_tool = tool.first;
+    }
+    if (_tools.size() > 1 && patched) {
+        fprintf(stdout, "[SANALYZER INFO] Using the GPU patch of %s for %lu tools.\n",
+                _tool_names[patch_tool].c_str(), _tools.size());
+        fflush(stdout);
+    }
+    return YOSEMITE_SUCCESS;
+}
+
+
+YosemiteResult_t yosemite_init(AccelProfOptions_t& options) {
+    AnalysisTool_t tool;
+    YosemiteResult_t res = yosemite_tool_enable(tool);
+    if (res != YOSEMITE_SUCCESS) {
+        return res;
+    }
+    device_shards_configure();
+    _access_trace_enabled = false;
+    for (auto &tool : _tools) {
+        _access_trace_enabled |= tool.second->access_trace();
+    }
+    self_profile_enable();
+    build_event_subscribers();
+    event_queue_enable();
+
+    res = tool_patch_select(options);
+    if (res != YOSEMITE_SUCCESS) {
+        return res;
+    }
+    gpu_ingest_enable(options);
+    _access_decoder.set_typed(options.patch_name == GPU_PATCH_PC_DEPENDENCY_ANALYSIS);
+    _gpu_data_layout = gpu_data_layout(options.patch_name);
+
+    res = kernel_filter_enable();
+    if (res != YOSEMITE_SUCCESS) {
+        return res;
+    }
+    _options = &options;
 
     // enable torch profiler?
     const char* torch_prof = std::getenv("TORCH_PROFILE_ENABLED");
@@ -305,6 +1203,8 @@ YosemiteResult_t yosemite_init(AccelProfOptions_t& options) {
         fprintf(stdout, "[SANALYZER INFO] Setting sample rate to %d.\n", options.sample_rate);
     }
 
+    capture_enable(options);
+
     fprintf(stdout, "================================================================================\n");
     fflush(stdout);
 
@@ -313,51 +1213,70 @@ YosemiteResult_t yosemite_init(AccelProfOptions_t& options) {
 
 
 YosemiteResult_t yosemite_terminate() {
+    capture_disable();
+    event_queue_disable();
+    gpu_ingest_disable();
+    device_shards_disable();
     yosemite_flush();
+    kernel_filter_disable();
+    self_profile_disable();
     return YOSEMITE_SUCCESS;
 }
 
 
 YosemiteResult_t yosemite_tensor_malloc_callback(uint64_t ptr, int64_t alloc_size,
                                     int64_t total_allocated, int64_t total_reserved, int device_id) {
-    for (auto &tool : _tools) {
-        auto ten_alloc = std::make_shared<TenAlloc_t>(ptr, alloc_size, total_allocated, total_reserved, device_id);
-        tool.second->evt_callback(ten_alloc);
+    if (!event_wanted(EventType_TEN_ALLOC)) {
+        return YOSEMITE_SUCCESS;
     }
+    auto record = new_event_record(EventType_TEN_ALLOC, device_id);
+    record->ten_alloc = {ptr, alloc_size, total_allocated, total_reserved};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
 
 YosemiteResult_t yosemite_tensor_free_callback(uint64_t ptr, int64_t alloc_size,
                                     int64_t total_allocated, int64_t total_reserved, int device_id) {
-    for (auto &tool : _tools) {
-        auto ten_free = std::make_shared<TenFree_t>(ptr, alloc_size, total_allocated, total_reserved, device_id);
-        tool.second->evt_callback(ten_free);
+    if (!event_wanted(EventType_TEN_FREE)) {
+        return YOSEMITE_SUCCESS;
     }
+    auto record = new_event_record(EventType_TEN_FREE, device_id);
+    record->ten_free = {ptr, alloc_size, total_allocated, total_reserved};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
 
 YosemiteResult_t yosemite_operator_start_callback(void* ctx, std::string op_name) {
-    for (auto &tool : _tools) {
-        auto op_start = std::make_shared<OpStart_t>(op_name, ctx);
-        tool.second->evt_callback(op_start);
+    if (!event_wanted(EventType_OP_START)) {
+        return YOSEMITE_SUCCESS;
     }
+    auto record = new_event_record(EventType_OP_START, -1);
+    record->op_start = {EventNameTable::instance().intern(op_name), ctx};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
 
 YosemiteResult_t yosemite_operator_end_callback(void* ctx, std::string op_name) {
-    for (auto &tool : _tools) {
-        auto op_end = std::make_shared<OpEnd_t>(op_name, ctx);
-        tool.second->evt_callback(op_end);
+    if (!event_wanted(EventType_OP_END)) {
+        return YOSEMITE_SUCCESS;
     }
+    auto record = new_event_record(EventType_OP_END, -1);
+    record->op_end = {EventNameTable::instance().intern(op_name), ctx};
+    submit_event_record(std::move(record));
     return YOSEMITE_SUCCESS;
 }
 
 
 YosemiteResult_t yosemite_query_active_ranges(void* ranges, uint32_t limit, uint32_t* count) {
+    if (_capture) {
+        _capture->write_query(CaptureItem_QUERY_RANGES, limit);
+    }
+    auto lock = sync_event_queue();
     for (auto &tool : _tools) {
+        ProfileScope scope(_self_profile.get(), tool_profile(tool.first), ProfilePhase_QUERY_RANGES);
         tool.second->query_ranges(ranges, limit, count);
     }
     return YOSEMITE_SUCCESS;
@@ -365,7 +1284,12 @@ YosemiteResult_t yosemite_query_active_ranges(void* ranges, uint32_t limit, uint
 
 
 YosemiteResult_t yosemite_query_active_tensors(void* ranges, uint32_t limit, uint32_t* count) {
+    if (_capture) {
+        _capture->write_query(CaptureItem_QUERY_TENSORS, limit);
+    }
+    auto lock = sync_event_queue();
     for (auto &tool : _tools) {
+        ProfileScope scope(_self_profile.get(), tool_profile(tool.first), ProfilePhase_QUERY_TENSORS);
         tool.second->query_tensors(ranges, limit, count);
     }
     return YOSEMITE_SUCCESS;
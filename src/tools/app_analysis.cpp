@@ -28,7 +28,7 @@ inline std::string vector2str(std::vector<std::string> &vec, int skip_first = 0,
 }
 
 
-AppAnalysis::AppAnalysis() : Tool(APP_ANALYSIS) {
+AppAnalysis::AppAnalysis() : Tool(APP_ANALYSIS, k_event_mask) {
     init();
 
 }
@@ -45,12 +45,6 @@ void AppAnalysis::init() {
     }
     init_backtrace(lib_path.c_str());
 
-    const char* env_filename = std::getenv("MAX_NUM_KERNEL_MONITORED");
-    if (env_filename) {
-        max_num_kernel_monitored = std::stoi(env_filename);
-        printf("Set max number of kernels monitored to %d\n", max_num_kernel_monitored);
-    }
-
     const char* env_sample_rate = std::getenv("ACCEL_PROF_ENV_SAMPLE_RATE");
     if (env_sample_rate) {
         setenv("YOSEMITE_ENV_SAMPLE_RATE", env_sample_rate, 1);
@@ -58,45 +52,8 @@ void AppAnalysis::init() {
 }
 
 
-void AppAnalysis::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_MEM_COPY:
-            mem_cpy_callback(std::dynamic_pointer_cast<MemCpy_t>(evt));
-            break;
-        case EventType_MEM_SET:
-            mem_set_callback(std::dynamic_pointer_cast<MemSet_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        case EventType_OP_START:
-            op_start_callback(std::dynamic_pointer_cast<OpStart_t>(evt));
-            break;
-        case EventType_OP_END:
-            op_end_callback(std::dynamic_pointer_cast<OpEnd_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
-void AppAnalysis::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+void AppAnalysis::kernel_start_callback(const EventRecord_t& record) {
+    auto kernel = make_event<KernelLaunch_t>(record);
     KernelStats stats;
     stats.kernel_launch = kernel;
     stats.tensor_footprint_size = ten_stats.alloc_size;
@@ -107,18 +64,14 @@ void AppAnalysis::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel)
 }
 
 
-void AppAnalysis::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
+void AppAnalysis::kernel_end_callback(const EventRecord_t& record) {
     kernel_id++;
-    if (max_num_kernel_monitored != -1 && kernel_id >= max_num_kernel_monitored) {
-        fprintf(stdout, "Max number of kernels monitored reached. Exiting...\n");
-        fflush(stdout);
-        exit(0);
-    }
     _timer.increment(true);
 }
 
 
-void AppAnalysis::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void AppAnalysis::mem_alloc_callback(const EventRecord_t& record) {
+    auto mem = make_event<MemAlloc_t>(record);
     mem_stats.alloc_count++;
     mem_stats.alloc_size += mem->size;
     mem_stats.max_size = std::max(mem_stats.max_size, mem_stats.alloc_size);
@@ -128,12 +81,13 @@ void AppAnalysis::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
 }
 
 
-void AppAnalysis::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
+void AppAnalysis::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
     mem_stats.free_count++;
-    mem_stats.free_size += mem->size;
-    mem_stats.alloc_size -= mem->size;
+    mem_stats.free_size += mem.size;
+    mem_stats.alloc_size -= mem.size;
 
-    auto it = active_memories.find(mem->addr);
+    auto it = active_memories.find(mem.addr);
     assert(it != active_memories.end());
     active_memories.erase(it);
 
@@ -141,20 +95,8 @@ void AppAnalysis::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
 }
 
 
-
-void AppAnalysis::mem_cpy_callback(std::shared_ptr<MemCpy_t> mem) {
-
-    _timer.increment(true);
-}
-
-
-void AppAnalysis::mem_set_callback(std::shared_ptr<MemSet_t> mem) {
-
-    _timer.increment(true);
-}
-
-
-void AppAnalysis::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
+void AppAnalysis::ten_alloc_callback(const EventRecord_t& record) {
+    auto ten = make_event<TenAlloc_t>(record);
     ten_stats.alloc_count++;
     ten_stats.alloc_size += ten->size;
     ten_stats.max_size = std::max(ten_stats.max_size, ten_stats.alloc_size);
@@ -165,12 +107,13 @@ void AppAnalysis::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
 }
 
 
-void AppAnalysis::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
+void AppAnalysis::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
     ten_stats.free_count++;
-    ten_stats.free_size += -ten->size;
-    ten_stats.alloc_size -= -ten->size;
+    ten_stats.free_size += -ten.size;
+    ten_stats.alloc_size -= -ten.size;
 
-    auto it = active_tensors.find(ten->addr);
+    auto it = active_tensors.find(ten.addr);
     assert(it != active_tensors.end());
     active_tensors.erase(it);
 
@@ -178,17 +121,6 @@ void AppAnalysis::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
 }
 
 
-void AppAnalysis::op_start_callback(std::shared_ptr<OpStart_t> op) {
-
-    _timer.increment(true);
-}
-
-
-void AppAnalysis::op_end_callback(std::shared_ptr<OpEnd_t> op) {
-
-    _timer.increment(true);
-}
-
 void AppAnalysis::gpu_data_analysis(void* data, uint64_t size) {
     MemoryAccessTracker* tracker = (MemoryAccessTracker*)data;
     MemoryAccessState* states = tracker->access_state;
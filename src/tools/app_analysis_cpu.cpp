@@ -30,7 +30,7 @@ inline std::string vector2str(std::vector<std::string> &vec, int skip_first = 0,
 }
 
 
-AppAnalysisCPU::AppAnalysisCPU() : Tool(APP_ANALYSIS_CPU) {
+AppAnalysisCPU::AppAnalysisCPU() : Tool(APP_ANALYSIS_CPU, k_event_mask) {
     init();
 
 }
@@ -47,12 +47,6 @@ void AppAnalysisCPU::init() {
     }
     init_backtrace(lib_path.c_str());
 
-    const char* env_filename = std::getenv("MAX_NUM_KERNEL_MONITORED");
-    if (env_filename) {
-        max_num_kernel_monitored = std::stoi(env_filename);
-        printf("Set max number of kernels monitored to %d\n", max_num_kernel_monitored);
-    }
-
     const char* env_sample_rate = std::getenv("ACCEL_PROF_ENV_SAMPLE_RATE");
     if (env_sample_rate) {
         setenv("YOSEMITE_ENV_SAMPLE_RATE", env_sample_rate, 1);
@@ -60,45 +54,8 @@ void AppAnalysisCPU::init() {
 }
 
 
-void AppAnalysisCPU::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_MEM_COPY:
-            mem_cpy_callback(std::dynamic_pointer_cast<MemCpy_t>(evt));
-            break;
-        case EventType_MEM_SET:
-            mem_set_callback(std::dynamic_pointer_cast<MemSet_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        case EventType_OP_START:
-            op_start_callback(std::dynamic_pointer_cast<OpStart_t>(evt));
-            break;
-        case EventType_OP_END:
-            op_end_callback(std::dynamic_pointer_cast<OpEnd_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
-void AppAnalysisCPU::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+void AppAnalysisCPU::kernel_start_callback(const EventRecord_t& record) {
+    auto kernel = make_event<KernelLaunch_t>(record);
     KernelStats stats;
     stats.kernel_launch = kernel;
     stats.tensor_footprint_size = ten_stats.alloc_size;
@@ -109,29 +66,7 @@ void AppAnalysisCPU::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kerne
 }
 
 
-std::shared_ptr<MemAlloc_t> AppAnalysisCPU::query_memory_ranges_cpu(uint64_t ptr) {
-    for (auto mem : active_memories) {
-        if (mem.second->addr <= ptr && mem.second->addr + mem.second->size >= ptr) {
-            return mem.second;
-        }
-    }
-    assert(false);
-    return nullptr;
-}
-
-
-std::shared_ptr<TenAlloc_t> AppAnalysisCPU::query_tensor_ranges_cpu(uint64_t ptr) {
-    for (auto ten : active_tensors) {
-        if (ten.second->addr <= ptr && ten.second->addr + ten.second->size > ptr) {
-            return ten.second;
-        }
-    }
-    assert(false);
-    return nullptr;
-}
-
-
-void AppAnalysisCPU::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
+void AppAnalysisCPU::kernel_end_callback(const EventRecord_t& record) {
     size_t tensor_working_set_size = 0;
     for (auto ten : touched_tensors) {
         tensor_working_set_size += ten->size;
@@ -150,101 +85,88 @@ void AppAnalysisCPU::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
 
     kernel_id++;
 
-    if (max_num_kernel_monitored != -1 && kernel_id >= max_num_kernel_monitored) {
-        fprintf(stdout, "Max number of kernels monitored reached. Exiting...\n");
-        fflush(stdout);
-        _exit(0);
-    }
-
     _timer.increment(true);
 }
 
 
-void AppAnalysisCPU::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void AppAnalysisCPU::mem_alloc_callback(const EventRecord_t& record) {
+    auto mem = make_event<MemAlloc_t>(record);
     mem_stats.alloc_count++;
     mem_stats.alloc_size += mem->size;
     mem_stats.max_size = std::max(mem_stats.max_size, mem_stats.alloc_size);
-    active_memories.emplace(mem->addr, mem);
+    const uint32_t id = memory_index.insert(mem->addr, mem->size);
+    active_memories.resize(memory_index.id_limit());
+    active_memories[id] = mem;
 
     _timer.increment(true);
 }
 
 
-void AppAnalysisCPU::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
+void AppAnalysisCPU::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
     mem_stats.free_count++;
-    mem_stats.free_size += mem->size;
-    mem_stats.alloc_size -= mem->size;
+    mem_stats.free_size += mem.size;
+    mem_stats.alloc_size -= mem.size;
 
-    auto it = active_memories.find(mem->addr);
-    assert(it != active_memories.end());
-    active_memories.erase(it);
+    const uint32_t id = memory_index.erase(mem.addr);
+    assert(id != k_no_interval);
+    active_memories[id].reset();
 
     _timer.increment(true);
 }
 
 
-
-void AppAnalysisCPU::mem_cpy_callback(std::shared_ptr<MemCpy_t> mem) {
-
-    _timer.increment(true);
-}
-
-
-void AppAnalysisCPU::mem_set_callback(std::shared_ptr<MemSet_t> mem) {
-
-    _timer.increment(true);
-}
-
-
-void AppAnalysisCPU::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
+void AppAnalysisCPU::ten_alloc_callback(const EventRecord_t& record) {
+    auto ten = make_event<TenAlloc_t>(record);
     ten_stats.alloc_count++;
     ten_stats.alloc_size += ten->size;
     ten_stats.max_size = std::max(ten_stats.max_size, ten_stats.alloc_size);
 
-    active_tensors.emplace(ten->addr, ten);
+    const uint32_t id = tensor_index.insert(ten->addr, ten->size);
+    active_tensors.resize(tensor_index.id_limit());
+    active_tensors[id] = ten;
 
     _timer.increment(true);
 }
 
 
-void AppAnalysisCPU::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
+void AppAnalysisCPU::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
     ten_stats.free_count++;
-    ten_stats.free_size += -ten->size;
-    ten_stats.alloc_size -= -ten->size;
+    ten_stats.free_size += -ten.size;
+    ten_stats.alloc_size -= -ten.size;
 
-    auto it = active_tensors.find(ten->addr);
-    assert(it != active_tensors.end());
-    active_tensors.erase(it);
+    const uint32_t id = tensor_index.erase(ten.addr);
+    assert(id != k_no_interval);
+    active_tensors[id].reset();
 
     _timer.increment(true);
 }
 
 
-void AppAnalysisCPU::op_start_callback(std::shared_ptr<OpStart_t> op) {
-
-    _timer.increment(true);
-}
-
-
-void AppAnalysisCPU::op_end_callback(std::shared_ptr<OpEnd_t> op) {
-
-    _timer.increment(true);
-}
-
 void AppAnalysisCPU::gpu_data_analysis(void* data, uint64_t size) {
     MemoryAccess* accesses_buffer = (MemoryAccess*)data;
     uint32_t num_accesses = 0;
+    uint32_t tensor_ids[GPU_WARP_SIZE];
+    uint32_t memory_ids[GPU_WARP_SIZE];
     for (uint32_t i = 0; i < size; i++) {
-        MemoryAccess access = accesses_buffer[i];
+        const MemoryAccess& access = accesses_buffer[i];
+        tensor_index.find_batch(access.addresses, GPU_WARP_SIZE, tensor_ids);
+        memory_index.find_batch(access.addresses, GPU_WARP_SIZE, memory_ids);
+        uint32_t last_tensor = k_no_interval;
+        uint32_t last_memory = k_no_interval;
         for (uint32_t j = 0; j < GPU_WARP_SIZE; j++) {
             if (access.addresses[j] != 0) {
                 num_accesses++;
-                auto tensor = query_tensor_ranges_cpu(access.addresses[j]);
-                auto memory = query_memory_ranges_cpu(access.addresses[j]);
-                if (tensor != nullptr && memory != nullptr) {
-                    touched_tensors.insert(tensor);
-                    touched_memories.insert(memory);
-                    // break;
+                assert(tensor_ids[j] != k_no_interval && memory_ids[j] != k_no_interval);
+                if (tensor_ids[j] != k_no_interval && memory_ids[j] != k_no_interval) {
+                    // lanes of a warp mostly hit the same tensor
+                    if (tensor_ids[j] != last_tensor || memory_ids[j] != last_memory) {
+                        touched_tensors.insert(active_tensors[tensor_ids[j]]);
+                        touched_memories.insert(active_memories[memory_ids[j]]);
+                        last_tensor = tensor_ids[j];
+                        last_memory = memory_ids[j];
+                    }
                 }
             }
         }
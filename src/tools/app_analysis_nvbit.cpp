@@ -28,7 +28,7 @@ inline std::string vector2str(std::vector<std::string> &vec, int skip_first = 0,
 }
 
 
-AppAnalysisNVBIT::AppAnalysisNVBIT() : Tool(APP_ANALYSIS_NVBIT) {
+AppAnalysisNVBIT::AppAnalysisNVBIT() : Tool(APP_ANALYSIS_NVBIT, k_event_mask) {
     init();
 }
 
@@ -47,82 +47,20 @@ void AppAnalysisNVBIT::init() {
 }
 
 
-void AppAnalysisNVBIT::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_MEM_COPY:
-            mem_cpy_callback(std::dynamic_pointer_cast<MemCpy_t>(evt));
-            break;
-        case EventType_MEM_SET:
-            mem_set_callback(std::dynamic_pointer_cast<MemSet_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        case EventType_OP_START:
-            op_start_callback(std::dynamic_pointer_cast<OpStart_t>(evt));
-            break;
-        case EventType_OP_END:
-            op_end_callback(std::dynamic_pointer_cast<OpEnd_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
-void AppAnalysisNVBIT::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+void AppAnalysisNVBIT::kernel_start_callback(const EventRecord_t& record) {
+    auto kernel = make_event<KernelLaunch_t>(record);
     KernelStats stats;
     stats.kernel_launch = kernel;
     stats.tensor_footprint_size = ten_stats.alloc_size;
     stats.memory_footprint_size = mem_stats.alloc_size;
     kernel_stats.emplace(kernel_id, stats);
-    active_memories_per_kernel_snapshot[kernel_id] = active_memories;
-    active_tensors_per_kernel_snapshot[kernel_id] = active_tensors;
+    active_allocs_per_kernel_snapshot[kernel_id] = active_allocs;
 
     kernel_id++;
     _timer.increment(true);
 }
 
 
-std::shared_ptr<MemAlloc_t> AppAnalysisNVBIT::query_memory_ranges_cpu(uint64_t ptr, uint64_t grid_launch_id) {
-    auto active_memories_snapshot = active_memories_per_kernel_snapshot[grid_launch_id];
-    for (auto mem : active_memories_snapshot) {
-        if (mem.second->addr <= ptr && mem.second->addr + mem.second->size >= ptr) {
-            return mem.second;
-        }
-    }
-    // assert(false);
-    return nullptr;
-}
-
-
-std::shared_ptr<TenAlloc_t> AppAnalysisNVBIT::query_tensor_ranges_cpu(uint64_t ptr, uint64_t grid_launch_id) {
-    auto active_tensors_snapshot = active_tensors_per_kernel_snapshot[grid_launch_id];
-    for (auto ten : active_tensors_snapshot) {
-        if (ten.second->addr <= ptr && ten.second->addr + ten.second->size > ptr) {
-            return ten.second;
-        }
-    }
-    // assert(false);
-    return nullptr;
-}
-
-
 void AppAnalysisNVBIT::kernel_grid_launch_id_transition() {
     size_t tensor_working_set_size = 0;
     for (auto ten : touched_tensors) {
@@ -134,16 +72,19 @@ void AppAnalysisNVBIT::kernel_grid_launch_id_transition() {
         memory_working_set_size += mem->size;
     }
 
+    const auto& snapshot = active_allocs_per_kernel_snapshot[previous_grid_launch_id];
     size_t memory_footprint_size = 0;
-    auto active_memories_snapshot = active_memories_per_kernel_snapshot[previous_grid_launch_id];
-    for (auto mem : active_memories_snapshot) {
-        memory_footprint_size += mem.second->size;
+    for (auto& mem : snapshot.memories) {
+        if (mem) {
+            memory_footprint_size += mem->size;
+        }
     }
 
     size_t tensor_footprint_size = 0;
-    auto active_tensors_snapshot = active_tensors_per_kernel_snapshot[previous_grid_launch_id];
-    for (auto ten : active_tensors_snapshot) {
-        tensor_footprint_size += ten.second->size;
+    for (auto& ten : snapshot.tensors) {
+        if (ten) {
+            tensor_footprint_size += ten->size;
+        }
     }
 
     kernel_stats[previous_grid_launch_id].tensor_working_set_size = tensor_working_set_size;
@@ -157,83 +98,67 @@ void AppAnalysisNVBIT::kernel_grid_launch_id_transition() {
 }
 
 
-void AppAnalysisNVBIT::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
+void AppAnalysisNVBIT::kernel_end_callback(const EventRecord_t& record) {
 
     _timer.increment(true);
 }
 
 
-void AppAnalysisNVBIT::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void AppAnalysisNVBIT::mem_alloc_callback(const EventRecord_t& record) {
+    auto mem = make_event<MemAlloc_t>(record);
     mem_stats.alloc_count++;
     mem_stats.alloc_size += mem->size;
     mem_stats.max_size = std::max(mem_stats.max_size, mem_stats.alloc_size);
-    active_memories.emplace(mem->addr, mem);
+    const uint32_t id = active_allocs.memory_index.insert(mem->addr, mem->size);
+    active_allocs.memories.resize(active_allocs.memory_index.id_limit());
+    active_allocs.memories[id] = mem;
 
     _timer.increment(true);
 }
 
 
-void AppAnalysisNVBIT::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
+void AppAnalysisNVBIT::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
     mem_stats.free_count++;
-    mem_stats.free_size += mem->size;
-    mem_stats.alloc_size -= mem->size;
-
-    auto it = active_memories.find(mem->addr);
-    assert(it != active_memories.end());
-    active_memories.erase(it);
-
-    _timer.increment(true);
-}
-
-
-
-void AppAnalysisNVBIT::mem_cpy_callback(std::shared_ptr<MemCpy_t> mem) {
-
-    _timer.increment(true);
-}
-
+    mem_stats.free_size += mem.size;
+    mem_stats.alloc_size -= mem.size;
 
-void AppAnalysisNVBIT::mem_set_callback(std::shared_ptr<MemSet_t> mem) {
+    const uint32_t id = active_allocs.memory_index.erase(mem.addr);
+    assert(id != k_no_interval);
+    active_allocs.memories[id].reset();
 
     _timer.increment(true);
 }
 
 
-void AppAnalysisNVBIT::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
+void AppAnalysisNVBIT::ten_alloc_callback(const EventRecord_t& record) {
+    auto ten = make_event<TenAlloc_t>(record);
     ten_stats.alloc_count++;
     ten_stats.alloc_size += ten->size;
     ten_stats.max_size = std::max(ten_stats.max_size, ten_stats.alloc_size);
 
-    active_tensors.emplace(ten->addr, ten);
+    const uint32_t id = active_allocs.tensor_index.insert(ten->addr, ten->size);
+    active_allocs.tensors.resize(active_allocs.tensor_index.id_limit());
+    active_allocs.tensors[id] = ten;
 
     _timer.increment(true);
 }
 
 
-void AppAnalysisNVBIT::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
+void AppAnalysisNVBIT::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
     ten_stats.free_count++;
-    ten_stats.free_size += -ten->size;
-    ten_stats.alloc_size -= -ten->size;
+    ten_stats.free_size += -ten.size;
+    ten_stats.alloc_size -= -ten.size;
 
-    auto it = active_tensors.find(ten->addr);
-    assert(it != active_tensors.end());
-    active_tensors.erase(it);
+    const uint32_t id = active_allocs.tensor_index.erase(ten.addr);
+    assert(id != k_no_interval);
+    active_allocs.tensors[id].reset();
 
     _timer.increment(true);
 }
 
 
-void AppAnalysisNVBIT::op_start_callback(std::shared_ptr<OpStart_t> op) {
-
-    _timer.increment(true);
-}
-
-
-void AppAnalysisNVBIT::op_end_callback(std::shared_ptr<OpEnd_t> op) {
-
-    _timer.increment(true);
-}
-
 void AppAnalysisNVBIT::gpu_data_analysis(void* data, uint64_t size) {
     nvbit_mem_access_t* ma = (nvbit_mem_access_t*)data;
 
@@ -243,16 +168,23 @@ void AppAnalysisNVBIT::gpu_data_analysis(void* data, uint64_t size) {
         previous_grid_launch_id = current_grid_launch_id;
     }
 
+    const auto& snapshot = active_allocs_per_kernel_snapshot[current_grid_launch_id];
+    uint32_t memory_ids[GPU_WARP_SIZE_NVBIT];
+    uint32_t tensor_ids[GPU_WARP_SIZE_NVBIT];
+    snapshot.memory_index.find_batch(ma->addrs, GPU_WARP_SIZE_NVBIT, memory_ids);
+    snapshot.tensor_index.find_batch(ma->addrs, GPU_WARP_SIZE_NVBIT, tensor_ids);
+    uint32_t last_memory = k_no_interval;
+    uint32_t last_tensor = k_no_interval;
     for (int i = 0; i < GPU_WARP_SIZE_NVBIT; i++) {
         if (ma->addrs[i] != 0) {
             current_kernel_access_count++;
-            auto memory = query_memory_ranges_cpu(ma->addrs[i], current_grid_launch_id);
-            if (memory != nullptr) {
-                touched_memories.insert(memory);
+            if (memory_ids[i] != k_no_interval && memory_ids[i] != last_memory) {
+                touched_memories.insert(snapshot.memories[memory_ids[i]]);
+                last_memory = memory_ids[i];
             }
-            auto tensor = query_tensor_ranges_cpu(ma->addrs[i], current_grid_launch_id);
-            if (tensor != nullptr) {
-                touched_tensors.insert(tensor);
+            if (tensor_ids[i] != k_no_interval && tensor_ids[i] != last_tensor) {
+                touched_tensors.insert(snapshot.tensors[tensor_ids[i]]);
+                last_tensor = tensor_ids[i];
             }
         }
     }
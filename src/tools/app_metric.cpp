@@ -14,27 +14,8 @@
 using namespace yosemite;
 
 
-void AppMetrics::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
-void AppMetrics::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+void AppMetrics::kernel_start_callback(const EventRecord_t& record) {
+    auto kernel = make_event<KernelLaunch_t>(record);
     kernel->kernel_id = _kernel_id++;
     kernel_events.emplace(_timer.get(), kernel);
     if (kernel_invocations.find(kernel->kernel_name) == kernel_invocations.end()) {
@@ -49,11 +30,8 @@ void AppMetrics::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
 }
 
 
-void AppMetrics::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
-}
-
-
-void AppMetrics::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void AppMetrics::mem_alloc_callback(const EventRecord_t& record) {
+    auto mem = make_event<MemAlloc_t>(record);
     alloc_events.emplace(_timer.get(), mem);
     active_memories.emplace(mem->addr, mem);
     
@@ -65,8 +43,9 @@ void AppMetrics::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
 }
 
 
-void AppMetrics::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
-    auto it = active_memories.find(mem->addr);
+void AppMetrics::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
+    auto it = active_memories.find(mem.addr);
     assert(it != active_memories.end());
     _stats.cur_mem_usage -= it->second->size;
     active_memories.erase(it);
@@ -26,7 +26,10 @@
 using namespace yosemite;
 
 
-BlockDivergenceAnalysis::BlockDivergenceAnalysis() : Tool(MEM_TRACE) {
+BlockDivergenceAnalysis::BlockDivergenceAnalysis(const std::string& shard_directory) : Tool(MEM_TRACE, k_event_mask) {
+    _access_trace = true;
+    _device_shards = true;
+
     const char* torch_prof = std::getenv("TORCH_PROFILE_ENABLED");
     if (torch_prof && std::string(torch_prof) == "1") {
         fprintf(stdout, "Enabling torch profiler in BlockDivergenceAnalysis.\n");
@@ -34,7 +37,9 @@ BlockDivergenceAnalysis::BlockDivergenceAnalysis() : Tool(MEM_TRACE) {
     }
 
     const char* env_app_name = std::getenv("YOSEMITE_APP_NAME");
-    if (env_app_name != nullptr) {
+    if (!shard_directory.empty()) {
+        output_directory = shard_directory;
+    } else if (env_app_name != nullptr) {
         output_directory = "block_distribution_" + std::string(env_app_name)
                             + "_" + get_current_date_n_time();
     } else {
@@ -47,7 +52,13 @@ BlockDivergenceAnalysis::BlockDivergenceAnalysis() : Tool(MEM_TRACE) {
 BlockDivergenceAnalysis::~BlockDivergenceAnalysis() {}
 
 
-void BlockDivergenceAnalysis::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+std::shared_ptr<Tool> BlockDivergenceAnalysis::make_shard(int device_id, uint32_t device_count) {
+    return std::make_shared<BlockDivergenceAnalysis>(output_directory + "/gpu_" + std::to_string(device_id));
+}
+
+
+void BlockDivergenceAnalysis::kernel_start_callback(const EventRecord_t& record) {
+    auto kernel = make_event<KernelLaunch_t>(record);
 
     kernel->kernel_id = kernel_id++;
     kernel_events.emplace(_timer.get(), kernel);
@@ -93,7 +104,7 @@ void BlockDivergenceAnalysis::kernel_trace_flush(std::shared_ptr<KernelLaunch_t>
 }
 
 
-void BlockDivergenceAnalysis::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
+void BlockDivergenceAnalysis::kernel_end_callback(const EventRecord_t& record) {
     auto evt = std::prev(kernel_events.end())->second;
     evt->end_time = _timer.get();
 
@@ -103,7 +114,8 @@ void BlockDivergenceAnalysis::kernel_end_callback(std::shared_ptr<KernelEnd_t> k
 }
 
 
-void BlockDivergenceAnalysis::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void BlockDivergenceAnalysis::mem_alloc_callback(const EventRecord_t& record) {
+    auto mem = make_event<MemAlloc_t>(record);
     alloc_events.emplace(_timer.get(), mem);
     active_memories.emplace(mem->addr, mem);
 
@@ -111,8 +123,9 @@ void BlockDivergenceAnalysis::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem
 }
 
 
-void BlockDivergenceAnalysis::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
-    auto it = active_memories.find(mem->addr);
+void BlockDivergenceAnalysis::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
+    auto it = active_memories.find(mem.addr);
     assert(it != active_memories.end());
     active_memories.erase(it);
 
@@ -120,7 +133,8 @@ void BlockDivergenceAnalysis::mem_free_callback(std::shared_ptr<MemFree_t> mem)
 }
 
 
-void BlockDivergenceAnalysis::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
+void BlockDivergenceAnalysis::ten_alloc_callback(const EventRecord_t& record) {
+    auto ten = make_event<TenAlloc_t>(record);
     tensor_events.emplace(_timer.get(), ten);
     active_tensors.emplace(ten->addr, ten);
 
@@ -128,8 +142,9 @@ void BlockDivergenceAnalysis::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten
 }
 
 
-void BlockDivergenceAnalysis::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
-    auto it = active_tensors.find(ten->addr);
+void BlockDivergenceAnalysis::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
+    auto it = active_tensors.find(ten.addr);
     assert(it != active_tensors.end());
     active_tensors.erase(it);
 
@@ -137,11 +152,14 @@ void BlockDivergenceAnalysis::ten_free_callback(std::shared_ptr<TenFree_t> ten)
 }
 
 
-void BlockDivergenceAnalysis::gpu_data_analysis(void* data, uint64_t size) {
-    MemoryAccess* accesses_buffer = (MemoryAccess*)data;
-    for (uint64_t i = 0; i < size; i++) {
-        const MemoryAccess& trace = accesses_buffer[i];
-        uint64_t executed_inst_count = static_cast<uint64_t>(__builtin_popcount(trace.active_mask));
+void BlockDivergenceAnalysis::gpu_trace_analysis(const AccessBatch_t& batch) {
+    for (uint64_t i = 0; i < batch.size; i++) {
+        // global accesses only
+        if (batch.decoded[i].kind != DecodedKind_ACCESS) {
+            continue;
+        }
+        const MemoryAccess& trace = batch.accesses[i];
+        uint64_t executed_inst_count = batch.decoded[i].active_lanes;
         uint64_t pc = trace.pc;
         uint64_t cta_id = trace.ctaId;
 
@@ -160,31 +178,5 @@ void BlockDivergenceAnalysis::gpu_data_analysis(void* data, uint64_t size) {
 }
 
 
-void BlockDivergenceAnalysis::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
 void BlockDivergenceAnalysis::flush() {
 }
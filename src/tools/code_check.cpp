@@ -39,72 +39,32 @@ void CodeCheck::init() {
 }
 
 
-void CodeCheck::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_MEM_COPY:
-            mem_cpy_callback(std::dynamic_pointer_cast<MemCpy_t>(evt));
-            break;
-        case EventType_MEM_SET:
-            mem_set_callback(std::dynamic_pointer_cast<MemSet_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        case EventType_OP_START:
-            op_start_callback(std::dynamic_pointer_cast<OpStart_t>(evt));
-            break;
-        case EventType_OP_END:
-            op_end_callback(std::dynamic_pointer_cast<OpEnd_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
-void CodeCheck::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+void CodeCheck::kernel_start_callback(const EventRecord_t& record) {
     kernel_count++;
     _timer.increment(true);
 }
 
 
-void CodeCheck::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
-}
-
-
-void CodeCheck::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void CodeCheck::mem_alloc_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_alloc;
     mem_stats.alloc_count++;
-    mem_stats.alloc_size += mem->size;
+    mem_stats.alloc_size += mem.size;
 
     _timer.increment(true);
 }
 
 
-void CodeCheck::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
+void CodeCheck::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
     mem_stats.free_count++;
-    mem_stats.free_size += mem->size;
+    mem_stats.free_size += mem.size;
 
     _timer.increment(true);
 }
 
 
-
-void CodeCheck::mem_cpy_callback(std::shared_ptr<MemCpy_t> mem) {
+void CodeCheck::mem_cpy_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_cpy;
     // auto backtraces = get_backtrace();
     // auto py_frames = get_pyframes();
     // auto bt_str = vector2str(backtraces);
@@ -115,50 +75,55 @@ void CodeCheck::mem_cpy_callback(std::shared_ptr<MemCpy_t> mem) {
     // std::cout << "Python frame hash: " << sha256(pf_str) << std::endl;
     // std::cout << pf_str << std::endl;
 
-    MemcpyDirection_t direction = (MemcpyDirection_t)mem->direction;
+    MemcpyDirection_t direction = (MemcpyDirection_t)mem.direction;
     if (cpy_stats.find(direction) == cpy_stats.end()) {
         cpy_stats[direction] = CpyStats{0, 0};
     }
     cpy_stats[direction].count++;
-    cpy_stats[direction].size += mem->size;
+    cpy_stats[direction].size += mem.size;
 
     _timer.increment(true);
 }
 
 
-void CodeCheck::mem_set_callback(std::shared_ptr<MemSet_t> mem) {
+void CodeCheck::mem_set_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_set;
     set_stats.count++;
-    set_stats.size += mem->size;
+    set_stats.size += mem.size;
 
     _timer.increment(true);
 }
 
 
-void CodeCheck::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
+void CodeCheck::ten_alloc_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_alloc;
     ten_stats.alloc_count++;
-    ten_stats.alloc_size += ten->size;
+    ten_stats.alloc_size += ten.size;
 
     _timer.increment(true);
 }
 
 
-void CodeCheck::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
+void CodeCheck::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
     ten_stats.free_count++;
-    ten_stats.free_size += -ten->size;
+    ten_stats.free_size += -ten.size;
 
     _timer.increment(true);
 }
 
 
-void CodeCheck::op_start_callback(std::shared_ptr<OpStart_t> op) {
-    fprintf(stdout, "Op start: %s, ctx: %p\n", op->op_name.c_str(), op->ctx);
+void CodeCheck::op_start_callback(const EventRecord_t& record) {
+    const auto& op = record.op_start;
+    fprintf(stdout, "Op start: %s, ctx: %p\n", event_name(op.name_id).c_str(), op.ctx);
 
     _timer.increment(true);
 }
 
 
-void CodeCheck::op_end_callback(std::shared_ptr<OpEnd_t> op) {
-    fprintf(stdout, "Op end: %s, ctx: %p\n", op->op_name.c_str(), op->ctx);
+void CodeCheck::op_end_callback(const EventRecord_t& record) {
+    const auto& op = record.op_end;
+    fprintf(stdout, "Op end: %s, ctx: %p\n", event_name(op.name_id).c_str(), op.ctx);
 
     _timer.increment(true);
 }
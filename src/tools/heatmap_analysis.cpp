@@ -15,7 +15,10 @@
 using namespace yosemite;
 
 
-HeatmapAnalysis::HeatmapAnalysis() : Tool(HEATMAP_ANALYSIS) {
+HeatmapAnalysis::HeatmapAnalysis(const std::string& shard_directory) : Tool(HEATMAP_ANALYSIS, k_event_mask) {
+    _access_trace = true;
+    _device_shards = true;
+
     const char* torch_prof = std::getenv("TORCH_PROFILE_ENABLED");
     if (torch_prof && std::string(torch_prof) == "1") {
         fprintf(stdout, "Enabling torch profiler in HeatmapAnalysis.\n");
@@ -23,7 +26,9 @@ HeatmapAnalysis::HeatmapAnalysis() : Tool(HEATMAP_ANALYSIS) {
     }
 
     const char* env_app_name = std::getenv("YOSEMITE_APP_NAME");
-    if (env_app_name != nullptr) {
+    if (!shard_directory.empty()) {
+        output_directory = shard_directory;
+    } else if (env_app_name != nullptr) {
         output_directory = "heatmap_" + std::string(env_app_name)
                             + "_" + get_current_date_n_time();
     } else {
@@ -36,7 +41,13 @@ HeatmapAnalysis::HeatmapAnalysis() : Tool(HEATMAP_ANALYSIS) {
 HeatmapAnalysis::~HeatmapAnalysis() {}
 
 
-void HeatmapAnalysis::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+std::shared_ptr<Tool> HeatmapAnalysis::make_shard(int device_id, uint32_t device_count) {
+    return std::make_shared<HeatmapAnalysis>(output_directory + "/gpu_" + std::to_string(device_id));
+}
+
+
+void HeatmapAnalysis::kernel_start_callback(const EventRecord_t& record) {
+    auto kernel = make_event<KernelLaunch_t>(record);
 
     kernel->kernel_id = kernel_id++;
     kernel_events.emplace(_timer.get(), kernel);
@@ -86,7 +97,7 @@ void HeatmapAnalysis::kernel_trace_flush(std::shared_ptr<KernelLaunch_t> kernel)
 }
 
 
-void HeatmapAnalysis::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
+void HeatmapAnalysis::kernel_end_callback(const EventRecord_t& record) {
     auto evt = std::prev(kernel_events.end())->second;
     evt->end_time = _timer.get();
 
@@ -96,7 +107,8 @@ void HeatmapAnalysis::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
 }
 
 
-void HeatmapAnalysis::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void HeatmapAnalysis::mem_alloc_callback(const EventRecord_t& record) {
+    auto mem = make_event<MemAlloc_t>(record);
     alloc_events.emplace(_timer.get(), mem);
     active_memories.emplace(mem->addr, mem);
 
@@ -104,8 +116,9 @@ void HeatmapAnalysis::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
 }
 
 
-void HeatmapAnalysis::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
-    auto it = active_memories.find(mem->addr);
+void HeatmapAnalysis::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
+    auto it = active_memories.find(mem.addr);
     assert(it != active_memories.end());
     active_memories.erase(it);
 
@@ -113,7 +126,8 @@ void HeatmapAnalysis::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
 }
 
 
-void HeatmapAnalysis::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
+void HeatmapAnalysis::ten_alloc_callback(const EventRecord_t& record) {
+    auto ten = make_event<TenAlloc_t>(record);
     tensor_events.emplace(_timer.get(), ten);
     active_tensors.emplace(ten->addr, ten);
 
@@ -121,8 +135,9 @@ void HeatmapAnalysis::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
 }
 
 
-void HeatmapAnalysis::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
-    auto it = active_tensors.find(ten->addr);
+void HeatmapAnalysis::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
+    auto it = active_tensors.find(ten.addr);
     assert(it != active_tensors.end());
     active_tensors.erase(it);
 
@@ -158,10 +173,13 @@ void HeatmapAnalysis::add_sector_pc_information(uint64_t sector_tag, uint64_t pc
 }
 
 
-void HeatmapAnalysis::gpu_data_analysis(void* data, uint64_t size) {
-    MemoryAccess* accesses_buffer = (MemoryAccess*)data;
-    for (uint64_t i = 0; i < size; i++) {
-        auto trace = accesses_buffer[i];
+void HeatmapAnalysis::gpu_trace_analysis(const AccessBatch_t& batch) {
+    for (uint64_t i = 0; i < batch.size; i++) {
+        // global accesses only
+        if (batch.decoded[i].kind != DecodedKind_ACCESS) {
+            continue;
+        }
+        const MemoryAccess& trace = batch.accesses[i];
         for (int j = 0; j < GPU_WARP_SIZE; j++) {
             if (trace.active_mask & (1u << j)) {
                 auto sector_tag = trace.addresses[j] >> SECTOR_TAG_SHIFT;
@@ -173,31 +191,5 @@ void HeatmapAnalysis::gpu_data_analysis(void* data, uint64_t size) {
     } 
 }
 
-void HeatmapAnalysis::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
 void HeatmapAnalysis::flush() {
 }
@@ -18,7 +18,7 @@ using namespace yosemite;
 constexpr uint32_t RANGE_GRANULARITY = 2 * 1024 * 1024;
 
 
-HotAnalysis::HotAnalysis() : Tool(HOT_ANALYSIS) {
+HotAnalysis::HotAnalysis() : Tool(HOT_ANALYSIS, k_event_mask) {
     const char* env_app_name = std::getenv("YOSEMITE_APP_NAME");
     if (env_app_name != nullptr) {
         output_directory = "hotness_" + std::string(env_app_name)
@@ -32,63 +32,24 @@ HotAnalysis::HotAnalysis() : Tool(HOT_ANALYSIS) {
 HotAnalysis::~HotAnalysis() {
 }
 
-void HotAnalysis::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
-}
-
-void HotAnalysis::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
-}
-
-void HotAnalysis::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void HotAnalysis::mem_alloc_callback(const EventRecord_t& record) {
+    auto mem = make_event<MemAlloc_t>(record);
     active_memories.emplace(mem->addr, mem);
 }
 
-void HotAnalysis::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
-    active_memories.erase(mem->addr);
-}
-
-void HotAnalysis::mem_cpy_callback(std::shared_ptr<MemCpy_t> mem) {
+void HotAnalysis::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
+    active_memories.erase(mem.addr);
 }
 
-void HotAnalysis::mem_set_callback(std::shared_ptr<MemSet_t> mem) {
-}
-
-void HotAnalysis::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
+void HotAnalysis::ten_alloc_callback(const EventRecord_t& record) {
+    auto ten = make_event<TenAlloc_t>(record);
     active_tensors.emplace(ten->addr, ten);
 }
 
-void HotAnalysis::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
-    active_tensors.erase(ten->addr);
-}
-
-void HotAnalysis::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_MEM_COPY:
-            mem_cpy_callback(std::dynamic_pointer_cast<MemCpy_t>(evt));
-            break;
-        case EventType_MEM_SET:
-            mem_set_callback(std::dynamic_pointer_cast<MemSet_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        default:
-            break;
-    }
+void HotAnalysis::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
+    active_tensors.erase(ten.addr);
 }
 
 void HotAnalysis::gpu_data_analysis(void* data, uint64_t size) {
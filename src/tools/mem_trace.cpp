@@ -11,7 +11,10 @@
 using namespace yosemite;
 
 
-MemTrace::MemTrace() : Tool(MEM_TRACE) {
+MemTrace::MemTrace(const std::string& shard_directory) : Tool(MEM_TRACE, k_event_mask) {
+    _access_trace = true;
+    _device_shards = true;
+
     const char* torch_prof = std::getenv("TORCH_PROFILE_ENABLED");
     if (torch_prof && std::string(torch_prof) == "1") {
         fprintf(stdout, "Enabling torch profiler in MemTrace.\n");
@@ -19,7 +22,9 @@ MemTrace::MemTrace() : Tool(MEM_TRACE) {
     }
 
     const char* env_app_name = std::getenv("YOSEMITE_APP_NAME");
-    if (env_app_name != nullptr) {
+    if (!shard_directory.empty()) {
+        output_directory = shard_directory;
+    } else if (env_app_name != nullptr) {
         output_directory = "traces_" + std::string(env_app_name)
                             + "_" + get_current_date_n_time();
     } else {
@@ -32,7 +37,13 @@ MemTrace::MemTrace() : Tool(MEM_TRACE) {
 MemTrace::~MemTrace() {}
 
 
-void MemTrace::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+std::shared_ptr<Tool> MemTrace::make_shard(int device_id, uint32_t device_count) {
+    return std::make_shared<MemTrace>(output_directory + "/gpu_" + std::to_string(device_id));
+}
+
+
+void MemTrace::kernel_start_callback(const EventRecord_t& record) {
+    auto kernel = make_event<KernelLaunch_t>(record);
 
     kernel->kernel_id = kernel_id++;
     kernel_events.emplace(_timer.get(), kernel);
@@ -82,7 +93,7 @@ void MemTrace::kernel_trace_flush(std::shared_ptr<KernelLaunch_t> kernel) {
 }
 
 
-void MemTrace::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
+void MemTrace::kernel_end_callback(const EventRecord_t& record) {
     auto evt = std::prev(kernel_events.end())->second;
     evt->end_time = _timer.get();
 
@@ -92,7 +103,8 @@ void MemTrace::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
 }
 
 
-void MemTrace::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void MemTrace::mem_alloc_callback(const EventRecord_t& record) {
+    auto mem = make_event<MemAlloc_t>(record);
     alloc_events.emplace(_timer.get(), mem);
     active_memories.emplace(mem->addr, mem);
 
@@ -100,8 +112,9 @@ void MemTrace::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
 }
 
 
-void MemTrace::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
-    auto it = active_memories.find(mem->addr);
+void MemTrace::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
+    auto it = active_memories.find(mem.addr);
     assert(it != active_memories.end());
     active_memories.erase(it);
 
@@ -109,7 +122,8 @@ void MemTrace::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
 }
 
 
-void MemTrace::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
+void MemTrace::ten_alloc_callback(const EventRecord_t& record) {
+    auto ten = make_event<TenAlloc_t>(record);
     tensor_events.emplace(_timer.get(), ten);
     active_tensors.emplace(ten->addr, ten);
 
@@ -117,8 +131,9 @@ void MemTrace::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
 }
 
 
-void MemTrace::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
-    auto it = active_tensors.find(ten->addr);
+void MemTrace::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
+    auto it = active_tensors.find(ten.addr);
     assert(it != active_tensors.end());
     active_tensors.erase(it);
 
@@ -126,38 +141,13 @@ void MemTrace::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
 }
 
 
-void MemTrace::gpu_data_analysis(void* data, uint64_t size) {
-    MemoryAccess* accesses_buffer = (MemoryAccess*)data;
-    for (int i = 0; i < size; i++) {
-        MemoryAccess trace = accesses_buffer[i];
-        _traces.push_back(trace);
-    }
-
-}
-
-
-void MemTrace::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        default:
-            break;
+void MemTrace::gpu_trace_analysis(const AccessBatch_t& batch) {
+    // global accesses only: block exits and shared/local offsets are not traced
+    _traces.reserve(_traces.size() + batch.size);
+    for (uint64_t i = 0; i < batch.size; i++) {
+        if (batch.decoded[i].kind == DecodedKind_ACCESS) {
+            _traces.push_back(batch.accesses[i]);
+        }
     }
 }
 
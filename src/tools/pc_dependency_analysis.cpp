@@ -3,13 +3,9 @@
 
 #include <cstdint>
 #include <cstdlib>
-#include <fstream>
 #include <memory>
 #include <cassert>
 #include <iostream>
-#include <sstream>
-#include <set>
-#include <iomanip>
 #include <thread>
 #include <atomic>
 #include <limits>
@@ -18,53 +14,6 @@
 using namespace yosemite;
 
 namespace {
-static std::string json_escape(const std::string& s) {
-    std::string out;
-    out.reserve(s.size() + 8);
-    for (char c : s) {
-        switch (c) {
-            case '\"': out += "\\\""; break;
-            case '\\': out += "\\\\"; break;
-            case '\b': out += "\\b"; break;
-            case '\f': out += "\\f"; break;
-            case '\n': out += "\\n"; break;
-            case '\r': out += "\\r"; break;
-            case '\t': out += "\\t"; break;
-            default:
-                // control chars
-                if (static_cast<unsigned char>(c) < 0x20) {
-                    std::ostringstream oss;
-                    oss << "\\u"
-                        << std::hex << std::setw(4) << std::setfill('0')
-                        << (int)static_cast<unsigned char>(c);
-                    out += oss.str();
-                } else {
-                    out += c;
-                }
-        }
-    }
-    return out;
-}
-
-static std::string hex_u32(uint32_t v) {
-    std::ostringstream oss;
-    oss << "0x" << std::hex << v;
-    return oss.str();
-}
-static std::string flags_to_string(uint32_t flags) {
-    std::ostringstream oss;
-    if (flags & SANITIZER_MEMORY_DEVICE_FLAG_READ) oss << "READ";
-    if (flags & SANITIZER_MEMORY_DEVICE_FLAG_WRITE) oss << "WRITE";
-    if (flags & SANITIZER_MEMORY_DEVICE_FLAG_ATOMIC) oss << "ATOMIC";
-    if (flags & SANITIZER_MEMORY_DEVICE_FLAG_PREFETCH) oss << "PREFETCH";
-    oss << " ";
-    if (flags & SANITIZER_MEMORY_GLOBAL) oss << "GLOBAL";
-    if (flags & SANITIZER_MEMORY_SHARED) oss << "SHARED";
-    if (flags & SANITIZER_MEMORY_LOCAL) oss << "LOCAL";
-
-    return oss.str();
-}
-
 static inline uint64_t pack_shadow_entry(uint8_t generation, uint32_t pc24, uint32_t flat_thread_id) {
     const uint32_t encoded_pc = (static_cast<uint32_t>(generation) << 24)
                               | (pc24 & 0x00FFFFFFu);
@@ -79,23 +28,56 @@ static inline uint32_t unpack_shadow_flat_tid(uint64_t packed) {
     return static_cast<uint32_t>(packed >> 32);
 }
 
-static inline const memory_region* find_memory_region_containing(
-    const std::vector<memory_region>& regions,
-    uint64_t addr
-) {
-    auto it = std::upper_bound(
-        regions.begin(),
-        regions.end(),
-        addr,
-        [](uint64_t value, const memory_region& region) {
-            return value < region.get_start();
+// Records are analyzed CTA by CTA, so the previous write to an address can
+// come later in the trace than the current access.
+static inline uint32_t reuse_distance(uint32_t now, uint32_t last_time) {
+    const int32_t distance = static_cast<int32_t>(now - last_time);
+    return distance < 0 ? static_cast<uint32_t>(-static_cast<int64_t>(distance)) : static_cast<uint32_t>(distance);
+}
+
+/* Bank conflicts of a warp-level shared memory access, with 32 banks of
+4 bytes. 8 and 16 byte accesses are split into half and quarter warp
+phases, each lane covering 2 and 4 consecutive banks; a 12 byte access is phased
+like a 16 byte one so every lane lands in a phase. In a phase, lanes
+reading the same word are served by one broadcast, and the phase takes as
+many wavefronts as the largest number of distinct words in one bank.
+`degree` is the largest such number over the phases and `replays` the
+wavefronts beyond one per active phase. */
+static void shared_bank_conflicts(const MemoryAccess& trace, uint32_t& degree, uint32_t& replays) {
+    const uint32_t words_per_lane = trace.accessSize <= 4 ? 1u : std::min(4u, trace.accessSize / 4u);
+    const uint32_t phases = words_per_lane == 3 ? 4u : words_per_lane;
+    const uint32_t lanes_per_phase = GPU_WARP_SIZE / phases;
+    const uint32_t phase_mask = lanes_per_phase == 32 ? 0xFFFFFFFFu : (1u << lanes_per_phase) - 1u;
+    degree = 0;
+    replays = 0;
+    for (uint32_t phase = 0; phase < phases; ++phase) {
+        uint32_t lanes = trace.active_mask & (phase_mask << (phase * lanes_per_phase));
+        if (lanes == 0) {
+            continue;
         }
-    );
-    if (it == regions.begin()) {
-        return nullptr;
+        // At most 32 words in a phase: lanes_per_phase * words_per_lane.
+        uint32_t words[GPU_WARP_SIZE];
+        uint32_t word_count = 0;
+        while (lanes != 0) {
+            const uint32_t lane = static_cast<uint32_t>(__builtin_ctz(lanes));
+            lanes &= (lanes - 1);
+            const uint32_t word = static_cast<uint32_t>(trace.addresses[lane] >> 2);
+            for (uint32_t idx = 0; idx < words_per_lane; ++idx) {
+                words[word_count++] = word + idx;
+            }
+        }
+        std::sort(words, words + word_count);
+        uint8_t bank_words[GPU_WARP_SIZE] = {};
+        uint32_t wavefronts = 0;
+        for (uint32_t idx = 0; idx < word_count; ++idx) {
+            if (idx > 0 && words[idx] == words[idx - 1]) {
+                continue;
+            }
+            wavefronts = std::max<uint32_t>(wavefronts, ++bank_words[words[idx] % GPU_WARP_SIZE]);
+        }
+        degree = std::max(degree, wavefronts);
+        replays += wavefronts - 1;
     }
-    --it;
-    return it->contains(addr) ? &(*it) : nullptr;
 }
 
 static uint32_t read_env_u32(const char* key, uint32_t default_value) {
@@ -116,7 +98,10 @@ static uint32_t read_env_u32(const char* key, uint32_t default_value) {
 } // namespace
 
 
-PcDependency::PcDependency() : Tool(PC_DEPENDENCY_ANALYSIS) {
+PcDependency::PcDependency(const std::string& shard_directory) : Tool(PC_DEPENDENCY_ANALYSIS, k_event_mask) {
+    _access_trace = true;
+    _device_shards = true;
+
     const char* torch_prof = std::getenv("TORCH_PROFILE_ENABLED");
     if (torch_prof && std::string(torch_prof) == "1") {
         fprintf(stdout, "Enabling torch profiler in PcDependency.\n");
@@ -124,7 +109,9 @@ PcDependency::PcDependency() : Tool(PC_DEPENDENCY_ANALYSIS) {
     }
 
     const char* env_app_name = std::getenv("YOSEMITE_APP_NAME");
-    if (env_app_name != nullptr) {
+    if (!shard_directory.empty()) {
+        output_directory = shard_directory;
+    } else if (env_app_name != nullptr) {
         output_directory = "dependency_" + std::string(env_app_name)
                             + "_" + get_current_date_n_time();
     } else {
@@ -132,6 +119,43 @@ PcDependency::PcDependency() : Tool(PC_DEPENDENCY_ANALYSIS) {
     }
     check_folder_existance(output_directory);
 
+    _shadow_granularity = read_env_u32("YOSEMITE_SHADOW_GRANULARITY", 1);
+    if (_shadow_granularity != 1 && _shadow_granularity != 4 && _shadow_granularity != 8
+        && _shadow_granularity != 16 && _shadow_granularity != 32) {
+        printf("[PC_DEPENDENCY] Unsupported YOSEMITE_SHADOW_GRANULARITY %u, using 1\n", _shadow_granularity);
+        _shadow_granularity = 1;
+    }
+    _sample_stride = std::max(4u, _shadow_granularity);
+
+    const char* graph_format = std::getenv("YOSEMITE_DEPENDENCY_FORMAT");
+    if (graph_format != nullptr) {
+        const std::string format(graph_format);
+        if (format == "json") {
+            _write_graph_binary = false;
+            _write_graph_json = true;
+        } else if (format == "both") {
+            _write_graph_json = true;
+        } else if (format != "binary") {
+            printf("[PC_DEPENDENCY] Unsupported YOSEMITE_DEPENDENCY_FORMAT %s, using binary\n", graph_format);
+        }
+    }
+    _reuse_times = read_env_u32("YOSEMITE_REUSE_TIME_HISTOGRAM", 0) != 0;
+    _aggregate_launches = read_env_u32("YOSEMITE_DEPENDENCY_AGGREGATE", 0) != 0;
+    _aggregate_delta = std::min(100u, read_env_u32("YOSEMITE_DEPENDENCY_DELTA_PERCENT", 5)) / 100.0;
+
+    const uint64_t shadow_budget_bytes = static_cast<uint64_t>(read_env_u32("YOSEMITE_SHADOW_BUDGET_MB", 0)) << 20;
+    _shadow_budget.set_limit(shadow_budget_bytes);
+    if (shadow_budget_bytes != 0) {
+        // Small budgets get small chunks, so eviction stays fine-grained.
+        const uint64_t entry_bytes = sizeof(shadow_memory_entry) + (_reuse_times ? sizeof(uint32_t) : 0);
+        while (_shadow_chunk_bits > k_min_shadow_chunk_bits
+               && (entry_bytes << _shadow_chunk_bits) * k_shadow_budget_chunks > shadow_budget_bytes) {
+            _shadow_chunk_bits--;
+        }
+        printf("[PC_DEPENDENCY] Shadow budget %lu bytes, %lu entries per chunk\n",
+               shadow_budget_bytes, 1ul << _shadow_chunk_bits);
+    }
+
     _worker_count = std::max(1u, read_env_u32("YOSEMITE_WORKER_COUNT", std::thread::hardware_concurrency()));
     const uint32_t sm_count = read_env_u32("YOSEMITE_GPU_SM_COUNT", 128);
     const uint32_t max_active_blocks_per_sm = read_env_u32("YOSEMITE_GPU_MAX_ACTIVE_BLOCKS_PER_SM", 24);
@@ -140,39 +164,49 @@ PcDependency::PcDependency() : Tool(PC_DEPENDENCY_ANALYSIS) {
         static_cast<uint64_t>(sm_count) * static_cast<uint64_t>(max_active_blocks_per_sm);
     const uint64_t slack_block_capacity =
         (total_block_capacity * static_cast<uint64_t>(pool_slack_percent) + 99ull) / 100ull;
-    _shared_shadow_object_cap_per_worker =
-        static_cast<uint32_t>(std::max<uint64_t>(32ull, (slack_block_capacity + _worker_count - 1) / _worker_count));
+    _shared_shadow_object_cap = static_cast<uint32_t>(std::max<uint64_t>(32ull, slack_block_capacity));
     _shared_shadow_bytes_per_object = read_env_u32("YOSEMITE_GPU_MAX_SHARED_MEMORY_PER_BLOCK", 102400u);
     if (_shared_shadow_bytes_per_object == 0) {
         _shared_shadow_bytes_per_object = 1;
     }
+}
 
-    _worker_shadow_memory_shared.resize(_worker_count);
-    for (auto& worker_state : _worker_shadow_memory_shared) {
-        worker_state.object_entries.resize(_shared_shadow_object_cap_per_worker, nullptr);
-        worker_state.object_owner_cta.assign(_shared_shadow_object_cap_per_worker, std::numeric_limits<uint64_t>::max());
-        worker_state.object_active_threads.assign(_shared_shadow_object_cap_per_worker, 0u);
-        worker_state.free_object_indices.reserve(_shared_shadow_object_cap_per_worker);
-        for (uint32_t idx = 0; idx < _shared_shadow_object_cap_per_worker; ++idx) {
-            worker_state.free_object_indices.push_back(_shared_shadow_object_cap_per_worker - 1u - idx);
-            shared_shadow_memory_entry* entries = static_cast<shared_shadow_memory_entry*>(
-                mmap(
-                    nullptr,
-                    static_cast<size_t>(_shared_shadow_bytes_per_object) * sizeof(shared_shadow_memory_entry),
-                    PROT_READ | PROT_WRITE,
-                    MAP_PRIVATE | MAP_ANONYMOUS,
-                    -1,
-                    0
-                )
-            );
-            assert(entries != MAP_FAILED);
-            worker_state.object_entries[idx] = entries;
-        }
+
+void PcDependency::start_worker_pool() {
+    if (!_workers.empty()) {
+        return;
+    }
+    auto& pool = _shadow_memory_shared;
+    pool.object_entries.resize(_shared_shadow_object_cap, nullptr);
+    pool.object_owner_cta.assign(_shared_shadow_object_cap, std::numeric_limits<uint64_t>::max());
+    pool.object_active_threads.assign(_shared_shadow_object_cap, 0u);
+    pool.free_object_indices.reserve(_shared_shadow_object_cap);
+    for (uint32_t idx = 0; idx < _shared_shadow_object_cap; ++idx) {
+        pool.free_object_indices.push_back(_shared_shadow_object_cap - 1u - idx);
+        shared_shadow_memory_entry* entries = static_cast<shared_shadow_memory_entry*>(
+            mmap(
+                nullptr,
+                static_cast<size_t>(_shared_shadow_bytes_per_object) * sizeof(shared_shadow_memory_entry),
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS,
+                -1,
+                0
+            )
+        );
+        assert(entries != MAP_FAILED);
+        pool.object_entries[idx] = entries;
+    }
+    // One batch analyzed while the next ones are copied and partitioned.
+    const uint32_t pipeline_depth = std::max(1u, read_env_u32("YOSEMITE_PIPELINE_DEPTH", 3));
+    for (uint32_t idx = 0; idx < pipeline_depth; ++idx) {
+        auto job = std::make_unique<pipeline_batch>();
+        job->worker_tasks = std::vector<worker_task_queue>(_worker_count);
+        _pipeline_free.push_back(job.get());
+        _pipeline_batches.push_back(std::move(job));
     }
-    _job_worker_trace_indices.resize(_worker_count);
-    _job_worker_pc_statistics.resize(_worker_count);
-    _job_worker_pc_flags.resize(_worker_count);
-    _job_worker_distinct_sector_count.resize(_worker_count);
+    _worker_pc_statistics.resize(_worker_count);
+    _worker_pc_tables.resize(_worker_count);
+    _worker_pc_reuse_times.resize(_worker_count);
     _workers.reserve(_worker_count);
     for (uint64_t worker_idx = 0; worker_idx < _worker_count; ++worker_idx) {
         _workers.emplace_back(&PcDependency::worker_loop, this, worker_idx);
@@ -181,6 +215,7 @@ PcDependency::PcDependency() : Tool(PC_DEPENDENCY_ANALYSIS) {
 
 
 PcDependency::~PcDependency() {
+    drain_pipeline();
     {
         std::lock_guard<std::mutex> guard(_worker_pool_mutex);
         _worker_pool_shutdown = true;
@@ -192,20 +227,29 @@ PcDependency::~PcDependency() {
             worker.join();
         }
     }
-    for (auto& worker_state : _worker_shadow_memory_shared) {
-        for (auto* entries : worker_state.object_entries) {
-            if (entries != nullptr) {
-                munmap(
-                    entries,
-                    static_cast<size_t>(_shared_shadow_bytes_per_object) * sizeof(shared_shadow_memory_entry)
-                );
-            }
+    for (auto* entries : _shadow_memory_shared.object_entries) {
+        if (entries != nullptr) {
+            munmap(
+                entries,
+                static_cast<size_t>(_shared_shadow_bytes_per_object) * sizeof(shared_shadow_memory_entry)
+            );
         }
     }
 }
 
 
-void PcDependency::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+std::shared_ptr<Tool> PcDependency::make_shard(int device_id, uint32_t device_count) {
+    auto shard = std::make_shared<PcDependency>(output_directory + "/gpu_" + std::to_string(device_id));
+    // The devices split the workers; the pool starts with the first kernel.
+    shard->_worker_count = std::max<uint64_t>(1, _worker_count / std::max(1u, device_count));
+    return shard;
+}
+
+
+void PcDependency::kernel_start_callback(const EventRecord_t& record) {
+    start_worker_pool();
+    drain_pipeline();
+    auto kernel = make_event<KernelLaunch_t>(record);
 
     kernel->kernel_id = kernel_id++;
     _shared_kernel_generation = kernel->kernel_id + 1u;
@@ -213,226 +257,225 @@ void PcDependency::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel)
     _current_block_thread_count = kernel->block_thread_count;
     kernel_events.emplace(_timer.get(), kernel);
     _pc_statistics.clear();
-    _pc_flags.clear();
-    _distinct_sector_count.clear();
-    _unknown_region_shadow.clear();
+    _pc_table.clear();
+    _pc_reuse_times.clear();
+    _kernel_records = 0;
     for (uint64_t worker_idx = 0; worker_idx < _worker_count; ++worker_idx) {
-        auto& worker_state = _worker_shadow_memory_shared[worker_idx];
-        worker_state.pool_miss_count = 0;
-        uint64_t worker_cta_slots = 0;
-        if (_current_kernel_cta_count > worker_idx) {
-            worker_cta_slots = (_current_kernel_cta_count + _worker_count - 1u - worker_idx) / _worker_count;
-        }
-        worker_state.cta_slot_to_object.assign(
-            static_cast<size_t>(worker_cta_slots),
-            worker_shared_shadow_state::k_invalid_object
-        );
+        _worker_pc_statistics[worker_idx].clear();
+        _worker_pc_tables[worker_idx].clear();
+        _worker_pc_reuse_times[worker_idx].clear();
     }
+    _shadow_memory_shared.pool_miss_count = 0;
+    _cta_shared_object.assign(
+        static_cast<size_t>(_current_kernel_cta_count),
+        worker_shared_shadow_state::k_invalid_object
+    );
+    _cta_local_shadow.clear();
+    _cta_local_shadow.resize(static_cast<size_t>(_current_kernel_cta_count));
+    _kernel_stolen_tasks = 0;
     _kernel_generation = static_cast<uint8_t>(_kernel_generation + 1u);
     if (_kernel_generation == 0) {
         for (auto& shadow_memory_iter : _shadow_memories) {
             shadow_memory_iter.second->reset_entries();
         }
+        _unknown_region_shadow.reset();
         printf("[PC_DEPENDENCY] Shadow generation wrapped, resetting entries\n");
     }
+    _unknown_region_shadow.set_epoch(_kernel_generation + 1u);
+    _kernel_first_stamp = _shadow_stamp + 1;
+    _kernel_evicted_chunks = 0;
+    _kernel_lossy_evicted_chunks = 0;
+    for (auto& shadow_memory_iter : _shadow_memories) {
+        shadow_memory_iter.second->forget_evictions();
+    }
+    enforce_shadow_budget();
     _timer.increment(true);
 }
 
 
-void PcDependency::kernel_trace_flush(std::shared_ptr<KernelLaunch_t> kernel) {
-    // JSON output for building PC dependency graph (joinable with CFG)
-    std::string json_filename = output_directory + "/kernel_"
-                                + std::to_string(kernel->kernel_id) + ".json";
-    std::ofstream jout(json_filename);
-    jout << "{\n";
-    jout << "  \"tool\": \"pc_dependency_analysis\",\n";
-    jout << "  \"kernel\": {\n";
-    jout << "    \"kernel_id\": " << kernel->kernel_id << ",\n";
-    jout << "    \"kernel_name\": \"" << json_escape(kernel->kernel_name) << "\",\n";
-    jout << "    \"device_id\": " << kernel->device_id << ",\n";
-    jout << "    \"kernel_pc\": " << kernel->kernel_pc << ",\n";
-    jout << "    \"kernel_pc_hex\": \"" << hex_u32((uint32_t)kernel->kernel_pc) << "\",\n";
-    jout << "    \"grid_dim\": [" << kernel->grid_dim_x << ", " << kernel->grid_dim_y << ", " << kernel->grid_dim_z << "],\n";
-    jout << "    \"grid_cta_count\": " << kernel->grid_cta_count << ",\n";
-    jout << "    \"block_dim\": [" << kernel->block_dim_x << ", " << kernel->block_dim_y << ", " << kernel->block_dim_z << "],\n";
-    jout << "    \"block_thread_count\": " << kernel->block_thread_count << "\n";
-    jout << "  },\n";
-    jout << "  \"shadow_memory_granularity_bytes\": 1,\n";
-    jout << "  \"sample_stride_bytes\": 4,\n";
-
-    // Collect nodes (all current PCs + all non-cold ancient PCs)
-    std::set<uint32_t> nodes;
-    for (const auto& kv : _pc_statistics) {
-        const uint32_t cur_pc = unpack_current_pc_offset(kv.first);
-        const uint32_t anc_pc = unpack_ancient_pc_offset(kv.first);
-        nodes.insert(cur_pc);
-        if (anc_pc != 0u) {
-            nodes.insert(anc_pc);
-        }
-    }
-
-    jout << "  \"nodes\": [\n";
-    {
-        bool first = true;
-        for (uint32_t pc : nodes) {
-            if (!first) jout << ",\n";
-            first = false;
-            auto fit = _pc_flags.find(pc);
-            bool has_flags = (fit != _pc_flags.end());
-            uint32_t flags = has_flags ? fit->second.first : 0;
-            uint32_t access_size = has_flags ? fit->second.second : 0;
-            bool has_distinct_sector_count = (_distinct_sector_count.find(pc) != _distinct_sector_count.end());
-            jout << "    {\"pc\": " << pc
-                 << ", \"pc_hex\": \"" << hex_u32(pc) << "\"";
-            if (has_flags) {
-                jout << ", \"flags\": \"" << flags_to_string(flags) << "\""
-                     << ", \"flags_hex\": \"" << hex_u32(flags) << "\""
-                     << ", \"access_size\": " << access_size;
-            } else {
-                jout << ", \"flags\": null, \"flags_hex\": null, \"access_size\": null";
-            }
-            if (has_distinct_sector_count) {
-                jout << ", \"distinct_sector_count\": {";
-                for (int i = 1; i <= 32; i++) {
-                    jout << "\"" << i << "\": " << _distinct_sector_count[pc][i - 1];
-                    if (i != 32) {
-                        jout << ", ";
-                    }
-                }
-                jout << "}";
-                jout << ", \"active_lane_count\": {";
-                for (int i = 0; i <= 32; i++) {
-                    jout << "\"" << i << "\": " << _distinct_sector_count[pc][32 + i];
-                    if (i != 32) {
-                        jout << ", ";
-                    }
-                }
-                jout << "}";
-                jout << ", \"distinct_address_count\": {";
-                for (int i = 1; i <= 32; i++) {
-                    jout << "\"" << i << "\": " << _distinct_sector_count[pc][65 + i - 1];
-                    if (i != 32) {
-                        jout << ", ";
-                    }
-                }
-                jout << "}";
-            } else {
-                jout << ", \"distinct_sector_count\": null, \"active_lane_count\": null, \"distinct_address_count\": null";
+void PcDependency::build_dependency_graph(const KernelLaunch_t& kernel, DependencyGraph_t& graph) {
+    DependencyGraphKernel_t& info = graph.kernel;
+    info.kernel_id = kernel.kernel_id;
+    info.kernel_name = kernel.kernel_name;
+    info.device_id = kernel.device_id;
+    info.kernel_pc = kernel.kernel_pc;
+    info.grid_dim[0] = kernel.grid_dim_x;
+    info.grid_dim[1] = kernel.grid_dim_y;
+    info.grid_dim[2] = kernel.grid_dim_z;
+    info.grid_cta_count = kernel.grid_cta_count;
+    info.block_dim[0] = kernel.block_dim_x;
+    info.block_dim[1] = kernel.block_dim_y;
+    info.block_dim[2] = kernel.block_dim_z;
+    info.block_thread_count = kernel.block_thread_count;
+    info.shadow_granularity = _shadow_granularity;
+    info.sample_stride = _sample_stride;
+    info.shadow_budget_bytes = _shadow_budget.limit();
+    info.shadow_evicted_chunks = _kernel_evicted_chunks;
+    info.shadow_lossy_evicted_chunks = _kernel_lossy_evicted_chunks;
+    info.reuse_times = _reuse_times;
+
+    // Edges: ancient_pc -> current_pc, with per-scope counts, sorted by
+    // current pc then ancient pc.
+    graph.edges.reserve(_pc_statistics.size());
+    std::vector<uint32_t> pcs;
+    pcs.reserve(_pc_statistics.size() * 2);
+    _pc_statistics.for_each([&](uint64_t pc_ancient_pairs, const PC_statisitics& st) {
+        DependencyGraphEdge_t edge;
+        edge.current_pc = unpack_current_pc_offset(pc_ancient_pairs);
+        edge.ancient_pc = unpack_ancient_pc_offset(pc_ancient_pairs);
+        std::copy(st.dist.begin(), st.dist.end(), edge.dist.begin());
+        if (const PC_reuse_times* reuse_times = _pc_reuse_times.find(pc_ancient_pairs)) {
+            edge.reuse_time = *reuse_times;
+        }
+        graph.edges.push_back(edge);
+        pcs.push_back(edge.current_pc);
+        if (edge.ancient_pc != 0u) {
+            pcs.push_back(edge.ancient_pc);
+        }
+    });
+    std::sort(graph.edges.begin(), graph.edges.end(),
+              [](const DependencyGraphEdge_t& a, const DependencyGraphEdge_t& b) {
+        if (a.current_pc != b.current_pc) return a.current_pc < b.current_pc;
+        return a.ancient_pc < b.ancient_pc;
+    });
+
+    // Nodes: all current PCs + all non-cold ancient PCs
+    std::sort(pcs.begin(), pcs.end());
+    pcs.erase(std::unique(pcs.begin(), pcs.end()), pcs.end());
+    graph.nodes.resize(pcs.size());
+    for (size_t idx = 0; idx < pcs.size(); ++idx) {
+        DependencyGraphNode_t& node = graph.nodes[idx];
+        node.pc = pcs[idx];
+        const uint32_t pc_id = _pc_table.find(node.pc);
+        node.has_info = (pc_id != pc_table<uint64_t>::k_no_pc);
+        if (!node.has_info) {
+            continue;
+        }
+        node.flags = _pc_table.flags(pc_id);
+        node.access_size = _pc_table.access_size(pc_id);
+        for (uint32_t kind = 0; kind < PcHistogramCount; ++kind) {
+            for (uint32_t bin = 0; bin < k_pc_histogram_bins[kind]; ++bin) {
+                node.histograms[kind][bin] = _pc_table.histogram(static_cast<PcHistogram_t>(kind), pc_id, bin);
             }
-            jout << "}";
         }
-        jout << "\n";
     }
-    jout << "  ],\n";
+}
 
-    // Edges: ancient_pc -> current_pc, with per-scope counts.
-    jout << "  \"edges\": [\n";
-    {
-        // Stable order: sort by current pc then ancient pc
-        struct EdgeRow {
-            uint32_t cur_pc;
-            uint32_t anc_pc;
-            const PC_statisitics* st;
-        };
-        std::vector<EdgeRow> edges;
-        edges.reserve(_pc_statistics.size());
-        for (const auto& kv : _pc_statistics) {
-            edges.push_back(EdgeRow{
-                unpack_current_pc_offset(kv.first),
-                unpack_ancient_pc_offset(kv.first),
-                &kv.second
-            });
-        }
-        std::sort(edges.begin(), edges.end(), [](const EdgeRow& a, const EdgeRow& b) {
-            if (a.cur_pc != b.cur_pc) return a.cur_pc < b.cur_pc;
-            return a.anc_pc < b.anc_pc;
-        });
 
-        bool first_edge = true;
-        for (const auto& e : edges) {
-            const uint32_t cur_pc = e.cur_pc;
-            const uint32_t anc_pc = e.anc_pc;
-            const PC_statisitics& st = *(e.st);
-
-            if (!first_edge) jout << ",\n";
-            first_edge = false;
-
-            const bool cold_miss = (anc_pc == 0u);
-
-            // current flags if available
-            auto cfit = _pc_flags.find(cur_pc);
-            const bool has_cflags = (cfit != _pc_flags.end());
-            const uint32_t cflags = has_cflags ? cfit->second.first : 0;
-            const uint32_t c_access_size = has_cflags ? cfit->second.second : 0;
-
-            jout << "    {\"current_pc\": " << cur_pc
-                 << ", \"current_pc_hex\": \"" << hex_u32(cur_pc) << "\""
-                 << ", \"ancient_pc\": ";
-            if (cold_miss) {
-                jout << "null";
-            } else {
-                jout << anc_pc;
-            }
-            jout << ", \"ancient_pc_hex\": ";
-            if (cold_miss) {
-                jout << "null";
-            } else {
-                jout << "\"" << hex_u32(anc_pc) << "\"";
-            }
-            jout << ", \"cold_miss\": " << (cold_miss ? "true" : "false");
-
-            if (has_cflags) {
-                jout << ", \"current_flags\": " << cflags
-                     << ", \"current_flags_hex\": \"" << hex_u32(cflags) << "\""
-                     << ", \"current_access_size\": " << c_access_size;
-            } else {
-                jout << ", \"current_flags\": null, \"current_flags_hex\": null";
-            }
+void PcDependency::write_graph_files(const std::string& path, const DependencyGraph_t& graph) const {
+    if (_write_graph_binary && write_dependency_graph(path + ".ydg", graph)) {
+        printf("Dumping pc dependency graph to %s.ydg\n", path.c_str());
+    }
+    if (_write_graph_json && write_dependency_graph_json(path + ".json", graph)) {
+        printf("Dumping pc dependency graph json to %s.json\n", path.c_str());
+    }
+}
 
-            jout << ", \"dist\": {"
-                 << "\"intra_thread\": " << st.dist[0]
-                 << ", \"intra_instance_launch\": " << st.dist[1]
-                 << ", \"intra_warp\": " << st.dist[2]
-                 << ", \"intra_block\": " << st.dist[3]
-                 << ", \"intra_grid\": " << st.dist[4]
-                 << "}}";
-        }
-        jout << "\n";
+
+void PcDependency::write_kernel_aggregate(KernelAggregate_t& aggregate) const {
+    write_graph_files(output_directory + "/aggregate_" + std::to_string(aggregate.index), aggregate.graph);
+    aggregate.written_launches = aggregate.graph.kernel.launch_count;
+}
+
+
+void PcDependency::kernel_trace_flush(std::shared_ptr<KernelLaunch_t> kernel) {
+    // PC dependency graph, joinable with the CFG
+    DependencyGraph_t graph;
+    build_dependency_graph(*kernel, graph);
+    const std::string path = output_directory + "/kernel_" + std::to_string(kernel->kernel_id);
+    if (!_aggregate_launches) {
+        write_graph_files(path, graph);
+        return;
+    }
+
+    const KernelIdentity_t identity(kernel->kernel_name,
+                                    kernel->grid_dim_x, kernel->grid_dim_y, kernel->grid_dim_z,
+                                    kernel->block_dim_x, kernel->block_dim_y, kernel->block_dim_z);
+    auto it = _kernel_aggregates.find(identity);
+    if (it == _kernel_aggregates.end()) {
+        KernelAggregate_t& aggregate = _kernel_aggregates[identity];
+        aggregate.index = _kernel_aggregates.size() - 1;
+        aggregate.graph = std::move(graph);
+        write_kernel_aggregate(aggregate);
+        return;
+    }
+
+    KernelAggregate_t& aggregate = it->second;
+    const double distance = dependency_graph_distance(aggregate.graph, graph);
+    if (distance > _aggregate_delta) {
+        printf("[PC_DEPENDENCY] Kernel %u differs from aggregate %lu by %.1f%%\n",
+               kernel->kernel_id, aggregate.index, distance * 100.0);
+        write_graph_files(path, graph);
+    }
+    merge_dependency_graph(aggregate.graph, graph);
+    // Rewritten at every power of two launches, so long runs keep an
+    // up-to-date file at a logarithmic cost; flush() writes the rest.
+    const uint64_t launches = aggregate.graph.kernel.launch_count;
+    if ((launches & (launches - 1)) == 0) {
+        write_kernel_aggregate(aggregate);
     }
-    jout << "  ]\n";
-    jout << "}\n";
-    printf("Dumping pc dependency graph json to %s\n", json_filename.c_str());
 }
 
 
-void PcDependency::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
+void PcDependency::kernel_end_callback(const EventRecord_t& record) {
+    // The only point the pipeline must be empty: results are written now.
+    drain_pipeline();
+    merge_worker_statistics();
     auto evt = std::prev(kernel_events.end())->second;
     evt->end_time = _timer.get();
     kernel_trace_flush(evt);
 
+    uint64_t reserved_bytes = 0;
+    uint64_t resident_bytes = 0;
+    for (auto& shadow_memory_iter : _shadow_memories) {
+        reserved_bytes += shadow_memory_iter.second->_entries_bytes;
+        resident_bytes += shadow_memory_iter.second->resident_bytes();
+    }
+    printf("[PC_DEPENDENCY] Shadow memory resident: %lu of %lu bytes in %lu regions\n",
+           resident_bytes, reserved_bytes, _shadow_memories.size());
+    uint64_t shared_requests = 0;
+    uint64_t bank_replays = 0;
+    for (uint32_t pc_id = 0; pc_id < _pc_table.size(); ++pc_id) {
+        for (uint32_t bin = 0; bin < k_pc_histogram_bins[PcHistogram_BANK_REPLAYS]; ++bin) {
+            const uint64_t requests = _pc_table.histogram(PcHistogram_BANK_REPLAYS, pc_id, bin);
+            shared_requests += requests;
+            bank_replays += bin * requests;
+        }
+    }
+    if (shared_requests > 0) {
+        printf("[PC_DEPENDENCY] Shared memory bank conflicts: %lu replays over %lu requests\n",
+               bank_replays, shared_requests);
+    }
+    if (_worker_count > 1) {
+        printf("[PC_DEPENDENCY] Work stealing moved %lu CTA tasks between %lu workers\n",
+               _kernel_stolen_tasks, _worker_count);
+    }
+
     _timer.increment(true);
 }
 
 
-void PcDependency::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void PcDependency::mem_alloc_callback(const EventRecord_t& record) {
+    drain_pipeline();
+    auto mem = make_event<MemAlloc_t>(record);
     // TODO： add shadow memory allocation here
     alloc_events.emplace(_timer.get(), mem);
     active_memories.emplace(mem->addr, mem);
     memory_region memory_region_current = memory_region((uint64_t)mem->addr, (uint64_t)(mem->addr + mem->size));
-    _memory_regions.insert(
-        std::lower_bound(_memory_regions.begin(), _memory_regions.end(), memory_region_current),
-        memory_region_current
-    );
-    _shadow_memories.emplace(memory_region_current, std::make_unique<shadow_memory>(mem->size));
+    _shadow_memories.emplace(memory_region_current, std::make_unique<shadow_memory>(mem->size, _shadow_budget, _shadow_granularity,
+                                                                                _reuse_times, _shadow_chunk_bits));
+    map_shadow_region(memory_region_current.get_start(), memory_region_current.get_end());
 
     printf("[PC_DEPENDENCY] Allocating shadow memory for memory region: %p - %p, size: %lu\n", (void*)memory_region_current.get_start(), (void*)memory_region_current.get_end(), mem->size);
     _timer.increment(true);
 }
 
-void PcDependency::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
-    auto it = active_memories.find(mem->addr);
+void PcDependency::mem_free_callback(const EventRecord_t& record) {
+    drain_pipeline();
+    const auto& mem = record.mem_free;
+    auto it = active_memories.find(mem.addr);
     if(it == active_memories.end()) {
-        printf("[PC_DEPENDENCY] Memory free callback: memory %lu not found, it is not regularly allocated. Active memories: %ld\n", mem->addr, active_memories.size());
+        printf("[PC_DEPENDENCY] Memory free callback: memory %lu not found, it is not regularly allocated. Active memories: %ld\n", mem.addr, active_memories.size());
         return;
     }
     // assert(it != active_memories.end());
@@ -440,18 +483,22 @@ void PcDependency::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
     uint64_t sz = it->second->size;   // 从 alloc 事件拿 size
     active_memories.erase(it);
 
-    memory_region r((uint64_t)mem->addr, (uint64_t)mem->addr + sz);
+    memory_region r((uint64_t)mem.addr, (uint64_t)mem.addr + sz);
 
-    auto vit = std::lower_bound(_memory_regions.begin(), _memory_regions.end(), r);
-    if (vit != _memory_regions.end() && *vit == r) _memory_regions.erase(vit);
-
-    _shadow_memories.erase(r);
+    auto shadow_it = _shadow_memories.find(r);
+    if (shadow_it != _shadow_memories.end()) {
+        printf("[PC_DEPENDENCY] Shadow memory region %p touched %lu of %lu chunks\n",
+               (void*)r.get_start(), shadow_it->second->touched_chunks(), shadow_it->second->_chunk_count);
+        _shadow_memories.erase(shadow_it);
+    }
+    map_shadow_region(r.get_start(), r.get_end());
     printf("[PC_DEPENDENCY] Freeing shadow memory for memory region: %p - %p, size: %lu\n", (void*)r.get_start(), (void*)r.get_end(), sz);
     _timer.increment(true);
 }
 
 
-void PcDependency::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
+void PcDependency::ten_alloc_callback(const EventRecord_t& record) {
+    auto ten = make_event<TenAlloc_t>(record);
     tensor_events.emplace(_timer.get(), ten);
     active_tensors.emplace(ten->addr, ten);
     // memory_region memory_region_current((uint64_t)ten->addr, (uint64_t)(ten->addr + ten->size));
@@ -466,15 +513,16 @@ void PcDependency::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
 }
 
 
-void PcDependency::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
-    auto it = active_tensors.find(ten->addr);
+void PcDependency::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
+    auto it = active_tensors.find(ten.addr);
     assert(it != active_tensors.end());
 
     // TenFree.size may be negative (e.g., accounting-style events). Use size from TenAlloc.
     const uint64_t sz = static_cast<uint64_t>(it->second->size);
     active_tensors.erase(it);
 
-    // memory_region r((uint64_t)ten->addr, (uint64_t)ten->addr + sz);
+    // memory_region r((uint64_t)ten.addr, (uint64_t)ten.addr + sz);
 
     // auto vit = std::lower_bound(_memory_regions.begin(), _memory_regions.end(), r);
     // if (vit != _memory_regions.end() && *vit == r) {
@@ -487,40 +535,166 @@ void PcDependency::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
     _timer.increment(true);
 }
 
+shadow_page_entry PcDependency::find_shadow_region(uint64_t addr) const {
+    shadow_page_entry entry;
+    auto it = _shadow_memories.upper_bound(memory_region(addr, std::numeric_limits<uint64_t>::max()));
+    if (it != _shadow_memories.begin()) {
+        --it;
+        if (it->first.contains(addr)) {
+            entry.shadow = it->second.get();
+            entry.start = it->first.get_start();
+        }
+    }
+    return entry;
+}
+
+
+void PcDependency::update_shadow_page(uint64_t page) {
+    const uint64_t page_start = page << shadow_page_table::k_page_bits;
+    const uint64_t page_end = page_start + (1ull << shadow_page_table::k_page_bits);
+    // regions are disjoint, so their ends are ordered like their starts
+    auto it = _shadow_memories.lower_bound(memory_region(page_end, 0));
+    shadow_memory* shadow = nullptr;
+    uint64_t start = 0;
+    uint32_t regions = 0;
+    while (it != _shadow_memories.begin() && regions < 2) {
+        --it;
+        if (it->first.get_end() <= page_start) {
+            break;
+        }
+        shadow = it->second.get();
+        start = it->first.get_start();
+        regions++;
+    }
+    if (regions == 2) {
+        _shadow_pages.set(page, nullptr, shadow_page_entry::k_mixed);
+    } else {
+        _shadow_pages.set(page, shadow, start);
+    }
+}
+
+
+// Called after the region [start, end) was added to or removed from
+// _shadow_memories. Only its first and last page can be shared with other
+// regions; the pages in between are its own.
+void PcDependency::map_shadow_region(uint64_t start, uint64_t end) {
+    if (end <= start) {
+        return;
+    }
+    const uint64_t first_page = start >> shadow_page_table::k_page_bits;
+    const uint64_t last_page = (end - 1) >> shadow_page_table::k_page_bits;
+    auto it = _shadow_memories.find(memory_region(start, end));
+    shadow_memory* shadow = it != _shadow_memories.end() ? it->second.get() : nullptr;
+    for (uint64_t page = first_page + 1; page < last_page; page++) {
+        _shadow_pages.set(page, shadow, shadow ? start : 0);
+    }
+    update_shadow_page(first_page);
+    if (last_page != first_page) {
+        update_shadow_page(last_page);
+    }
+}
+
+
+void PcDependency::enforce_shadow_budget() {
+    const uint64_t budget_bytes = _shadow_budget.limit();
+    if (budget_bytes == 0) {
+        return;
+    }
+    // Workers refuse chunks rather than map them past the budget; make room
+    // once the budget has refused one or is nearly full.
+    const bool refused = _shadow_budget.take_refused();
+    uint64_t resident_bytes = _shadow_budget.resident();
+    if (!refused && resident_bytes <= budget_bytes - budget_bytes / 16) {
+        return;
+    }
+
+    // Evict down to 7/8 of the budget so the next batches do not evict again.
+    const uint64_t target_bytes = budget_bytes - budget_bytes / 8;
+    struct EvictCandidate {
+        uint32_t last_use;
+        shadow_memory* shadow;
+        uint64_t chunk;
+    };
+    std::vector<EvictCandidate> candidates;
+    for (auto& shadow_memory_iter : _shadow_memories) {
+        shadow_memory* shadow = shadow_memory_iter.second.get();
+        for (uint64_t chunk = 0; chunk < shadow->_chunk_count; chunk++) {
+            if (shadow->chunk_mapped(chunk)) {
+                candidates.push_back(EvictCandidate{shadow->chunk_last_use(chunk), shadow, chunk});
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const EvictCandidate& a, const EvictCandidate& b) {
+        return a.last_use < b.last_use;
+    });
+
+    uint64_t evicted = 0;
+    uint64_t lossy = 0;
+    for (const auto& candidate : candidates) {
+        if (resident_bytes <= target_bytes) {
+            break;
+        }
+        const bool current_kernel = candidate.last_use >= _kernel_first_stamp;
+        resident_bytes -= candidate.shadow->evict_chunk(candidate.chunk, current_kernel);
+        evicted++;
+        lossy += current_kernel ? 1 : 0;
+    }
+    _kernel_evicted_chunks += evicted;
+    _kernel_lossy_evicted_chunks += lossy;
+    printf("[PC_DEPENDENCY] Shadow budget%s: evicted %lu chunks (%lu used by the running kernel), resident %lu bytes\n",
+           refused ? " full" : "", evicted, lossy, resident_bytes);
+}
+
+
 void PcDependency::unit_access(
     uint64_t ptr,
     uint32_t pc_offset,
     uint64_t current_block_id,
     uint32_t current_warp_id,
     uint32_t current_lane_id,
-    memory_region& memory_region_target,
+    shadow_memory& shadow_memory,
     int access_size,
-    phmap::flat_hash_map<uint64_t, PC_statisitics>& local_pc_statistics
+    uint32_t now,
+    pc_statistics_map& local_pc_statistics,
+    pc_reuse_time_map* local_reuse_times
 ) {
-    // auto& shadow_memory = this->_shadow_memories[memory_region_target];
-    auto shadow_memory_it = this->_shadow_memories.find(memory_region_target);
-    if (shadow_memory_it == this->_shadow_memories.end()) {
-        printf("shadow memory not found for memory region: %lu - %lu\n", memory_region_target.get_start(), memory_region_target.get_end());
-        return;
-    }
-    auto& shadow_memory = *(shadow_memory_it->second);
     const uint32_t current_flat_thread_id =
         static_cast<uint32_t>((current_block_id << 10) | (current_warp_id << 5) | current_lane_id);
 
-    for (int i = 0; i < access_size; i += 4) {
-        const uint64_t addr = ptr + i;
-        // Byte-granularity shadow memory: addr is byte offset within allocation.
+    // addr is the byte offset within the allocation. With granularity 1 the
+    // access is sampled every 4 bytes from its start, otherwise once per
+    // shadow entry it covers.
+    const uint64_t first = _shadow_granularity == 1 ? ptr : ptr & ~static_cast<uint64_t>(_shadow_granularity - 1);
+    for (uint64_t addr = first; addr < ptr + access_size; addr += _sample_stride) {
         // Bound check to avoid OOB on allocations at end boundary or odd sizes.
         if (addr >= shadow_memory._size) {
             break;
         }
 
-        auto& entry = shadow_memory.get_entry(addr);
+        uint32_t* time = nullptr;
+        bool lossy = false;
+        auto* entry = shadow_memory.get_entry(addr, _shadow_stamp, &lossy, local_reuse_times ? &time : nullptr);
+        if (entry == nullptr) {
+            // no room in the shadow budget: the access is not recorded
+            local_pc_statistics[pack_pc_ancient_pairs(pc_offset, 0u)].dist[5] += 1;
+            continue;
+        }
         const uint64_t old_packed = __atomic_exchange_n(
-            &entry.packed,
+            &entry->packed,
             pack_shadow_entry(_kernel_generation, pc_offset, current_flat_thread_id),
             __ATOMIC_ACQ_REL
         );
+        uint32_t last_time = now;
+        if (time != nullptr) {
+            // Not atomic with the entry: a racing write can pair an entry
+            // with the other writer's time.
+            last_time = __atomic_load_n(time, __ATOMIC_RELAXED);
+            __atomic_store_n(time, now, __ATOMIC_RELAXED);
+        }
+        if (old_packed == 0 && lossy) {
+            local_pc_statistics[pack_pc_ancient_pairs(pc_offset, 0u)].dist[5] += 1;
+            continue;
+        }
         const bool is_cold_miss = (old_packed == 0);
 
         if (is_cold_miss) {
@@ -551,6 +725,9 @@ void PcDependency::unit_access(
         } else {
             local_pc_statistics[pc_ancient_pairs].dist[0] += 1;
         }
+        if (local_reuse_times != nullptr) {
+            (*local_reuse_times)[pc_ancient_pairs][dependency_reuse_bin(reuse_distance(now, last_time))] += 1;
+        }
     }
 }
 
@@ -561,36 +738,27 @@ void PcDependency::unit_access_unknown(
     uint32_t current_warp_id,
     uint32_t current_lane_id,
     int access_size,
-    phmap::flat_hash_map<uint64_t, PC_statisitics>& local_pc_statistics
+    uint32_t now,
+    pc_statistics_map& local_pc_statistics,
+    pc_reuse_time_map* local_reuse_times
 ) {
     const uint32_t current_flat_thread_id =
         static_cast<uint32_t>((current_block_id << 10) | (current_warp_id << 5) | current_lane_id);
 
-    for (int i = 0; i < access_size; i += 4) {
-        const uint64_t sampled_addr = abs_addr + static_cast<uint64_t>(i);
+    const uint64_t first = _shadow_granularity == 1 ? abs_addr : abs_addr & ~static_cast<uint64_t>(_shadow_granularity - 1);
+    for (uint64_t sampled_addr = first; sampled_addr < abs_addr + access_size; sampled_addr += _sample_stride) {
         const uint64_t new_packed =
             pack_shadow_entry(_kernel_generation, pc_offset, current_flat_thread_id);
 
-        // Atomically insert-or-update under the shard's lock.
-        // try_emplace_l: if key exists  -> calls lambda(value_ref), returns false.
-        //                if key missing -> inserts with new_packed,  returns true.
-        uint64_t old_packed = 0;
-        const bool inserted = _unknown_region_shadow.try_emplace_l(
-            sampled_addr,
-            [&](auto& kv) {
-                old_packed = kv.second;
-                kv.second = new_packed;
-            },
-            new_packed   // value used when the key is first inserted
-        );
-
-        if (inserted) {
-            // First-ever access to this address this kernel → cold miss.
-            local_pc_statistics[pack_pc_ancient_pairs(pc_offset, 0u)].dist[0] += 1;
-            continue;
+        uint32_t* time = nullptr;
+        const uint64_t old_packed = _unknown_region_shadow.exchange(sampled_addr, new_packed,
+                                                                    local_reuse_times ? &time : nullptr);
+        uint32_t last_time = now;
+        if (time != nullptr) {
+            last_time = __atomic_load_n(time, __ATOMIC_RELAXED);
+            __atomic_store_n(time, now, __ATOMIC_RELAXED);
         }
-
-        // Key already existed; old_packed holds the previous entry.
+        // First access to this address this kernel → cold miss.
         const bool is_cold_miss = (old_packed == 0);
         if (is_cold_miss) {
             local_pc_statistics[pack_pc_ancient_pairs(pc_offset, 0u)].dist[0] += 1;
@@ -620,6 +788,9 @@ void PcDependency::unit_access_unknown(
         } else {
             local_pc_statistics[pc_ancient_pairs].dist[0] += 1;
         }
+        if (local_reuse_times != nullptr) {
+            (*local_reuse_times)[pc_ancient_pairs][dependency_reuse_bin(reuse_distance(now, last_time))] += 1;
+        }
     }
 }
 
@@ -632,8 +803,7 @@ void PcDependency::unit_access_shared(
     uint32_t current_warp_id,
     uint32_t current_lane_id,
     int access_size,
-    phmap::flat_hash_map<uint64_t, PC_statisitics>& local_pc_statistics,
-    worker_shared_shadow_state& local_shadow_memory_shared
+    pc_statistics_map& local_pc_statistics
 ) {
     const uint32_t base_addr_low32 = static_cast<uint32_t>(ptr & 0xFFFFFFFFull);
     const uint32_t current_flat_thread_id =
@@ -646,7 +816,7 @@ void PcDependency::unit_access_shared(
             local_pc_statistics[pc_ancient_pairs].dist[0] += 1;
             continue;
         }
-        auto& entry = get_shared_shadow_entry(local_shadow_memory_shared, object_idx, addr);
+        auto& entry = get_shared_shadow_entry(object_idx, addr);
         const bool is_cold_miss = (entry.generation != _shared_kernel_generation)
                                || (entry.flat_block_id != static_cast<uint32_t>(current_block_id));
 
@@ -680,71 +850,112 @@ void PcDependency::unit_access_shared(
     }
 }
 
-uint32_t PcDependency::acquire_shared_shadow_object(
-    worker_shared_shadow_state& local_shadow_memory_shared,
-    uint64_t cta_id
-) {
-    const uint64_t local_slot_u64 = cta_id / _worker_count;
-    if (local_slot_u64 >= local_shadow_memory_shared.cta_slot_to_object.size()) {
-        local_shadow_memory_shared.cta_slot_to_object.resize(
-            static_cast<size_t>(local_slot_u64 + 1u),
-            worker_shared_shadow_state::k_invalid_object
-        );
-    }
-    const uint32_t local_slot = static_cast<uint32_t>(local_slot_u64);
-    const uint32_t mapped_object = local_shadow_memory_shared.cta_slot_to_object[local_slot];
+uint32_t PcDependency::acquire_shared_shadow_object(uint64_t cta_id) {
+    // The table is sized for the batch before the workers start.
+    uint32_t& mapped_object = _cta_shared_object[cta_id];
     if (mapped_object != worker_shared_shadow_state::k_invalid_object) {
         return mapped_object;
     }
-    if (local_shadow_memory_shared.free_object_indices.empty()) {
-        local_shadow_memory_shared.pool_miss_count += 1;
+    auto& pool = _shadow_memory_shared;
+    std::lock_guard<std::mutex> guard(_shared_shadow_pool_mutex);
+    if (pool.free_object_indices.empty()) {
+        pool.pool_miss_count += 1;
         return std::numeric_limits<uint32_t>::max();
     }
-    const uint32_t object_idx = local_shadow_memory_shared.free_object_indices.back();
-    local_shadow_memory_shared.free_object_indices.pop_back();
-    local_shadow_memory_shared.object_owner_cta[object_idx] = cta_id;
-    local_shadow_memory_shared.object_active_threads[object_idx] = _current_block_thread_count;
-    local_shadow_memory_shared.cta_slot_to_object[local_slot] = object_idx;
+    const uint32_t object_idx = pool.free_object_indices.back();
+    pool.free_object_indices.pop_back();
+    pool.object_owner_cta[object_idx] = cta_id;
+    pool.object_active_threads[object_idx] = _current_block_thread_count;
+    mapped_object = object_idx;
     return object_idx;
 }
 
-void PcDependency::release_shared_shadow_object(
-    worker_shared_shadow_state& local_shadow_memory_shared,
-    uint64_t cta_id,
-    uint32_t exiting_threads
-) {
-    const uint64_t local_slot_u64 = cta_id / _worker_count;
-    if (local_slot_u64 >= local_shadow_memory_shared.cta_slot_to_object.size()) {
+void PcDependency::release_shared_shadow_object(uint64_t cta_id, uint32_t exiting_threads) {
+    if (cta_id >= _cta_shared_object.size()) {
         return;
     }
-    const uint32_t local_slot = static_cast<uint32_t>(local_slot_u64);
-    const uint32_t object_idx = local_shadow_memory_shared.cta_slot_to_object[local_slot];
+    uint32_t& mapped_object = _cta_shared_object[cta_id];
+    const uint32_t object_idx = mapped_object;
     if (object_idx == worker_shared_shadow_state::k_invalid_object) {
         return;
     }
-    uint32_t& active_threads = local_shadow_memory_shared.object_active_threads[object_idx];
+    auto& pool = _shadow_memory_shared;
+    // Only the worker running this CTA touches the object's counters.
+    uint32_t& active_threads = pool.object_active_threads[object_idx];
     if (active_threads > exiting_threads) {
         active_threads -= exiting_threads;
         return;
     }
     active_threads = 0;
-    local_shadow_memory_shared.cta_slot_to_object[local_slot] = worker_shared_shadow_state::k_invalid_object;
-    local_shadow_memory_shared.object_owner_cta[object_idx] = std::numeric_limits<uint64_t>::max();
-    local_shadow_memory_shared.object_active_threads[object_idx] = 0u;
-    local_shadow_memory_shared.free_object_indices.push_back(object_idx);
+    mapped_object = worker_shared_shadow_state::k_invalid_object;
+    pool.object_owner_cta[object_idx] = std::numeric_limits<uint64_t>::max();
+    std::lock_guard<std::mutex> guard(_shared_shadow_pool_mutex);
+    pool.free_object_indices.push_back(object_idx);
 }
 
-shared_shadow_memory_entry& PcDependency::get_shared_shadow_entry(
-    worker_shared_shadow_state& local_shadow_memory_shared,
-    uint32_t object_idx,
-    uint32_t addr
-) {
+shared_shadow_memory_entry& PcDependency::get_shared_shadow_entry(uint32_t object_idx, uint32_t addr) {
     assert(addr < _shared_shadow_bytes_per_object);
-    return local_shadow_memory_shared.object_entries[object_idx][addr];
+    return _shadow_memory_shared.object_entries[object_idx][addr];
+}
+
+local_shadow_memory& PcDependency::acquire_local_shadow(uint64_t cta_id) {
+    // The table is sized for the batch before the workers start.
+    std::unique_ptr<local_shadow_memory>& shadow = _cta_local_shadow[cta_id];
+    if (!shadow) {
+        shadow = std::make_unique<local_shadow_memory>();
+        shadow->active_threads = _current_block_thread_count;
+    }
+    return *shadow;
+}
+
+void PcDependency::release_local_shadow(uint64_t cta_id, uint32_t exiting_threads) {
+    if (cta_id >= _cta_local_shadow.size() || !_cta_local_shadow[cta_id]) {
+        return;
+    }
+    // Only the worker running this CTA touches its shadow.
+    uint32_t& active_threads = _cta_local_shadow[cta_id]->active_threads;
+    if (active_threads > exiting_threads) {
+        active_threads -= exiting_threads;
+        return;
+    }
+    _cta_local_shadow[cta_id].reset();
 }
 
-void PcDependency::unit_access_local(uint64_t ptr, uint32_t pc_offset, uint64_t current_block_id, uint32_t current_warp_id, uint32_t current_lane_id, int access_size) {
-    // TODO: implement local memory access
+void PcDependency::unit_access_local(
+    uint64_t ptr,
+    uint32_t pc_offset,
+    bool is_store,
+    local_shadow_memory& shadow,
+    uint32_t current_warp_id,
+    uint32_t current_lane_id,
+    int access_size,
+    uint32_t now,
+    pc_statistics_map& local_pc_statistics,
+    pc_reuse_time_map* local_reuse_times
+) {
+    const uint64_t thread_key = static_cast<uint64_t>((current_warp_id << 5) | current_lane_id) << 32;
+    const uint32_t base_addr_low32 = static_cast<uint32_t>(ptr & 0xFFFFFFFFull);
+
+    for (int i = 0; i < access_size; i += 4) {
+        const uint64_t key = thread_key | (base_addr_low32 + static_cast<uint32_t>(i));
+        if (is_store) {
+            local_shadow_memory_entry& entry = shadow.entries[key];
+            entry.pc_offset = pc_offset;
+            entry.time = now;
+            continue;
+        }
+        auto it = shadow.entries.find(key);
+        if (it == shadow.entries.end()) {
+            // Nothing stored by this thread yet: a cold fill.
+            local_pc_statistics[pack_pc_ancient_pairs(pc_offset, 0u)].dist[6] += 1;
+            continue;
+        }
+        const uint64_t pc_ancient_pairs = pack_pc_ancient_pairs(pc_offset, it->second.pc_offset);
+        local_pc_statistics[pc_ancient_pairs].dist[6] += 1;
+        if (local_reuse_times != nullptr) {
+            (*local_reuse_times)[pc_ancient_pairs][dependency_reuse_bin(reuse_distance(now, it->second.time))] += 1;
+        }
+    }
 }
 
 
@@ -763,260 +974,425 @@ void PcDependency::worker_loop(uint64_t worker_idx) {
             current_generation = _worker_job_generation;
         }
 
-        auto& local_pc_statistics = _job_worker_pc_statistics[worker_idx];
-        auto& local_pc_flags = _job_worker_pc_flags[worker_idx];
-        auto& local_distinct_sector_count = _job_worker_distinct_sector_count[worker_idx];
-        auto& local_shadow_memory_shared = _worker_shadow_memory_shared[worker_idx];
-        const auto& trace_indices = _job_worker_trace_indices[worker_idx];
-
-        for (uint64_t i : trace_indices) {
-            const MemoryAccess& trace = _job_accesses_buffer[i];
-            uint32_t pc_offset = (trace.pc & 0x00FFFFFFu);
-            uint32_t flags = trace.flags;
-            uint32_t access_size = trace.accessSize;
-            uint32_t distinct_sector_count = trace.distinct_sector_count;
-            uint32_t active_mask = trace.active_mask;
-            switch (trace.type) {
-                case MemoryType::Local:{
-                        flags |= SANITIZER_MEMORY_LOCAL;
-                        break;
-                    }
-                case MemoryType::Shared:{
-                        flags |= SANITIZER_MEMORY_SHARED;
-                        const uint32_t object_idx =
-                            acquire_shared_shadow_object(local_shadow_memory_shared, trace.ctaId);
-                        if (object_idx == std::numeric_limits<uint32_t>::max()) {
-                            // Hard capacity hit: keep behavior safe by treating accesses as cold misses.
-                            const uint32_t samples = (trace.accessSize + 3u) / 4u;
-                            const uint64_t pc_ancient_pairs = pack_pc_ancient_pairs(pc_offset, 0u);
-                            local_pc_statistics[pc_ancient_pairs].dist[0] +=
-                                static_cast<uint64_t>(samples) * static_cast<uint64_t>(__builtin_popcount(active_mask));
-                            break;
-                        }
-                        // Repeat lanes are intra-instance-launch reuse.
-                        const uint32_t unique_mask = trace.unique_address_mask;
-                        const uint32_t repeat_count = __builtin_popcount(active_mask & ~unique_mask);
-                        if (repeat_count > 0) {
-                            local_pc_statistics[pack_pc_ancient_pairs(pc_offset, pc_offset)].dist[1] += repeat_count;
-                        }
-                        uint32_t remaining_mask = unique_mask;
-                        while (remaining_mask != 0) {
-                            const uint32_t j = static_cast<uint32_t>(__builtin_ctz(remaining_mask));
-                            remaining_mask &= (remaining_mask - 1);
-                            unit_access_shared(
-                                trace.addresses[j],
-                                pc_offset,
-                                object_idx,
-                                trace.ctaId,
-                                trace.warpId,
-                                j,
-                                trace.accessSize,
-                                local_pc_statistics,
-                                local_shadow_memory_shared
-                            );
-                        }
-                        break;
-                    }
-                case MemoryType::Global:{
-                        flags |= SANITIZER_MEMORY_GLOBAL;
-                        if (active_mask == 0) {
+        if (_job_merge) {
+            merge_statistics_shards(worker_idx);
+            std::lock_guard<std::mutex> guard(_worker_pool_mutex);
+            seen_generation = current_generation;
+            assert(_worker_pending_jobs > 0);
+            _worker_pending_jobs -= 1;
+            if (_worker_pending_jobs == 0) {
+                _job_merge = false;
+                _pipeline_cv.notify_all();
+            }
+            continue;
+        }
+
+        pipeline_batch& job = *_job_slot;
+        auto& local_pc_statistics = _worker_pc_statistics[worker_idx];
+        auto& local_pc_table = _worker_pc_tables[worker_idx];
+        pc_reuse_time_map* local_reuse_times = _reuse_times ? &_worker_pc_reuse_times[worker_idx] : nullptr;
+        const AccessBatch_t& batch = job.batch;
+
+        uint32_t task_idx = 0;
+        while (next_task(job, worker_idx, task_idx)) {
+            const CtaTask_t& task = job.tasks[task_idx];
+            for (uint64_t k = task.begin; k < task.end; ++k) {
+                const uint64_t i = job.task_traces[k];
+                const MemoryAccess& trace = batch.accesses[i];
+                const DecodedAccess_t& decoded = batch.decoded[i];
+                uint32_t pc_offset = (trace.pc & 0x00FFFFFFu);
+                uint32_t flags = trace.flags;
+                uint32_t access_size = trace.accessSize;
+                uint32_t distinct_sector_count = trace.distinct_sector_count;
+                uint32_t active_mask = trace.active_mask;
+                const uint32_t now = static_cast<uint32_t>(job.first_record + i);
+                uint32_t bank_conflict_degree = 0;
+                uint32_t bank_replays = 0;
+                switch (trace.type) {
+                    case MemoryType::Local:{
+                            flags |= SANITIZER_MEMORY_LOCAL;
+                            if (active_mask == 0) {
+                                break;
+                            }
+                            // Every lane has its own local memory at the same
+                            // addresses, so lanes are not deduplicated.
+                            local_shadow_memory& shadow = acquire_local_shadow(trace.ctaId);
+                            const bool is_store = (flags & SANITIZER_MEMORY_DEVICE_FLAG_WRITE) != 0;
+                            uint32_t remaining_mask = active_mask;
+                            while (remaining_mask != 0) {
+                                const uint32_t j = static_cast<uint32_t>(__builtin_ctz(remaining_mask));
+                                remaining_mask &= (remaining_mask - 1);
+                                unit_access_local(
+                                    trace.addresses[j],
+                                    pc_offset,
+                                    is_store,
+                                    shadow,
+                                    trace.warpId,
+                                    j,
+                                    access_size,
+                                    now,
+                                    local_pc_statistics,
+                                    local_reuse_times
+                                );
+                            }
                             break;
                         }
-                        // Repeat lanes (same address as an earlier lane in this warp) are
-                        // intra-instance-launch reuse: classify directly without shadow access.
-                        const uint32_t unique_mask = trace.unique_address_mask;
-                        const uint32_t repeat_count = __builtin_popcount(active_mask & ~unique_mask);
-                        if (repeat_count > 0) {
-                            local_pc_statistics[pack_pc_ancient_pairs(pc_offset, pc_offset)].dist[1] += repeat_count;
-                        }
-                        const uint32_t first_lane = static_cast<uint32_t>(__builtin_ctz(active_mask));
-                        const uint64_t first_valid_address = trace.addresses[first_lane];
-                        const memory_region* memory_region_target_ptr =
-                            find_memory_region_containing(this->_memory_regions, first_valid_address);
-                        uint32_t remaining_mask = unique_mask;
-                        if (memory_region_target_ptr == nullptr) {
-                            // Fallback: region not tracked (static __device__ global,
-                            // VMM-mapped memory, etc.).  Use the concurrent hashmap.
+                    case MemoryType::Shared:{
+                            flags |= SANITIZER_MEMORY_SHARED;
+                            if (active_mask != 0) {
+                                shared_bank_conflicts(trace, bank_conflict_degree, bank_replays);
+                            }
+                            const uint32_t object_idx = acquire_shared_shadow_object(trace.ctaId);
+                            if (object_idx == std::numeric_limits<uint32_t>::max()) {
+                                // Hard capacity hit: keep behavior safe by treating accesses as cold misses.
+                                const uint32_t samples = (trace.accessSize + 3u) / 4u;
+                                const uint64_t pc_ancient_pairs = pack_pc_ancient_pairs(pc_offset, 0u);
+                                local_pc_statistics[pc_ancient_pairs].dist[0] +=
+                                    static_cast<uint64_t>(samples) * static_cast<uint64_t>(decoded.active_lanes);
+                                break;
+                            }
+                            // Repeat lanes are intra-instance-launch reuse.
+                            const uint32_t unique_mask = trace.unique_address_mask;
+                            if (decoded.repeat_lanes > 0) {
+                                local_pc_statistics[pack_pc_ancient_pairs(pc_offset, pc_offset)].dist[1] += decoded.repeat_lanes;
+                            }
+                            uint32_t remaining_mask = unique_mask;
                             while (remaining_mask != 0) {
                                 const uint32_t j = static_cast<uint32_t>(__builtin_ctz(remaining_mask));
                                 remaining_mask &= (remaining_mask - 1);
-                                unit_access_unknown(
+                                unit_access_shared(
                                     trace.addresses[j],
                                     pc_offset,
+                                    object_idx,
                                     trace.ctaId,
                                     trace.warpId,
                                     j,
-                                    access_size,
+                                    trace.accessSize,
                                     local_pc_statistics
                                 );
                             }
-                        } else {
-                            memory_region memory_region_target = *memory_region_target_ptr;
-                            uint64_t memory_region_start = memory_region_target.get_start();
+                            break;
+                        }
+                    case MemoryType::Global:{
+                            flags |= SANITIZER_MEMORY_GLOBAL;
+                            if (active_mask == 0) {
+                                break;
+                            }
+                            // Repeat lanes (same address as an earlier lane in this warp) are
+                            // intra-instance-launch reuse: classify directly without shadow access.
+                            const uint32_t unique_mask = trace.unique_address_mask;
+                            if (decoded.repeat_lanes > 0) {
+                                local_pc_statistics[pack_pc_ancient_pairs(pc_offset, pc_offset)].dist[1] += decoded.repeat_lanes;
+                            }
+                            // Each lane is translated through the shadow page table.
+                            uint32_t remaining_mask = unique_mask;
                             while (remaining_mask != 0) {
                                 const uint32_t j = static_cast<uint32_t>(__builtin_ctz(remaining_mask));
                                 remaining_mask &= (remaining_mask - 1);
+                                const uint64_t addr = trace.addresses[j];
+                                shadow_page_entry page = _shadow_pages.lookup(addr);
+                                if (page.start == shadow_page_entry::k_mixed) {
+                                    page = find_shadow_region(addr);
+                                }
+                                if (page.shadow == nullptr || addr < page.start ||
+                                    addr - page.start >= page.shadow->_size) {
+                                    // Fallback: region not tracked (static __device__ global,
+                                    // VMM-mapped memory, etc.).  Use the lock-free epoch table.
+                                    unit_access_unknown(
+                                        addr,
+                                        pc_offset,
+                                        trace.ctaId,
+                                        trace.warpId,
+                                        j,
+                                        access_size,
+                                        now,
+                                        local_pc_statistics,
+                                        local_reuse_times
+                                    );
+                                    continue;
+                                }
                                 unit_access(
-                                    trace.addresses[j] - memory_region_start,
+                                    addr - page.start,
                                     pc_offset,
                                     trace.ctaId,
                                     trace.warpId,
                                     j,
-                                    memory_region_target,
+                                    *page.shadow,
                                     access_size,
-                                    local_pc_statistics
+                                    now,
+                                    local_pc_statistics,
+                                    local_reuse_times
                                 );
                             }
+                            break;
+                        }
+                    case MemoryType::BlockExit:{
+                            release_shared_shadow_object(trace.ctaId, decoded.active_lanes);
+                            release_local_shadow(trace.ctaId, decoded.active_lanes);
+                            continue;
                         }
+                    default:
+                        printf("unknown memory type\n");
                         break;
-                    }
-                case MemoryType::BlockExit:{
-                        const uint32_t exiting_threads = __builtin_popcount(active_mask);
-                        release_shared_shadow_object(local_shadow_memory_shared, trace.ctaId, exiting_threads);
-                        continue;
-                    }
-                default:
-                    printf("unknown memory type\n");
-                    break;
-            }
-            auto& local_flag = local_pc_flags[pc_offset];
-            local_flag.first |= flags;
-            if (local_flag.second == 0) {
-                local_flag.second = access_size;
-            } else if (local_flag.second != access_size) {
-                local_flag.second = std::max(local_flag.second, access_size);
-            }
-            if (distinct_sector_count >= 1 && distinct_sector_count <= 32) {
-                local_distinct_sector_count[pc_offset][distinct_sector_count - 1] += 1;
-            }
-            const uint32_t active_lane_count = __builtin_popcount(active_mask);
-            if (active_lane_count <= 32) {
-                local_distinct_sector_count[pc_offset][32 + active_lane_count] += 1;
-            }
-            const uint32_t distinct_address_count = __builtin_popcount(trace.unique_address_mask);
-            if (distinct_address_count >= 1 && distinct_address_count <= 32) {
-                local_distinct_sector_count[pc_offset][65 + distinct_address_count - 1] += 1;
+                }
+                const uint32_t pc_id = local_pc_table.intern(pc_offset);
+                local_pc_table.add_access(pc_id, flags, access_size);
+                if (distinct_sector_count >= 1 && distinct_sector_count <= 32) {
+                    local_pc_table.count(PcHistogram_SECTORS, pc_id, distinct_sector_count - 1);
+                }
+                const uint32_t active_lane_count = decoded.active_lanes;
+                if (active_lane_count <= 32) {
+                    local_pc_table.count(PcHistogram_LANES, pc_id, active_lane_count);
+                }
+                const uint32_t distinct_address_count = __builtin_popcount(trace.unique_address_mask);
+                if (distinct_address_count >= 1 && distinct_address_count <= 32) {
+                    local_pc_table.count(PcHistogram_ADDRESSES, pc_id, distinct_address_count - 1);
+                }
+                if (bank_conflict_degree != 0) {
+                    local_pc_table.count(PcHistogram_BANK_CONFLICTS, pc_id, bank_conflict_degree - 1);
+                    local_pc_table.count(PcHistogram_BANK_REPLAYS, pc_id, bank_replays);
+                }
             }
         }
 
+        bool last_worker = false;
         {
             std::lock_guard<std::mutex> guard(_worker_pool_mutex);
             seen_generation = current_generation;
-            if (!trace_indices.empty()) {
-                assert(_worker_pending_jobs > 0);
-                _worker_pending_jobs -= 1;
-                if (_worker_pending_jobs == 0) {
-                    _worker_pool_done_cv.notify_one();
-                }
-            }
+            assert(_worker_pending_jobs > 0);
+            _worker_pending_jobs -= 1;
+            last_worker = (_worker_pending_jobs == 0);
+        }
+        if (last_worker) {
+            finish_batch();
         }
     }
 }
 
 
-void PcDependency::gpu_data_analysis(void* data, uint64_t size) {
-    printf("[PC_DEPENDENCY] GPU data analysis called with size = %lu\n", size);
-    MemoryAccess* accesses_buffer = (MemoryAccess*)data;
-    if (size == 0) {
-        return;
+void PcDependency::start_next_batch() {
+    pipeline_batch* job = _pipeline_ready.front();
+    _pipeline_ready.pop_front();
+    if (job->max_cta_id >= _cta_shared_object.size()) {
+        _cta_shared_object.resize(job->max_cta_id + 1, worker_shared_shadow_state::k_invalid_object);
     }
-
-    for (uint64_t worker_idx = 0; worker_idx < _worker_count; ++worker_idx) {
-        _job_worker_trace_indices[worker_idx].clear();
-        _job_worker_pc_statistics[worker_idx].clear();
-        _job_worker_pc_flags[worker_idx].clear();
-        _job_worker_distinct_sector_count[worker_idx].clear();
-        _job_worker_trace_indices[worker_idx].reserve((size / _worker_count) + 1);
+    if (job->max_cta_id >= _cta_local_shadow.size()) {
+        _cta_local_shadow.resize(job->max_cta_id + 1);
     }
+    ++_shadow_stamp;
+    _job_slot = job;
+    _worker_pending_jobs = _worker_count;
+    ++_worker_job_generation;
+    _worker_pool_cv.notify_all();
+}
 
-    // Stable assignment by block id keeps intra-block trace order.
-    for (uint64_t i = 0; i < size; ++i) {
-        const uint64_t worker_idx = accesses_buffer[i].ctaId % _worker_count;
-        _job_worker_trace_indices[worker_idx].push_back(i);
-    }
 
-    uint64_t pending_jobs = 0;
-    for (uint64_t worker_idx = 0; worker_idx < _worker_count; ++worker_idx) {
-        if (!_job_worker_trace_indices[worker_idx].empty()) {
-            pending_jobs += 1;
-        }
+void PcDependency::finish_batch() {
+    // _job_slot stays set, so no batch starts while the budget is enforced.
+    enforce_shadow_budget();
+    _unknown_region_shadow.maintain();
+    for (auto& queue : _job_slot->worker_tasks) {
+        _kernel_stolen_tasks += queue.stolen_tasks;
+        queue.stolen_tasks = 0;
     }
-    if (pending_jobs == 0) {
-        return;
+    std::lock_guard<std::mutex> guard(_worker_pool_mutex);
+    _pipeline_free.push_back(_job_slot);
+    _job_slot = nullptr;
+    if (!_pipeline_ready.empty()) {
+        start_next_batch();
     }
+    _pipeline_cv.notify_all();
+}
 
-    {
-        std::lock_guard<std::mutex> guard(_worker_pool_mutex);
-        _job_accesses_buffer = accesses_buffer;
-        _worker_pending_jobs = pending_jobs;
-        ++_worker_job_generation;
+
+void PcDependency::merge_worker_statistics() {
+    // A kernel has few pcs next to its edges: the pc tables merge here.
+    for (const auto& local_pc_table : _worker_pc_tables) {
+        _pc_table.merge(local_pc_table);
     }
-    _worker_pool_cv.notify_all();
-    {
-        std::unique_lock<std::mutex> lock(_worker_pool_mutex);
-        _worker_pool_done_cv.wait(lock, [&]{
-            return _worker_pending_jobs == 0;
-        });
+    if (_worker_count == 1) {
+        std::swap(_pc_statistics, _worker_pc_statistics[0]);
+        std::swap(_pc_reuse_times, _worker_pc_reuse_times[0]);
+        return;
     }
+    std::unique_lock<std::mutex> lock(_worker_pool_mutex);
+    _job_merge = true;
+    _worker_pending_jobs = _worker_count;
+    ++_worker_job_generation;
+    _worker_pool_cv.notify_all();
+    _pipeline_cv.wait(lock, [&]{
+        return !_job_merge;
+    });
+}
+
 
-    for (auto& local_flags_map : _job_worker_pc_flags) {
-        for (auto& [pc, local_flag] : local_flags_map) {
-            auto& global_flag = this->_pc_flags[pc];
-            global_flag.first |= local_flag.first;
-            if (global_flag.second == 0) {
-                global_flag.second = local_flag.second;
-            } else if (global_flag.second != local_flag.second) {
-                global_flag.second = std::max(global_flag.second, local_flag.second);
+void PcDependency::merge_statistics_shards(uint64_t worker_idx) {
+    for (uint32_t shard = static_cast<uint32_t>(worker_idx); shard < k_pc_shards; shard += _worker_count) {
+        auto& global_statistics = _pc_statistics.shard(shard);
+        for (uint64_t source = 0; source < _worker_count; ++source) {
+            auto& local_statistics = _worker_pc_statistics[source].shard(shard);
+            if (global_statistics.empty()) {
+                global_statistics.swap(local_statistics);
+                continue;
+            }
+            for (auto& kv : local_statistics) {
+                auto& global_stats = global_statistics[kv.first];
+                for (size_t d = 0; d < global_stats.dist.size(); ++d) {
+                    global_stats.dist[d] += kv.second.dist[d];
+                }
+            }
+        }
+        auto& global_reuse_times = _pc_reuse_times.shard(shard);
+        for (uint64_t source = 0; source < _worker_count; ++source) {
+            auto& local_reuse_times = _worker_pc_reuse_times[source].shard(shard);
+            if (global_reuse_times.empty()) {
+                global_reuse_times.swap(local_reuse_times);
+                continue;
+            }
+            for (auto& kv : local_reuse_times) {
+                auto& global_bins = global_reuse_times[kv.first];
+                for (size_t bin = 0; bin < global_bins.size(); ++bin) {
+                    global_bins[bin] += kv.second[bin];
+                }
             }
         }
     }
+}
 
-    for (auto& local_distinct_map : _job_worker_distinct_sector_count) {
-        for (auto& [pc, local_hist] : local_distinct_map) {
-            auto& global_hist = this->_distinct_sector_count[pc];
-            for (size_t idx = 0; idx < global_hist.size(); ++idx) {
-                global_hist[idx] += local_hist[idx];
-            }
+
+void PcDependency::drain_pipeline() {
+    std::unique_lock<std::mutex> lock(_worker_pool_mutex);
+    _pipeline_cv.wait(lock, [&]{
+        return _pipeline_ready.empty() && _job_slot == nullptr;
+    });
+}
+
+
+bool PcDependency::next_task(pipeline_batch& job, uint64_t worker_idx, uint32_t& task) {
+    auto& own_queue = job.worker_tasks[worker_idx];
+    if (own_queue.pop(task)) {
+        return true;
+    }
+    // Steal the last CTA of the first queue with work left.
+    for (uint64_t step = 1; step < _worker_count; ++step) {
+        if (job.worker_tasks[(worker_idx + step) % _worker_count].steal(task)) {
+            own_queue.stolen_tasks += 1;
+            return true;
         }
     }
+    return false;
+}
 
-    for (auto& local_map : _job_worker_pc_statistics) {
-        for (auto& kv : local_map) {
-            auto& global_stats = this->_pc_statistics[kv.first];
-            for (int d = 0; d < 5; ++d) {
-                global_stats.dist[d] += kv.second.dist[d];
-            }
+
+void PcDependency::build_cta_tasks(pipeline_batch& job) {
+    const AccessBatch_t& batch = job.batch;
+    const uint64_t size = batch.size;
+    job.tasks.clear();
+    job.task_traces.resize(size);
+    for (auto& queue : job.worker_tasks) {
+        queue.tasks.clear();
+    }
+    job.max_cta_id = 0;
+
+    if (_worker_count == 1) {
+        // Nothing to steal from: one task keeps the batch order.
+        for (uint64_t i = 0; i < size; ++i) {
+            job.task_traces[i] = i;
+            job.max_cta_id = std::max<uint64_t>(job.max_cta_id, batch.accesses[i].ctaId);
+        }
+        job.tasks.push_back({0, 0, size});
+        job.worker_tasks[0].tasks.push_back(0);
+        job.worker_tasks[0].reset(1);
+        return;
+    }
+
+    // Count the records of each CTA, tasks numbered by first appearance.
+    constexpr uint32_t k_no_task = 0xFFFFFFFFu;
+    for (uint64_t i = 0; i < size; ++i) {
+        const uint64_t cta_id = batch.accesses[i].ctaId;
+        if (cta_id >= _job_cta_task.size()) {
+            _job_cta_task.resize(cta_id + 1, k_no_task);
+        }
+        uint32_t& task_idx = _job_cta_task[cta_id];
+        if (task_idx == k_no_task) {
+            task_idx = static_cast<uint32_t>(job.tasks.size());
+            job.tasks.push_back({cta_id, 0, 0});
+            job.max_cta_id = std::max(job.max_cta_id, cta_id);
         }
+        job.tasks[task_idx].end += 1;
+    }
+    uint64_t offset = 0;
+    for (auto& task : job.tasks) {
+        task.begin = offset;
+        offset += task.end;
+        task.end = task.begin;
+    }
+    for (uint64_t i = 0; i < size; ++i) {
+        CtaTask_t& task = job.tasks[_job_cta_task[batch.accesses[i].ctaId]];
+        job.task_traces[task.end++] = i;
     }
 
+    // Seed the queues with the static ctaId % workers split, so balanced
+    // grids keep their CTAs on the same worker and only stragglers move.
+    for (uint32_t task_idx = 0; task_idx < job.tasks.size(); ++task_idx) {
+        const uint64_t cta_id = job.tasks[task_idx].cta_id;
+        _job_cta_task[cta_id] = k_no_task;
+        job.worker_tasks[cta_id % _worker_count].tasks.push_back(task_idx);
+    }
+    for (auto& queue : job.worker_tasks) {
+        queue.reset(static_cast<uint32_t>(queue.tasks.size()));
+    }
 }
 
 
-void PcDependency::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        default:
-            break;
+void PcDependency::gpu_trace_analysis(const AccessBatch_t& batch) {
+    const uint64_t size = batch.size;
+    printf("[PC_DEPENDENCY] GPU data analysis called with size = %lu\n", size);
+    if (size == 0) {
+        return;
+    }
+    start_worker_pool();
+
+    pipeline_batch* job = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(_worker_pool_mutex);
+        _pipeline_cv.wait(lock, [&]{
+            return !_pipeline_free.empty();
+        });
+        job = _pipeline_free.front();
+        _pipeline_free.pop_front();
+    }
+
+    // The caller reuses its buffer once we return.
+    job->accesses.assign(batch.accesses, batch.accesses + size);
+    job->decoded.assign(batch.decoded, batch.decoded + size);
+    job->batch = AccessBatch_t();
+    job->batch.accesses = job->accesses.data();
+    job->batch.decoded = job->decoded.data();
+    job->batch.size = size;
+    job->first_record = _kernel_records;
+    _kernel_records += size;
+    build_cta_tasks(*job);
+
+    std::lock_guard<std::mutex> guard(_worker_pool_mutex);
+    _pipeline_ready.push_back(job);
+    if (_job_slot == nullptr) {
+        start_next_batch();
     }
 }
 
 
+void PcDependency::merge(Tool& shard) {
+    // Device shards write to their own directories; only the aggregates
+    // are still pending.
+    static_cast<PcDependency&>(shard).flush();
+}
+
+
 void PcDependency::flush() {
+    for (auto& kv : _kernel_aggregates) {
+        if (kv.second.written_launches != kv.second.graph.kernel.launch_count) {
+            write_kernel_aggregate(kv.second);
+        }
+    }
 }
@@ -5,64 +5,43 @@
 using namespace yosemite;
 
 
-void RooflineTime::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
-void RooflineTime::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+void RooflineTime::kernel_start_callback(const EventRecord_t& record) {
     start_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
 
 }
 
-void RooflineTime::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
+void RooflineTime::kernel_end_callback(const EventRecord_t& record) {
+    auto kernel = make_event<KernelEnd_t>(record);
     double end_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
     kernel_time_map.try_emplace(kernel, end_time - start_time);
 }
 
-void RooflineTime::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
-    cur_mem_usage += mem->size;
+void RooflineTime::mem_alloc_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_alloc;
+    cur_mem_usage += mem.size;
     if (cur_mem_usage > max_mem_usage) {
         max_mem_usage = cur_mem_usage;
     }
 }
 
-void RooflineTime::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
-    cur_mem_usage -= mem->size;
+void RooflineTime::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
+    cur_mem_usage -= mem.size;
     
 }
 
-void RooflineTime::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
-    cur_ten_usage += ten->size;
+void RooflineTime::ten_alloc_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_alloc;
+    cur_ten_usage += ten.size;
     if (cur_ten_usage > max_ten_usage) {
         max_ten_usage = cur_ten_usage;
     }
 }
 
-void RooflineTime::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
+void RooflineTime::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
     // tensor free size is negative
-    cur_ten_usage += ten->size;
+    cur_ten_usage += ten.size;
 }
 void RooflineTime::gpu_data_analysis(void* data, uint64_t size) {
 
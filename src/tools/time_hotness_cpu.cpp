@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <cassert>
 #include <fstream>
+#include <iterator>
 #include <string>
 #include <iostream>
 #include <unistd.h>
@@ -32,7 +33,8 @@ inline std::string vector2str(std::vector<std::string> &vec, int skip_first = 0,
 }
 
 
-TimeHotnessCPU::TimeHotnessCPU() : Tool(TIME_HOTNESS_CPU) {
+TimeHotnessCPU::TimeHotnessCPU() : Tool(TIME_HOTNESS_CPU, k_event_mask) {
+    _device_shards = true;
     init();
 
 }
@@ -41,6 +43,29 @@ TimeHotnessCPU::TimeHotnessCPU() : Tool(TIME_HOTNESS_CPU) {
 TimeHotnessCPU::~TimeHotnessCPU() {
 }
 
+
+std::shared_ptr<Tool> TimeHotnessCPU::make_shard(int device_id, uint32_t device_count) {
+    return std::make_shared<TimeHotnessCPU>();
+}
+
+
+// Snapshots of all devices end up in one report, device after device.
+void TimeHotnessCPU::merge(Tool& shard) {
+    auto& other = static_cast<TimeHotnessCPU&>(shard);
+    _memories.insert(other._memories.begin(), other._memories.end());
+    mem_stats.max_size = std::max(mem_stats.max_size, other.mem_stats.max_size);
+    mem_stats.alloc_count += other.mem_stats.alloc_count;
+    mem_stats.alloc_size += other.mem_stats.alloc_size;
+    mem_stats.free_count += other.mem_stats.free_count;
+    mem_stats.free_size += other.mem_stats.free_size;
+    time_series_heatmap_list.insert(time_series_heatmap_list.end(),
+                                    std::make_move_iterator(other.time_series_heatmap_list.begin()),
+                                    std::make_move_iterator(other.time_series_heatmap_list.end()));
+    other._memories.clear();
+    other.mem_stats = MemStats();
+    other.time_series_heatmap_list.clear();
+}
+
 void TimeHotnessCPU::init() {
     const char* env_name = std::getenv("ACCEL_PROF_HOME");
     std::string lib_path;
@@ -57,49 +82,6 @@ void TimeHotnessCPU::init() {
 }
 
 
-void TimeHotnessCPU::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_MEM_COPY:
-            mem_cpy_callback(std::dynamic_pointer_cast<MemCpy_t>(evt));
-            break;
-        case EventType_MEM_SET:
-            mem_set_callback(std::dynamic_pointer_cast<MemSet_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        case EventType_OP_START:
-            op_start_callback(std::dynamic_pointer_cast<OpStart_t>(evt));
-            break;
-        case EventType_OP_END:
-            op_end_callback(std::dynamic_pointer_cast<OpEnd_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
-void TimeHotnessCPU::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
-
-}
-
-
 std::shared_ptr<MemAlloc_t> TimeHotnessCPU::query_memory_ranges_cpu(uint64_t ptr) {
 
     return nullptr;
@@ -112,12 +94,8 @@ std::shared_ptr<TenAlloc_t> TimeHotnessCPU::query_tensor_ranges_cpu(uint64_t ptr
 }
 
 
-void TimeHotnessCPU::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
-
-}
-
-
-void TimeHotnessCPU::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
+void TimeHotnessCPU::mem_alloc_callback(const EventRecord_t& record) {
+    auto mem = make_event<MemAlloc_t>(record);
     mem_stats.alloc_count++;
     mem_stats.alloc_size += mem->size;
     mem_stats.max_size = std::max(mem_stats.max_size, mem_stats.alloc_size);
@@ -135,45 +113,16 @@ void TimeHotnessCPU::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
 }
 
 
-void TimeHotnessCPU::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
+void TimeHotnessCPU::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
     mem_stats.free_count++;
-    mem_stats.free_size += mem->size;
-    mem_stats.alloc_size -= mem->size;
-
-
-}
+    mem_stats.free_size += mem.size;
+    mem_stats.alloc_size -= mem.size;
 
 
-
-void TimeHotnessCPU::mem_cpy_callback(std::shared_ptr<MemCpy_t> mem) {
-
-}
-
-
-void TimeHotnessCPU::mem_set_callback(std::shared_ptr<MemSet_t> mem) {
-
 }
 
 
-void TimeHotnessCPU::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
-
-}
-
-
-void TimeHotnessCPU::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
-
-}
-
-
-void TimeHotnessCPU::op_start_callback(std::shared_ptr<OpStart_t> op) {
-
-}
-
-
-void TimeHotnessCPU::op_end_callback(std::shared_ptr<OpEnd_t> op) {
-
-}
-
 void TimeHotnessCPU::gpu_data_analysis(void* data, uint64_t size) {
     MemoryAccess* accesses_buffer = (MemoryAccess*)data;
 
@@ -30,7 +30,7 @@ inline std::string vector2str(std::vector<std::string> &vec, int skip_first = 0,
 }
 
 
-UVMAdvisor::UVMAdvisor() : Tool(UVM_ADVISOR) {
+UVMAdvisor::UVMAdvisor() : Tool(UVM_ADVISOR, k_event_mask) {
     init();
 }
 
@@ -49,45 +49,8 @@ void UVMAdvisor::init() {
 }
 
 
-void UVMAdvisor::evt_callback(EventPtr_t evt) {
-    switch (evt->evt_type) {
-        case EventType_KERNEL_LAUNCH:
-            kernel_start_callback(std::dynamic_pointer_cast<KernelLaunch_t>(evt));
-            break;
-        case EventType_KERNEL_END:
-            kernel_end_callback(std::dynamic_pointer_cast<KernelEnd_t>(evt));
-            break;
-        case EventType_MEM_ALLOC:
-            mem_alloc_callback(std::dynamic_pointer_cast<MemAlloc_t>(evt));
-            break;
-        case EventType_MEM_FREE:
-            mem_free_callback(std::dynamic_pointer_cast<MemFree_t>(evt));
-            break;
-        case EventType_MEM_COPY:
-            mem_cpy_callback(std::dynamic_pointer_cast<MemCpy_t>(evt));
-            break;
-        case EventType_MEM_SET:
-            mem_set_callback(std::dynamic_pointer_cast<MemSet_t>(evt));
-            break;
-        case EventType_TEN_ALLOC:
-            ten_alloc_callback(std::dynamic_pointer_cast<TenAlloc_t>(evt));
-            break;
-        case EventType_TEN_FREE:
-            ten_free_callback(std::dynamic_pointer_cast<TenFree_t>(evt));
-            break;
-        case EventType_OP_START:
-            op_start_callback(std::dynamic_pointer_cast<OpStart_t>(evt));
-            break;
-        case EventType_OP_END:
-            op_end_callback(std::dynamic_pointer_cast<OpEnd_t>(evt));
-            break;
-        default:
-            break;
-    }
-}
-
-
-void UVMAdvisor::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
+void UVMAdvisor::kernel_start_callback(const EventRecord_t& record) {
+    auto kernel = make_event<KernelLaunch_t>(record);
     opt_keys.kernel_id ++;
     kernel->key = opt_keys.kernel_id;
     kernel->timestamp = _timer.get();
@@ -97,18 +60,20 @@ void UVMAdvisor::kernel_start_callback(std::shared_ptr<KernelLaunch_t> kernel) {
 }
 
 
-void UVMAdvisor::kernel_end_callback(std::shared_ptr<KernelEnd_t> kernel) {
+void UVMAdvisor::kernel_end_callback(const EventRecord_t& record) {
     _timer.increment(true);
 }
 
 
-void UVMAdvisor::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
-    mem_stats.current_mem_size += mem->size;
+void UVMAdvisor::mem_alloc_callback(const EventRecord_t& record) {
+    mem_stats.current_mem_size += record.mem_alloc.size;
     mem_stats.max_mem_size = std::max(mem_stats.max_mem_size, mem_stats.current_mem_size);
-    if (mem->alloc_type != SANITIZER_UVM_MEMORY_FLAG) {
+    if (record.mem_alloc.alloc_type != SANITIZER_UVM_MEMORY_FLAG) {
         return;
     }
 
+    // only UVM allocations are kept around
+    auto mem = make_event<MemAlloc_t>(record);
     opt_keys.mem_id ++;
     mem->key = opt_keys.mem_id;
     mem->timestamp = _timer.get();
@@ -117,6 +82,7 @@ void UVMAdvisor::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
     mem_stats.alloc_size += mem->size;
     alloc_events.emplace(_timer.get(), mem);
     active_memories.emplace(mem->addr, mem);
+    uvm_index.insert(mem->addr, mem->size);
 
     mem_alloc_during_this_op.insert(mem->addr);
 
@@ -124,56 +90,44 @@ void UVMAdvisor::mem_alloc_callback(std::shared_ptr<MemAlloc_t> mem) {
 }
 
 
-void UVMAdvisor::mem_free_callback(std::shared_ptr<MemFree_t> mem) {
-    mem_stats.current_mem_size -= mem->size;
-    if (mem->alloc_type != SANITIZER_UVM_MEMORY_FLAG) {
+void UVMAdvisor::mem_free_callback(const EventRecord_t& record) {
+    const auto& mem = record.mem_free;
+    mem_stats.current_mem_size -= mem.size;
+    if (mem.alloc_type != SANITIZER_UVM_MEMORY_FLAG) {
         return;
     }
 
     mem_stats.free_count++;
-    mem_stats.free_size += mem->size;
+    mem_stats.free_size += mem.size;
 
-    auto it = active_memories.find(mem->addr);
+    auto it = active_memories.find(mem.addr);
     assert(it != active_memories.end());
     active_memories.erase(it);
+    uvm_index.erase(mem.addr);
 
     _timer.increment(true);
 }
 
 
-
-void UVMAdvisor::mem_cpy_callback(std::shared_ptr<MemCpy_t> mem) {
-    _timer.increment(true);
-}
-
-
-void UVMAdvisor::mem_set_callback(std::shared_ptr<MemSet_t> mem) {
-    _timer.increment(true);
-}
-
 bool UVMAdvisor::find_uvm_tensor(uint64_t ptr) {
-    for (auto mem : active_memories) {
-        if (ptr >= mem.first && ptr < mem.first + mem.second->size) {
-            return true;
-        }
-    }
-    return false;
+    return uvm_index.find(ptr) != k_no_interval;
 }
 
 
-void UVMAdvisor::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
-    ten_stats.current_ten_size += ten->size;
+void UVMAdvisor::ten_alloc_callback(const EventRecord_t& record) {
+    ten_stats.current_ten_size += record.ten_alloc.size;
     ten_stats.max_ten_size = std::max(ten_stats.max_ten_size, ten_stats.current_ten_size);
-    if (ten->size <= LARGE_TENSOR_THRESHOLD) {
+    if (record.ten_alloc.size <= LARGE_TENSOR_THRESHOLD) {
         return;
     }
     opt_keys.ten_id ++;
 
-    if (!find_uvm_tensor(ten->addr)) {
+    if (!find_uvm_tensor(record.ten_alloc.addr)) {
         return;
     }
 
-    
+    // only large UVM tensors are kept around
+    auto ten = make_event<TenAlloc_t>(record);
     ten->key = opt_keys.ten_id;
     op_stats.pending_ten_alloc++;
     ten_stats.alloc_count++;
@@ -189,20 +143,21 @@ void UVMAdvisor::ten_alloc_callback(std::shared_ptr<TenAlloc_t> ten) {
 }
 
 
-void UVMAdvisor::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
-    ten_stats.current_ten_size -= -ten->size;
-    if (-ten->size <= LARGE_TENSOR_THRESHOLD) {
+void UVMAdvisor::ten_free_callback(const EventRecord_t& record) {
+    const auto& ten = record.ten_free;
+    ten_stats.current_ten_size -= -ten.size;
+    if (-ten.size <= LARGE_TENSOR_THRESHOLD) {
         return;
     }
 
-    if (active_tensors.find(ten->addr) == active_tensors.end()) {
+    if (active_tensors.find(ten.addr) == active_tensors.end()) {
         return;
     }
 
     ten_stats.free_count++;
-    ten_stats.free_size += -ten->size;
+    ten_stats.free_size += -ten.size;
 
-    auto it = active_tensors.find(ten->addr);
+    auto it = active_tensors.find(ten.addr);
     assert(it != active_tensors.end());
     active_tensors.erase(it);
 
@@ -210,7 +165,8 @@ void UVMAdvisor::ten_free_callback(std::shared_ptr<TenFree_t> ten) {
 }
 
 
-void UVMAdvisor::op_start_callback(std::shared_ptr<OpStart_t> op) {
+void UVMAdvisor::op_start_callback(const EventRecord_t& record) {
+    auto op = make_event<OpStart_t>(record);
     opt_keys.op_id ++;
     op->key = opt_keys.op_id;
     op->timestamp = _timer.get();
@@ -222,7 +178,7 @@ void UVMAdvisor::op_start_callback(std::shared_ptr<OpStart_t> op) {
 }
 
 
-void UVMAdvisor::op_end_callback(std::shared_ptr<OpEnd_t> op) {
+void UVMAdvisor::op_end_callback(const EventRecord_t& record) {
     auto op_start = op_stack.top();
     op_stack.pop();
     if (op_stack.empty()) {
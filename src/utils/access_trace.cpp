@@ -0,0 +1,32 @@
+#include "utils/access_trace.h"
+
+namespace yosemite {
+
+
+const AccessBatch_t& AccessTraceDecoder::decode(const MemoryAccess* accesses, uint64_t size) {
+    _decoded.resize(size);
+    for (uint64_t i = 0; i < size; i++) {
+        const MemoryAccess& access = accesses[i];
+        DecodedAccess_t& decoded = _decoded[i];
+        const uint32_t active_mask = access.active_mask;
+        decoded.active_lanes = __builtin_popcount(active_mask);
+        decoded.repeat_lanes = __builtin_popcount(active_mask & ~access.unique_address_mask);
+        decoded.kind = DecodedKind_ACCESS;
+        if (_typed && access.type != MemoryType::Global) {
+            if (access.type == MemoryType::BlockExit) {
+                decoded.kind = DecodedKind_BLOCK_EXIT;
+            } else if (access.type == MemoryType::Shared) {
+                decoded.kind = DecodedKind_SHARED;
+            } else if (access.type == MemoryType::Local) {
+                decoded.kind = DecodedKind_LOCAL;
+            }
+        }
+    }
+
+    _batch.accesses = accesses;
+    _batch.size = size;
+    _batch.decoded = _decoded.data();
+    return _batch;
+}
+
+}   // yosemite
@@ -0,0 +1,718 @@
+#include "utils/dependency_graph.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+namespace yosemite {
+
+static const char k_graph_magic[8] = {'Y', 'S', 'M', 'D', 'E', 'P', 'G', '\0'};
+
+static const char* k_dist_names[DependencyDistCount] = {
+    "intra_thread", "intra_instance_launch", "intra_warp", "intra_block", "intra_grid", "evicted", "local",
+};
+
+
+const char* dependency_dist_name(uint32_t dist) {
+    return dist < DependencyDistCount ? k_dist_names[dist] : "unknown";
+}
+
+
+static inline uint64_t zigzag_encode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+
+static inline int64_t zigzag_decode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+
+/****************************************************************************************
+ ************************************ binary writer *************************************
+****************************************************************************************/
+
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+
+static void put_string(std::vector<uint8_t>& out, const std::string& value) {
+    put_varint(out, value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+
+bool write_dependency_graph(const std::string& path, const DependencyGraph_t& graph) {
+    std::vector<uint8_t> out;
+    out.reserve(64 + graph.nodes.size() * 16 + graph.edges.size() * 12);
+    out.insert(out.end(), k_graph_magic, k_graph_magic + sizeof(k_graph_magic));
+    for (int shift = 0; shift < 32; shift += 8) {
+        out.push_back(static_cast<uint8_t>(k_dependency_graph_version >> shift));
+    }
+
+    const DependencyGraphKernel_t& kernel = graph.kernel;
+    put_varint(out, kernel.kernel_id);
+    put_string(out, kernel.kernel_name);
+    put_varint(out, zigzag_encode(kernel.device_id));
+    put_varint(out, kernel.kernel_pc);
+    for (uint32_t dim : kernel.grid_dim) {
+        put_varint(out, dim);
+    }
+    put_varint(out, kernel.grid_cta_count);
+    for (uint32_t dim : kernel.block_dim) {
+        put_varint(out, dim);
+    }
+    put_varint(out, kernel.block_thread_count);
+    put_varint(out, kernel.shadow_granularity);
+    put_varint(out, kernel.sample_stride);
+    put_varint(out, kernel.shadow_budget_bytes);
+    put_varint(out, kernel.shadow_evicted_chunks);
+    put_varint(out, kernel.shadow_lossy_evicted_chunks);
+    put_varint(out, kernel.launch_count);
+    put_varint(out, kernel.reuse_times ? 1 : 0);
+
+    put_varint(out, graph.nodes.size());
+    uint32_t last_pc = 0;
+    for (const auto& node : graph.nodes) {
+        put_varint(out, node.pc - last_pc);
+        last_pc = node.pc;
+        out.push_back(node.has_info ? 1 : 0);
+        if (!node.has_info) {
+            continue;
+        }
+        put_varint(out, node.flags);
+        put_varint(out, node.access_size);
+        for (uint32_t kind = 0; kind < DependencyHistogramCount; ++kind) {
+            const auto& histogram = node.histograms[kind];
+            const uint32_t bins = k_dependency_histogram_bins[kind];
+            put_varint(out, bins - std::count(histogram.begin(), histogram.begin() + bins, 0));
+            for (uint32_t bin = 0; bin < bins; ++bin) {
+                if (histogram[bin] != 0) {
+                    put_varint(out, bin);
+                    put_varint(out, histogram[bin]);
+                }
+            }
+        }
+    }
+
+    put_varint(out, DependencyDistCount);
+    put_varint(out, graph.edges.size());
+    last_pc = 0;
+    for (const auto& edge : graph.edges) {
+        put_varint(out, edge.current_pc - last_pc);
+        last_pc = edge.current_pc;
+        put_varint(out, edge.ancient_pc);
+        for (uint64_t count : edge.dist) {
+            put_varint(out, count);
+        }
+        if (kernel.reuse_times) {
+            put_varint(out, k_dependency_reuse_bins - std::count(edge.reuse_time.begin(), edge.reuse_time.end(), 0));
+            for (uint32_t bin = 0; bin < k_dependency_reuse_bins; ++bin) {
+                if (edge.reuse_time[bin] != 0) {
+                    put_varint(out, bin);
+                    put_varint(out, edge.reuse_time[bin]);
+                }
+            }
+        }
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        fprintf(stderr, "[SANALYZER ERROR] Cannot open dependency graph file %s.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    const bool written = fwrite(out.data(), 1, out.size(), file) == out.size();
+    return fclose(file) == 0 && written;
+}
+
+
+/****************************************************************************************
+ ************************************ binary reader *************************************
+****************************************************************************************/
+
+
+namespace {
+
+class GraphInput {
+public:
+    explicit GraphInput(const std::vector<uint8_t>& data) : _data(data) {}
+
+    bool bytes(void* dst, size_t count) {
+        if (_data.size() - _pos < count) {
+            return false;
+        }
+        memcpy(dst, _data.data() + _pos, count);
+        _pos += count;
+        return true;
+    }
+
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && _pos < _data.size(); shift += 7) {
+            const uint8_t byte = _data[_pos++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool varint_as(T& value) {
+        uint64_t raw = 0;
+        if (!varint(raw)) {
+            return false;
+        }
+        value = static_cast<T>(raw);
+        return true;
+    }
+
+    bool string(std::string& value) {
+        uint64_t size = 0;
+        if (!varint(size) || _data.size() - _pos < size) {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(_data.data()) + _pos, size);
+        _pos += size;
+        return true;
+    }
+
+    size_t remaining() const { return _data.size() - _pos; }
+
+private:
+    const std::vector<uint8_t>& _data;
+    size_t _pos = 0;
+};
+
+}   // namespace
+
+
+static bool read_graph_body(GraphInput& in, uint32_t version, DependencyGraph_t& graph) {
+    DependencyGraphKernel_t& kernel = graph.kernel;
+    uint64_t device_id = 0;
+    if (!in.varint(kernel.kernel_id) || !in.string(kernel.kernel_name) || !in.varint(device_id)
+        || !in.varint(kernel.kernel_pc)) {
+        return false;
+    }
+    kernel.device_id = static_cast<int32_t>(zigzag_decode(device_id));
+    for (uint32_t& dim : kernel.grid_dim) {
+        if (!in.varint_as(dim)) {
+            return false;
+        }
+    }
+    if (!in.varint(kernel.grid_cta_count)) {
+        return false;
+    }
+    for (uint32_t& dim : kernel.block_dim) {
+        if (!in.varint_as(dim)) {
+            return false;
+        }
+    }
+    if (!in.varint_as(kernel.block_thread_count) || !in.varint_as(kernel.shadow_granularity)
+        || !in.varint_as(kernel.sample_stride) || !in.varint(kernel.shadow_budget_bytes)
+        || !in.varint(kernel.shadow_evicted_chunks) || !in.varint(kernel.shadow_lossy_evicted_chunks)) {
+        return false;
+    }
+    kernel.launch_count = 1;
+    if (version >= 2 && !in.varint(kernel.launch_count)) {
+        return false;
+    }
+    uint64_t reuse_times = 0;
+    if (version >= 3 && !in.varint(reuse_times)) {
+        return false;
+    }
+    kernel.reuse_times = reuse_times != 0;
+
+    // Nodes and edges take at least two bytes each, so a count the rest of
+    // the file cannot hold is corrupt; checking it first keeps a bad count
+    // from allocating gigabytes.
+    uint64_t count = 0;
+    if (!in.varint(count) || count > in.remaining() / 2) {
+        return false;
+    }
+    graph.nodes.assign(count, DependencyGraphNode_t());
+    uint32_t last_pc = 0;
+    for (auto& node : graph.nodes) {
+        uint32_t delta = 0;
+        uint8_t has_info = 0;
+        if (!in.varint_as(delta) || !in.bytes(&has_info, 1)) {
+            return false;
+        }
+        node.pc = last_pc + delta;
+        last_pc = node.pc;
+        node.has_info = has_info != 0;
+        if (!node.has_info) {
+            continue;
+        }
+        if (!in.varint_as(node.flags) || !in.varint_as(node.access_size)) {
+            return false;
+        }
+        // Version 3 and older files have no bank conflict histograms.
+        const uint32_t histograms = version >= 4 ? DependencyHistogramCount : DependencyHistogram_BANK_CONFLICTS;
+        for (uint32_t kind = 0; kind < histograms; ++kind) {
+            uint64_t bins = 0;
+            if (!in.varint(bins)) {
+                return false;
+            }
+            for (uint64_t idx = 0; idx < bins; ++idx) {
+                uint32_t bin = 0;
+                uint64_t value = 0;
+                if (!in.varint_as(bin) || !in.varint(value) || bin >= k_dependency_histogram_bins[kind]) {
+                    return false;
+                }
+                node.histograms[kind][bin] = value;
+            }
+        }
+    }
+
+    uint64_t dist_count = 0;
+    if (!in.varint(dist_count) || !in.varint(count) || count > in.remaining() / 2) {
+        return false;
+    }
+    graph.edges.assign(count, DependencyGraphEdge_t());
+    last_pc = 0;
+    for (auto& edge : graph.edges) {
+        uint32_t delta = 0;
+        if (!in.varint_as(delta) || !in.varint_as(edge.ancient_pc)) {
+            return false;
+        }
+        edge.current_pc = last_pc + delta;
+        last_pc = edge.current_pc;
+        // Categories this reader does not know are skipped.
+        for (uint64_t dist = 0; dist < dist_count; ++dist) {
+            uint64_t value = 0;
+            if (!in.varint(value)) {
+                return false;
+            }
+            if (dist < DependencyDistCount) {
+                edge.dist[dist] = value;
+            }
+        }
+        if (!kernel.reuse_times) {
+            continue;
+        }
+        uint64_t bins = 0;
+        if (!in.varint(bins)) {
+            return false;
+        }
+        for (uint64_t idx = 0; idx < bins; ++idx) {
+            uint32_t bin = 0;
+            uint64_t value = 0;
+            if (!in.varint_as(bin) || !in.varint(value) || bin >= k_dependency_reuse_bins) {
+                return false;
+            }
+            edge.reuse_time[bin] = value;
+        }
+    }
+    return true;
+}
+
+
+bool read_dependency_graph(const std::string& path, DependencyGraph_t& graph) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        fprintf(stderr, "[SANALYZER ERROR] Cannot open dependency graph file %s.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[1 << 16];
+    size_t read = 0;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + read);
+    }
+    fclose(file);
+
+    GraphInput in(data);
+    char magic[sizeof(k_graph_magic)];
+    uint8_t version[4];
+    if (!in.bytes(magic, sizeof(magic)) || memcmp(magic, k_graph_magic, sizeof(magic)) != 0
+        || !in.bytes(version, sizeof(version))) {
+        fprintf(stderr, "[SANALYZER ERROR] %s is not a dependency graph file.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    const uint32_t file_version = version[0] | (version[1] << 8) | (version[2] << 16)
+                                | (static_cast<uint32_t>(version[3]) << 24);
+    if (file_version == 0 || file_version > k_dependency_graph_version) {
+        fprintf(stderr, "[SANALYZER ERROR] Dependency graph file %s has version %u, expected at most %u.\n",
+                path.c_str(), file_version, k_dependency_graph_version);
+        fflush(stderr);
+        return false;
+    }
+    if (!read_graph_body(in, file_version, graph)) {
+        fprintf(stderr, "[SANALYZER ERROR] Dependency graph file %s is truncated.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    return true;
+}
+
+
+/****************************************************************************************
+ ************************************* JSON writer **************************************
+****************************************************************************************/
+
+
+namespace {
+
+// Appends to a string and writes it out in large blocks.
+class JsonOutput {
+public:
+    explicit JsonOutput(FILE* file) : _file(file) {
+        _buffer.reserve(k_flush_size + 4096);
+    }
+
+    ~JsonOutput() { flush(); }
+
+    JsonOutput& operator<<(const char* value) {
+        _buffer += value;
+        return maybe_flush();
+    }
+
+    JsonOutput& operator<<(const std::string& value) {
+        _buffer += value;
+        return maybe_flush();
+    }
+
+    JsonOutput& operator<<(uint64_t value) { return number(value, 10); }
+
+    JsonOutput& operator<<(uint32_t value) { return number(value, 10); }
+
+    JsonOutput& operator<<(int32_t value) { return number(value, 10); }
+
+    JsonOutput& hex(uint32_t value) {
+        _buffer += "0x";
+        return number(value, 16);
+    }
+
+    bool flush() {
+        if (!_buffer.empty() && fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size()) {
+            _failed = true;
+        }
+        _buffer.clear();
+        return !_failed;
+    }
+
+private:
+    static constexpr size_t k_flush_size = 1 << 20;
+
+    template <typename T>
+    JsonOutput& number(T value, int base) {
+        char digits[24];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value, base);
+        _buffer.append(digits, result.ptr);
+        return *this;
+    }
+
+    JsonOutput& maybe_flush() {
+        if (_buffer.size() >= k_flush_size) {
+            flush();
+        }
+        return *this;
+    }
+
+    FILE* _file;
+    std::string _buffer;
+    bool _failed = false;
+};
+
+}   // namespace
+
+
+static std::string json_escape(const std::string& s) {
+    static const char* k_hex = "0123456789abcdef";
+    std::string out;
+    out.reserve(s.size() + 8);
+    for (char c : s) {
+        switch (c) {
+            case '\"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                // control chars
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out += "\\u00";
+                    out += k_hex[(c >> 4) & 0xF];
+                    out += k_hex[c & 0xF];
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+
+static std::string flags_to_string(uint32_t flags) {
+    std::string out;
+    if (flags & SANITIZER_MEMORY_DEVICE_FLAG_READ) out += "READ";
+    if (flags & SANITIZER_MEMORY_DEVICE_FLAG_WRITE) out += "WRITE";
+    if (flags & SANITIZER_MEMORY_DEVICE_FLAG_ATOMIC) out += "ATOMIC";
+    if (flags & SANITIZER_MEMORY_DEVICE_FLAG_PREFETCH) out += "PREFETCH";
+    out += " ";
+    if (flags & SANITIZER_MEMORY_GLOBAL) out += "GLOBAL";
+    if (flags & SANITIZER_MEMORY_SHARED) out += "SHARED";
+    if (flags & SANITIZER_MEMORY_LOCAL) out += "LOCAL";
+    return out;
+}
+
+
+static void write_histogram(JsonOutput& jout, const char* name, const std::array<uint64_t, 33>& histogram,
+                            uint32_t bins, uint32_t first) {
+    jout << ", \"" << name << "\": {";
+    for (uint32_t bin = 0; bin < bins; bin++) {
+        jout << "\"" << (bin + first) << "\": " << histogram[bin];
+        if (bin + 1 != bins) {
+            jout << ", ";
+        }
+    }
+    jout << "}";
+}
+
+
+bool write_dependency_graph_json(const std::string& path, const DependencyGraph_t& graph) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        fprintf(stderr, "[SANALYZER ERROR] Cannot open dependency graph file %s.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    bool written = false;
+    {
+        JsonOutput jout(file);
+        const DependencyGraphKernel_t& kernel = graph.kernel;
+        jout << "{\n";
+        jout << "  \"tool\": \"pc_dependency_analysis\",\n";
+        jout << "  \"kernel\": {\n";
+        jout << "    \"kernel_id\": " << kernel.kernel_id << ",\n";
+        jout << "    \"kernel_name\": \"" << json_escape(kernel.kernel_name) << "\",\n";
+        jout << "    \"device_id\": " << kernel.device_id << ",\n";
+        jout << "    \"kernel_pc\": " << kernel.kernel_pc << ",\n";
+        jout << "    \"kernel_pc_hex\": \"";
+        jout.hex(static_cast<uint32_t>(kernel.kernel_pc)) << "\",\n";
+        if (kernel.launch_count != 1) {
+            jout << "    \"launch_count\": " << kernel.launch_count << ",\n";
+        }
+        jout << "    \"grid_dim\": [" << kernel.grid_dim[0] << ", " << kernel.grid_dim[1] << ", " << kernel.grid_dim[2] << "],\n";
+        jout << "    \"grid_cta_count\": " << kernel.grid_cta_count << ",\n";
+        jout << "    \"block_dim\": [" << kernel.block_dim[0] << ", " << kernel.block_dim[1] << ", " << kernel.block_dim[2] << "],\n";
+        jout << "    \"block_thread_count\": " << kernel.block_thread_count << "\n";
+        jout << "  },\n";
+        jout << "  \"shadow_memory_granularity_bytes\": " << kernel.shadow_granularity << ",\n";
+        jout << "  \"sample_stride_bytes\": " << kernel.sample_stride << ",\n";
+        jout << "  \"shadow_budget_bytes\": " << kernel.shadow_budget_bytes << ",\n";
+        jout << "  \"shadow_evicted_chunks\": " << kernel.shadow_evicted_chunks << ",\n";
+        jout << "  \"shadow_lossy_evicted_chunks\": " << kernel.shadow_lossy_evicted_chunks << ",\n";
+
+        jout << "  \"nodes\": [\n";
+        bool first = true;
+        for (const auto& node : graph.nodes) {
+            if (!first) jout << ",\n";
+            first = false;
+            jout << "    {\"pc\": " << node.pc << ", \"pc_hex\": \"";
+            jout.hex(node.pc) << "\"";
+            if (node.has_info) {
+                jout << ", \"flags\": \"" << flags_to_string(node.flags) << "\""
+                     << ", \"flags_hex\": \"";
+                jout.hex(node.flags) << "\""
+                     << ", \"access_size\": " << node.access_size;
+                write_histogram(jout, "distinct_sector_count", node.histograms[DependencyHistogram_SECTORS], 32, 1);
+                write_histogram(jout, "active_lane_count", node.histograms[DependencyHistogram_LANES], 33, 0);
+                write_histogram(jout, "distinct_address_count", node.histograms[DependencyHistogram_ADDRESSES], 32, 1);
+                if (node.flags & SANITIZER_MEMORY_SHARED) {
+                    write_histogram(jout, "bank_conflict_degree", node.histograms[DependencyHistogram_BANK_CONFLICTS], 32, 1);
+                    jout << ", \"bank_conflict_replays\": " << dependency_bank_replays(node);
+                }
+            } else {
+                jout << ", \"flags\": null, \"flags_hex\": null, \"access_size\": null";
+                jout << ", \"distinct_sector_count\": null, \"active_lane_count\": null, \"distinct_address_count\": null";
+            }
+            jout << "}";
+        }
+        jout << "\n";
+        jout << "  ],\n";
+
+        // Edges: ancient_pc -> current_pc, with per-scope counts.
+        jout << "  \"edges\": [\n";
+        first = true;
+        auto node_it = graph.nodes.begin();
+        for (const auto& edge : graph.edges) {
+            if (!first) jout << ",\n";
+            first = false;
+            const bool cold_miss = (edge.ancient_pc == 0u);
+            // edges and nodes are both ordered by (current) pc
+            while (node_it != graph.nodes.end() && node_it->pc < edge.current_pc) {
+                ++node_it;
+            }
+            const bool has_cflags = node_it != graph.nodes.end() && node_it->pc == edge.current_pc
+                                    && node_it->has_info;
+
+            jout << "    {\"current_pc\": " << edge.current_pc << ", \"current_pc_hex\": \"";
+            jout.hex(edge.current_pc) << "\"" << ", \"ancient_pc\": ";
+            if (cold_miss) {
+                jout << "null, \"ancient_pc_hex\": null";
+            } else {
+                jout << edge.ancient_pc << ", \"ancient_pc_hex\": \"";
+                jout.hex(edge.ancient_pc) << "\"";
+            }
+            jout << ", \"cold_miss\": " << (cold_miss ? "true" : "false");
+            if (has_cflags) {
+                jout << ", \"current_flags\": " << node_it->flags << ", \"current_flags_hex\": \"";
+                jout.hex(node_it->flags) << "\"" << ", \"current_access_size\": " << node_it->access_size;
+            } else {
+                jout << ", \"current_flags\": null, \"current_flags_hex\": null";
+            }
+            jout << ", \"dist\": {";
+            for (uint32_t dist = 0; dist < DependencyDistCount; ++dist) {
+                jout << (dist ? ", \"" : "\"") << k_dist_names[dist] << "\": " << edge.dist[dist];
+            }
+            jout << "}";
+            if (kernel.reuse_times) {
+                // Sparse: bins without reuse are left out.
+                jout << ", \"reuse_time_log2\": {";
+                bool first_bin = true;
+                for (uint32_t bin = 0; bin < k_dependency_reuse_bins; ++bin) {
+                    if (edge.reuse_time[bin] != 0) {
+                        jout << (first_bin ? "\"" : ", \"") << bin << "\": " << edge.reuse_time[bin];
+                        first_bin = false;
+                    }
+                }
+                jout << "}";
+            }
+            jout << "}";
+        }
+        jout << "\n";
+        jout << "  ]\n";
+        jout << "}\n";
+        written = jout.flush();
+    }
+    return fclose(file) == 0 && written;
+}
+
+
+/****************************************************************************************
+ ************************************ aggregation ***************************************
+****************************************************************************************/
+
+
+void merge_dependency_graph(DependencyGraph_t& into, const DependencyGraph_t& graph) {
+    into.kernel.shadow_evicted_chunks += graph.kernel.shadow_evicted_chunks;
+    into.kernel.shadow_lossy_evicted_chunks += graph.kernel.shadow_lossy_evicted_chunks;
+    into.kernel.launch_count += graph.kernel.launch_count;
+    into.kernel.reuse_times = into.kernel.reuse_times || graph.kernel.reuse_times;
+
+    // Both sides are sorted: merge them in one pass.
+    std::vector<DependencyGraphNode_t> nodes;
+    nodes.reserve(std::max(into.nodes.size(), graph.nodes.size()));
+    auto a = into.nodes.begin();
+    auto b = graph.nodes.begin();
+    while (a != into.nodes.end() || b != graph.nodes.end()) {
+        if (b == graph.nodes.end() || (a != into.nodes.end() && a->pc < b->pc)) {
+            nodes.push_back(*a++);
+        } else if (a == into.nodes.end() || b->pc < a->pc) {
+            nodes.push_back(*b++);
+        } else {
+            DependencyGraphNode_t node = *a++;
+            if (b->has_info) {
+                node.has_info = true;
+                node.flags |= b->flags;
+                node.access_size = std::max(node.access_size, b->access_size);
+                for (uint32_t kind = 0; kind < DependencyHistogramCount; ++kind) {
+                    for (uint32_t bin = 0; bin < k_dependency_histogram_bins[kind]; ++bin) {
+                        node.histograms[kind][bin] += b->histograms[kind][bin];
+                    }
+                }
+            }
+            nodes.push_back(node);
+            ++b;
+        }
+    }
+    into.nodes.swap(nodes);
+
+    std::vector<DependencyGraphEdge_t> edges;
+    edges.reserve(std::max(into.edges.size(), graph.edges.size()));
+    auto less = [](const DependencyGraphEdge_t& x, const DependencyGraphEdge_t& y) {
+        if (x.current_pc != y.current_pc) return x.current_pc < y.current_pc;
+        return x.ancient_pc < y.ancient_pc;
+    };
+    auto c = into.edges.begin();
+    auto d = graph.edges.begin();
+    while (c != into.edges.end() || d != graph.edges.end()) {
+        if (d == graph.edges.end() || (c != into.edges.end() && less(*c, *d))) {
+            edges.push_back(*c++);
+        } else if (c == into.edges.end() || less(*d, *c)) {
+            edges.push_back(*d++);
+        } else {
+            DependencyGraphEdge_t edge = *c++;
+            for (uint32_t dist = 0; dist < DependencyDistCount; ++dist) {
+                edge.dist[dist] += d->dist[dist];
+            }
+            for (uint32_t bin = 0; bin < k_dependency_reuse_bins; ++bin) {
+                edge.reuse_time[bin] += d->reuse_time[bin];
+            }
+            edges.push_back(edge);
+            ++d;
+        }
+    }
+    into.edges.swap(edges);
+}
+
+
+static inline uint64_t edge_weight(const DependencyGraphEdge_t& edge) {
+    uint64_t weight = 0;
+    for (uint64_t count : edge.dist) {
+        weight += count;
+    }
+    return weight;
+}
+
+
+double dependency_graph_distance(const DependencyGraph_t& a, const DependencyGraph_t& b) {
+    double total_a = 0;
+    double total_b = 0;
+    for (const auto& edge : a.edges) {
+        total_a += edge_weight(edge);
+    }
+    for (const auto& edge : b.edges) {
+        total_b += edge_weight(edge);
+    }
+    if (total_a == 0 || total_b == 0) {
+        return total_a == total_b ? 0.0 : 1.0;
+    }
+
+    double distance = 0;
+    auto x = a.edges.begin();
+    auto y = b.edges.begin();
+    while (x != a.edges.end() || y != b.edges.end()) {
+        double pa = 0;
+        double pb = 0;
+        if (y == b.edges.end() || (x != a.edges.end()
+            && (x->current_pc < y->current_pc
+                || (x->current_pc == y->current_pc && x->ancient_pc < y->ancient_pc)))) {
+            pa = edge_weight(*x++) / total_a;
+        } else if (x == a.edges.end() || x->current_pc != y->current_pc || x->ancient_pc != y->ancient_pc) {
+            pb = edge_weight(*y++) / total_b;
+        } else {
+            pa = edge_weight(*x++) / total_a;
+            pb = edge_weight(*y++) / total_b;
+        }
+        distance += pa > pb ? pa - pb : pb - pa;
+    }
+    return distance / 2;
+}
+
+}   // yosemite
@@ -0,0 +1,207 @@
+#include "utils/event_pool.h"
+
+#include <cassert>
+#include <cstdio>
+
+namespace yosemite {
+
+
+EventNameTable& EventNameTable::instance() {
+    static EventNameTable table;
+    return table;
+}
+
+
+uint32_t EventNameTable::intern(const std::string& name) {
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto it = _ids.find(name);
+        if (it != _ids.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    auto it = _ids.find(name);
+    if (it != _ids.end()) {
+        return it->second;
+    }
+
+    const uint32_t id = _count.load(std::memory_order_relaxed);
+    const uint32_t chunk_idx = id >> k_chunk_bits;
+    if (chunk_idx >= k_max_chunks) {
+        fprintf(stderr, "[SANALYZER ERROR] Event name table is full.\n");
+        fflush(stderr);
+        return k_invalid_event_name;
+    }
+    std::string* chunk = _chunks[chunk_idx].load(std::memory_order_relaxed);
+    if (chunk == nullptr) {
+        chunk = new std::string[k_chunk_size];
+        _chunks[chunk_idx].store(chunk, std::memory_order_release);
+    }
+    chunk[id & (k_chunk_size - 1)] = name;
+    _ids.emplace(name, id);
+    _count.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+
+const std::string& EventNameTable::name(uint32_t id) const {
+    static const std::string empty;
+    if (id >= _count.load(std::memory_order_acquire)) {
+        return empty;
+    }
+    return _chunks[id >> k_chunk_bits].load(std::memory_order_acquire)[id & (k_chunk_size - 1)];
+}
+
+
+EventPool::EventPool() {
+    _free_head.store(pack_head(0, k_empty), std::memory_order_relaxed);
+    grow();
+}
+
+
+EventPool::~EventPool() {
+    const uint32_t slab_count = _slab_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < slab_count; i++) {
+        delete[] _slabs[i].load(std::memory_order_relaxed);
+    }
+}
+
+
+void EventPool::grow() {
+    std::lock_guard<std::mutex> guard(_grow_mutex);
+    // Another producer may have refilled the free list while we waited.
+    if (static_cast<uint32_t>(_free_head.load(std::memory_order_acquire)) != k_empty) {
+        return;
+    }
+    const uint32_t slab_idx = _slab_count.load(std::memory_order_relaxed);
+    assert(slab_idx < k_max_slabs);
+    Slot* slab = new Slot[k_slab_size];
+    _slabs[slab_idx].store(slab, std::memory_order_release);
+    _slab_count.store(slab_idx + 1, std::memory_order_release);
+    const uint32_t base = slab_idx << k_slab_bits;
+    for (uint32_t i = k_slab_size; i > 0; i--) {
+        push_free(base + i - 1);
+    }
+}
+
+
+void EventPool::push_free(uint32_t slot) {
+    Slot& s = slot_at(slot);
+    uint64_t head = _free_head.load(std::memory_order_relaxed);
+    while (true) {
+        s.next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        const uint64_t new_head = pack_head(static_cast<uint32_t>(head >> 32) + 1u, slot);
+        if (_free_head.compare_exchange_weak(head, new_head,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+
+bool EventPool::pop_free(uint32_t& slot) {
+    uint64_t head = _free_head.load(std::memory_order_acquire);
+    while (true) {
+        const uint32_t top = static_cast<uint32_t>(head);
+        if (top == k_empty) {
+            return false;
+        }
+        const uint32_t next = slot_at(top).next.load(std::memory_order_relaxed);
+        const uint64_t new_head = pack_head(static_cast<uint32_t>(head >> 32) + 1u, next);
+        if (_free_head.compare_exchange_weak(head, new_head,
+                                             std::memory_order_acquire,
+                                             std::memory_order_acquire)) {
+            slot = top;
+            return true;
+        }
+    }
+}
+
+
+uint32_t EventPool::acquire() {
+    uint32_t slot = 0;
+    while (!pop_free(slot)) {
+        grow();
+    }
+    slot_at(slot).refs.store(1, std::memory_order_relaxed);
+    _in_use.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+
+void EventPool::retain(uint32_t slot) {
+    slot_at(slot).refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void EventPool::release(uint32_t slot) {
+    if (slot_at(slot).refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        _in_use.fetch_sub(1, std::memory_order_relaxed);
+        push_free(slot);
+    }
+}
+
+
+EventPtr_t make_event(const EventRecord_t& record) {
+    EventPtr_t evt;
+    switch (record.evt_type) {
+        case EventType_KERNEL_LAUNCH: {
+            const auto& r = record.kernel_launch;
+            evt = std::make_shared<KernelLaunch_t>(event_name(r.name_id), record.device_id,
+                                                   r.grid_dim_x, r.grid_dim_y, r.grid_dim_z,
+                                                   r.block_dim_x, r.block_dim_y, r.block_dim_z,
+                                                   r.grid_cta_count, r.block_thread_count);
+            break;
+        }
+        case EventType_KERNEL_END:
+            evt = std::make_shared<KernelEnd_t>(event_name(record.kernel_end.name_id), record.device_id);
+            break;
+        case EventType_MEM_ALLOC: {
+            const auto& r = record.mem_alloc;
+            evt = std::make_shared<MemAlloc_t>(r.addr, r.size, r.alloc_type, record.device_id);
+            break;
+        }
+        case EventType_MEM_FREE: {
+            const auto& r = record.mem_free;
+            evt = std::make_shared<MemFree_t>(r.addr, r.size, r.alloc_type, record.device_id);
+            break;
+        }
+        case EventType_MEM_COPY: {
+            const auto& r = record.mem_cpy;
+            evt = std::make_shared<MemCpy_t>(r.src_addr, r.dst_addr, r.size, r.is_async, r.direction, record.device_id);
+            break;
+        }
+        case EventType_MEM_SET: {
+            const auto& r = record.mem_set;
+            evt = std::make_shared<MemSet_t>(r.addr, r.size, r.value, r.is_async, record.device_id);
+            break;
+        }
+        case EventType_TEN_ALLOC: {
+            const auto& r = record.ten_alloc;
+            evt = std::make_shared<TenAlloc_t>(r.addr, r.size, r.allocated_size, r.reserved_size, record.device_id);
+            break;
+        }
+        case EventType_TEN_FREE: {
+            const auto& r = record.ten_free;
+            evt = std::make_shared<TenFree_t>(r.addr, r.size, r.allocated_size, r.reserved_size, record.device_id);
+            break;
+        }
+        case EventType_OP_START:
+            evt = std::make_shared<OpStart_t>(event_name(record.op_start.name_id), record.op_start.ctx);
+            evt->device_id = record.device_id;
+            break;
+        case EventType_OP_END:
+            evt = std::make_shared<OpEnd_t>(event_name(record.op_end.name_id), record.op_end.ctx);
+            evt->device_id = record.device_id;
+            break;
+        default:
+            return nullptr;
+    }
+    evt->timestamp = record.timestamp;
+    return evt;
+}
+
+}   // yosemite
@@ -0,0 +1,287 @@
+#include "utils/event_queue.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace yosemite {
+
+
+const char* event_backpressure_name(EventBackpressure_t policy) {
+    switch (policy) {
+        case EventBackpressure_BLOCK:
+            return "block";
+        case EventBackpressure_DROP:
+            return "drop";
+        case EventBackpressure_SPILL:
+            return "spill";
+        default:
+            return "unknown";
+    }
+}
+
+
+static uint32_t round_up_pow2(uint32_t value) {
+    uint32_t result = 1;
+    while (result < value && result < (1u << 31)) {
+        result <<= 1;
+    }
+    return result;
+}
+
+
+EventQueue::EventQueue(uint32_t capacity, EventBackpressure_t policy)
+    : _capacity(round_up_pow2(capacity < 2 ? 2 : capacity)),
+      _mask(_capacity - 1),
+      _policy(policy),
+      _cells(new Cell[_capacity]) {
+    for (uint32_t i = 0; i < _capacity; i++) {
+        _cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+
+EventQueue::~EventQueue() {
+    stop();
+}
+
+
+void EventQueue::start(Handler_t handler) {
+    _handler = std::move(handler);
+    _stop.store(false, std::memory_order_release);
+    _stopped.store(false, std::memory_order_release);
+    _consumer = std::thread(&EventQueue::consumer_loop, this);
+}
+
+
+void EventQueue::stop() {
+    if (!_consumer.joinable()) {
+        return;
+    }
+    _stop.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> guard(_wake_mutex);
+        _wake_cv.notify_one();
+    }
+    _consumer.join();
+
+    // Producers that passed the _stopped check may still be enqueueing, and
+    // blocked ones need the ring emptied. Holding the dispatch lock keeps
+    // inline dispatches behind everything queued before them.
+    std::lock_guard<std::mutex> guard(_dispatch_mutex);
+    _stopped.store(true, std::memory_order_seq_cst);
+    while (true) {
+        const uint32_t count = dispatch_batch();
+        _dispatched.fetch_add(count, std::memory_order_relaxed);
+        if (count > 0) {
+            continue;
+        }
+        if (_producers.load(std::memory_order_seq_cst) == 0
+            && _tail.load(std::memory_order_acquire) == _read_pos
+            && _spill_pushed.load(std::memory_order_acquire) == _spill_popped.load(std::memory_order_acquire)) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+}
+
+
+// Bounded MPMC ring (D. Vyukov) used with a single consumer: each cell's
+// sequence number says whether it is free for ticket `pos` (seq == pos) or
+// holds the record for ticket `pos` (seq == pos + 1).
+bool EventQueue::try_enqueue(EventRecordRef& record) {
+    uint64_t pos = _tail.load(std::memory_order_relaxed);
+    while (true) {
+        Cell& cell = _cells[pos & _mask];
+        const uint64_t seq = cell.seq.load(std::memory_order_acquire);
+        const int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.record = std::move(record);
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = _tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+
+bool EventQueue::try_dequeue(EventRecordRef& record) {
+    const uint64_t pos = _read_pos;
+    Cell& cell = _cells[pos & _mask];
+    if (cell.seq.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    record = std::move(cell.record);
+    cell.seq.store(pos + _capacity, std::memory_order_release);
+    _read_pos = pos + 1;
+    return true;
+}
+
+
+void EventQueue::push_spill(EventRecordRef record) {
+    std::lock_guard<std::mutex> guard(_spill_mutex);
+    _spill.push_back(std::move(record));
+    // re-arm under the lock so a producer that raced with the consumer
+    // clearing the flag keeps its later records behind this one
+    _spilling.store(true, std::memory_order_release);
+    _spill_pushed.fetch_add(1, std::memory_order_release);
+    _spilled.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void EventQueue::wake_consumer() {
+    if (_consumer_sleeping.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> guard(_wake_mutex);
+        _wake_cv.notify_one();
+    }
+}
+
+
+void EventQueue::push(EventRecordRef record) {
+    _producers.fetch_add(1, std::memory_order_seq_cst);
+    if (!_stopped.load(std::memory_order_seq_cst)) {
+        enqueue(std::move(record));
+        _producers.fetch_sub(1, std::memory_order_seq_cst);
+        return;
+    }
+    _producers.fetch_sub(1, std::memory_order_seq_cst);
+    // consumer is gone (terminate already ran) and stop() dispatched what
+    // was queued, dispatch inline
+    std::lock_guard<std::mutex> guard(_dispatch_mutex);
+    _handler(*record);
+}
+
+
+void EventQueue::enqueue(EventRecordRef record) {
+    if (_policy == EventBackpressure_SPILL && _spilling.load(std::memory_order_acquire)) {
+        push_spill(std::move(record));
+        wake_consumer();
+        return;
+    }
+
+    if (try_enqueue(record)) {
+        wake_consumer();
+        return;
+    }
+
+    if (_policy == EventBackpressure_SPILL) {
+        push_spill(std::move(record));
+        wake_consumer();
+        return;
+    }
+
+    if (_policy == EventBackpressure_DROP
+        && (record->evt_type == EventType_MEM_COPY || record->evt_type == EventType_MEM_SET)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    _blocked.fetch_add(1, std::memory_order_relaxed);
+    uint32_t spins = 0;
+    while (!try_enqueue(record)) {
+        wake_consumer();
+        if (++spins < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    wake_consumer();
+}
+
+
+bool EventQueue::drained(uint64_t ring_target, uint64_t spill_target) const {
+    return _head.load(std::memory_order_acquire) >= ring_target
+        && _spill_popped.load(std::memory_order_acquire) >= spill_target;
+}
+
+
+std::unique_lock<std::mutex> EventQueue::drain() {
+    if (_consumer.joinable()) {
+        const uint64_t ring_target = _tail.load(std::memory_order_acquire);
+        const uint64_t spill_target = _spill_pushed.load(std::memory_order_acquire);
+        if (!drained(ring_target, spill_target)) {
+            _drain_waiters.fetch_add(1, std::memory_order_seq_cst);
+            wake_consumer();
+            std::unique_lock<std::mutex> lock(_wake_mutex);
+            while (!drained(ring_target, spill_target)) {
+                _wake_cv.notify_one();
+                _drain_cv.wait_for(lock, std::chrono::microseconds(100));
+            }
+            _drain_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    return std::unique_lock<std::mutex>(_dispatch_mutex);
+}
+
+
+// Called with _dispatch_mutex held, by the consumer and by stop().
+uint32_t EventQueue::dispatch_batch() {
+    uint32_t count = 0;
+    EventRecordRef record;
+    while (count < k_batch_size && try_dequeue(record)) {
+        _handler(*record);
+        record = EventRecordRef();
+        _head.store(_read_pos, std::memory_order_release);
+        count++;
+    }
+
+    // the ring is empty, so everything that was queued ahead of the
+    // spilled records has been dispatched
+    if (count == 0 && _spilling.load(std::memory_order_acquire)) {
+        std::deque<EventRecordRef> spill;
+        {
+            std::lock_guard<std::mutex> spill_guard(_spill_mutex);
+            if (_spill.empty()) {
+                _spilling.store(false, std::memory_order_release);
+            } else {
+                spill.swap(_spill);
+            }
+        }
+        for (auto& spilled : spill) {
+            _handler(*spilled);
+            _spill_popped.fetch_add(1, std::memory_order_release);
+            count++;
+        }
+    }
+    return count;
+}
+
+
+void EventQueue::consumer_loop() {
+    while (true) {
+        uint32_t count = 0;
+        {
+            std::lock_guard<std::mutex> guard(_dispatch_mutex);
+            count = dispatch_batch();
+        }
+        _dispatched.fetch_add(count, std::memory_order_relaxed);
+
+        if (count > 0) {
+            if (_drain_waiters.load(std::memory_order_seq_cst) > 0) {
+                std::lock_guard<std::mutex> guard(_wake_mutex);
+                _drain_cv.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_wake_mutex);
+        _drain_cv.notify_all();
+        const bool idle = _tail.load(std::memory_order_acquire) == _read_pos
+            && _spill_pushed.load(std::memory_order_acquire) == _spill_popped.load(std::memory_order_acquire);
+        if (idle && _stop.load(std::memory_order_acquire)) {
+            break;
+        }
+        _consumer_sleeping.store(true, std::memory_order_seq_cst);
+        if (idle) {
+            _wake_cv.wait_for(lock, std::chrono::milliseconds(1));
+        }
+        _consumer_sleeping.store(false, std::memory_order_seq_cst);
+    }
+}
+
+}   // yosemite
@@ -0,0 +1,188 @@
+#include "utils/gpu_ingest.h"
+#include "sanalyzer.h"
+
+namespace yosemite {
+
+
+GpuDataLayout_t gpu_data_layout(uint32_t patch_name) {
+    switch (patch_name) {
+        case GPU_PATCH_MEM_TRACE:
+        case GPU_PATCH_APP_ANALYSIS_CPU:
+        case GPU_PATCH_TIME_HOTNESS_CPU:
+        case GPU_PATCH_HEATMAP_ANALYSIS:
+        case GPU_PATCH_BLOCK_DIVERGENCE_ANALYSIS:
+        case GPU_PATCH_PC_DEPENDENCY_ANALYSIS:
+            return GpuDataLayout_ACCESSES;
+        case GPU_PATCH_APP_METRIC:
+        case GPU_PATCH_APP_ANALYSIS:
+        case GPU_PATCH_UVM_ADVISOR:
+        case GPU_PATCH_ROOFLINE_SIZE:
+            return GpuDataLayout_TRACKER;
+        case GPU_PATCH_HOT_ANALYSIS:
+            return GpuDataLayout_ACCESS_STATE;
+        case GPU_PATCH_APP_ANALYSIS_NVBIT:
+            return GpuDataLayout_NVBIT_ACCESS;
+        default:
+            return GpuDataLayout_NONE;
+    }
+}
+
+
+GpuDataIngest::GpuDataIngest(uint32_t max_in_flight, const std::string& spill_path, uint64_t record_bytes,
+                             Handler_t handler)
+    : _max_in_flight(max_in_flight == 0 ? 1 : max_in_flight),
+      _spill_path(spill_path),
+      _record_bytes(record_bytes),
+      _handler(std::move(handler)) {
+    _worker = std::thread(&GpuDataIngest::worker_loop, this);
+}
+
+
+GpuDataIngest::~GpuDataIngest() {
+    stop();
+}
+
+
+void GpuDataIngest::stop() {
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (_stop) {
+            return;
+        }
+        _stop = true;
+    }
+    _job_cv.notify_all();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+    if (_spill_file) {
+        fclose(_spill_file);
+        _spill_file = nullptr;
+        std::remove(_spill_path.c_str());
+    }
+}
+
+
+// Called with _mutex held. The file is only touched under the lock, the
+// worker copies spilled data out before releasing it.
+bool GpuDataIngest::spill(Job_t& job) {
+    if (_spill_path.empty() || _record_bytes == 0) {
+        return false;
+    }
+    if (!_spill_file) {
+        _spill_file = fopen(_spill_path.c_str(), "w+b");
+        if (!_spill_file) {
+            fprintf(stderr, "[SANALYZER ERROR] Cannot open GPU data spill file %s.\n", _spill_path.c_str());
+            fflush(stderr);
+            return false;
+        }
+    }
+    if (_spill_pending == 0) {
+        _spill_offset = 0;
+    }
+    const uint64_t bytes = job.size * _record_bytes;
+    if (fseek(_spill_file, static_cast<long>(_spill_offset), SEEK_SET) != 0
+        || fwrite(job.data, 1, bytes, _spill_file) != bytes) {
+        fprintf(stderr, "[SANALYZER ERROR] Failed to spill GPU data to %s.\n", _spill_path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    job.spilled = true;
+    job.file_offset = _spill_offset;
+    job.file_bytes = bytes;
+    job.data = nullptr;
+    _spill_offset += bytes;
+    _spill_pending++;
+    _spilled++;
+    _spilled_bytes += bytes;
+    return true;
+}
+
+
+uint64_t GpuDataIngest::submit(void* data, uint64_t size) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    Job_t job = {_next_token++, data, size, false, 0, 0};
+
+    if (_leased >= _max_in_flight && !spill(job)) {
+        _blocked++;
+        _done_cv.wait(lock, [this] { return _leased < _max_in_flight; });
+    }
+
+    if (job.spilled) {
+        _released_early.insert(job.token);
+    } else {
+        _leased++;
+    }
+    _jobs.push_back(job);
+    lock.unlock();
+    _job_cv.notify_one();
+    return job.token;
+}
+
+
+bool GpuDataIngest::poll(uint64_t token) {
+    if (token <= _processed.load(std::memory_order_acquire)) {
+        return true;
+    }
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _released_early.count(token) > 0;
+}
+
+
+void GpuDataIngest::wait(uint64_t token) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cv.wait(lock, [this, token] {
+        return token <= _processed.load(std::memory_order_acquire) || _released_early.count(token) > 0;
+    });
+}
+
+
+void GpuDataIngest::drain() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cv.wait(lock, [this] { return _jobs.empty() && !_busy; });
+}
+
+
+void GpuDataIngest::worker_loop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _job_cv.wait(lock, [this] { return _stop || !_jobs.empty(); });
+        if (_jobs.empty()) {
+            break;
+        }
+        Job_t job = _jobs.front();
+        _jobs.pop_front();
+        _busy = true;
+
+        void* data = job.data;
+        bool readable = true;
+        if (job.spilled) {
+            _spill_buffer.resize(job.file_bytes);
+            if (fseek(_spill_file, static_cast<long>(job.file_offset), SEEK_SET) != 0
+                || fread(_spill_buffer.data(), 1, job.file_bytes, _spill_file) != job.file_bytes) {
+                fprintf(stderr, "[SANALYZER ERROR] Failed to read back spilled GPU data, dropping %lu bytes.\n", job.file_bytes);
+                fflush(stderr);
+                readable = false;
+            }
+            data = _spill_buffer.data();
+            _spill_pending--;
+        }
+
+        lock.unlock();
+        if (readable) {
+            _handler(data, job.size);
+        }
+        lock.lock();
+
+        _busy = false;
+        if (job.spilled) {
+            _released_early.erase(job.token);
+        } else {
+            _leased--;
+        }
+        _processed.store(job.token, std::memory_order_release);
+        _done_cv.notify_all();
+    }
+}
+
+}   // yosemite
@@ -0,0 +1,82 @@
+#include "utils/interval_index.h"
+
+namespace yosemite {
+
+
+uint32_t IntervalIndex::insert(uint64_t start, uint64_t size) {
+    erase(start);
+    uint32_t id;
+    if (_free_ids.empty()) {
+        id = static_cast<uint32_t>(_ranges.size());
+        _ranges.emplace_back();
+    } else {
+        id = _free_ids.back();
+        _free_ids.pop_back();
+    }
+    _ranges[id] = {start, start + size};
+    _intervals.emplace(start, Interval_t{start + size, id});
+    return id;
+}
+
+
+uint32_t IntervalIndex::erase(uint64_t start) {
+    auto it = _intervals.find(start);
+    if (it == _intervals.end()) {
+        return k_no_interval;
+    }
+    const uint32_t id = it->second.id;
+    _intervals.erase(it);
+    _ranges[id] = {0, 0};
+    _free_ids.push_back(id);
+    return id;
+}
+
+
+uint32_t IntervalIndex::find(uint64_t addr) const {
+    auto it = _intervals.upper_bound(addr);
+    if (it == _intervals.begin()) {
+        return k_no_interval;
+    }
+    --it;
+    if (addr >= it->second.end) {
+        return k_no_interval;
+    }
+    return it->second.id;
+}
+
+
+uint32_t IntervalIndex::find_batch(const uint64_t* addrs, uint32_t count, uint32_t* ids) const {
+    uint32_t found = 0;
+    uint64_t hit_start = 0;
+    uint64_t hit_end = 0;
+    uint32_t hit_id = k_no_interval;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint64_t addr = addrs[i];
+        if (addr == 0) {
+            ids[i] = k_no_interval;
+            continue;
+        }
+        if (addr < hit_start || addr >= hit_end) {
+            const uint32_t id = find(addr);
+            if (id == k_no_interval) {
+                ids[i] = k_no_interval;
+                continue;
+            }
+            hit_id = id;
+            hit_start = _ranges[hit_id].start;
+            hit_end = _ranges[hit_id].end;
+        }
+        ids[i] = hit_id;
+        found++;
+    }
+    return found;
+}
+
+
+void IntervalIndex::clear() {
+    _intervals.clear();
+    _ranges.clear();
+    _free_ids.clear();
+}
+
+}   // yosemite
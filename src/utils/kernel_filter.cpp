@@ -0,0 +1,178 @@
+#include "utils/kernel_filter.h"
+
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace yosemite {
+
+
+static bool compile_regex(const char* env_name, std::regex& regex, std::string& text) {
+    const char* value = std::getenv(env_name);
+    if (!value || !*value) {
+        return false;
+    }
+    text = value;
+    regex = std::regex(text, std::regex::ECMAScript | std::regex::optimize);
+    return true;
+}
+
+
+// "500-600,1000-,42"
+static bool parse_windows(const std::string& spec, std::vector<KernelWindow_t>& windows) {
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = spec.size();
+        }
+        const std::string item = spec.substr(pos, comma - pos);
+        pos = comma + 1;
+        if (item.empty()) {
+            continue;
+        }
+        KernelWindow_t window;
+        const size_t dash = item.find('-');
+        char* end = nullptr;
+        window.first = std::strtoull(item.c_str(), &end, 10);
+        if (end == item.c_str()) {
+            return false;
+        }
+        if (dash == std::string::npos) {
+            window.last = window.first;
+        } else if (dash + 1 == item.size()) {
+            window.last = UINT64_MAX;
+        } else {
+            const char* last = item.c_str() + dash + 1;
+            window.last = std::strtoull(last, &end, 10);
+            if (end == last || window.last < window.first) {
+                return false;
+            }
+        }
+        windows.push_back(window);
+    }
+    std::sort(windows.begin(), windows.end(),
+              [](const KernelWindow_t& a, const KernelWindow_t& b) { return a.first < b.first; });
+    return true;
+}
+
+
+bool KernelFilter::configure() {
+    try {
+        _has_include = compile_regex("YOSEMITE_KERNEL_INCLUDE", _include, _include_text);
+        _has_exclude = compile_regex("YOSEMITE_KERNEL_EXCLUDE", _exclude, _exclude_text);
+    } catch (const std::regex_error& e) {
+        fprintf(stderr, "[SANALYZER ERROR] Invalid kernel filter regex: %s.\n", e.what());
+        fflush(stderr);
+        return false;
+    }
+
+    const char* windows = std::getenv("YOSEMITE_KERNEL_WINDOWS");
+    const char* max_kernels = std::getenv("MAX_NUM_KERNEL_MONITORED");
+    if (windows) {
+        if (!parse_windows(windows, _windows)) {
+            fprintf(stderr, "[SANALYZER ERROR] Invalid YOSEMITE_KERNEL_WINDOWS %s.\n", windows);
+            fflush(stderr);
+            return false;
+        }
+    } else if (max_kernels) {
+        const uint64_t count = std::strtoull(max_kernels, nullptr, 10);
+        if (count > 0) {
+            _windows.push_back({0, count - 1});
+        }
+    }
+
+    const char* every = std::getenv("YOSEMITE_KERNEL_EVERY");
+    if (every) {
+        _every = std::max<uint64_t>(1, std::strtoull(every, nullptr, 10));
+    }
+
+    _active = _has_include || _has_exclude || !_windows.empty() || _every > 1;
+    return true;
+}
+
+
+bool KernelFilter::match_name(const std::string& kernel_name) const {
+    std::string demangled;
+    int status = 0;
+    char* buffer = abi::__cxa_demangle(kernel_name.c_str(), nullptr, nullptr, &status);
+    if (buffer) {
+        if (status == 0) {
+            demangled = buffer;
+        }
+        free(buffer);
+    }
+    auto matches = [&](const std::regex& regex) {
+        return std::regex_search(kernel_name, regex) || (!demangled.empty() && std::regex_search(demangled, regex));
+    };
+    if (_has_include && !matches(_include)) {
+        return false;
+    }
+    if (_has_exclude && matches(_exclude)) {
+        return false;
+    }
+    return true;
+}
+
+
+bool KernelFilter::in_windows(uint64_t index) const {
+    if (_windows.empty()) {
+        return true;
+    }
+    for (const auto& window : _windows) {
+        if (index < window.first) {
+            return false;
+        }
+        if (index <= window.last) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool KernelFilter::select(const std::string& kernel_name) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    const uint64_t index = _launches++;
+    auto it = _kernels.find(kernel_name);
+    if (it == _kernels.end()) {
+        it = _kernels.emplace(kernel_name, KernelState_t{match_name(kernel_name), 0}).first;
+    }
+    KernelState_t& kernel = it->second;
+    const uint64_t kernel_index = kernel.launches++;
+
+    const bool selected = kernel.name_selected && in_windows(index) && kernel_index % _every == 0;
+    if (selected) {
+        _selected++;
+    }
+    return selected;
+}
+
+
+std::string KernelFilter::describe() const {
+    std::string text;
+    if (_has_include) {
+        text += " include /" + _include_text + "/";
+    }
+    if (_has_exclude) {
+        text += " exclude /" + _exclude_text + "/";
+    }
+    if (!_windows.empty()) {
+        text += " windows";
+        for (size_t i = 0; i < _windows.size(); i++) {
+            const auto& window = _windows[i];
+            text += (i == 0 ? " " : ",") + std::to_string(window.first) + "-";
+            if (window.last != UINT64_MAX) {
+                text += std::to_string(window.last);
+            }
+        }
+    }
+    if (_every > 1) {
+        text += " every " + std::to_string(_every);
+    }
+    return text;
+}
+
+}   // yosemite
@@ -0,0 +1,310 @@
+#include "utils/self_profile.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+namespace yosemite {
+
+static const char* k_phase_names[ProfilePhaseCount] = {
+    "kernel_launch",
+    "kernel_end",
+    "mem_alloc",
+    "mem_free",
+    "mem_cpy",
+    "mem_set",
+    "ten_alloc",
+    "ten_free",
+    "op_start",
+    "op_end",
+    "gpu_data",
+    "query_ranges",
+    "query_tensors",
+    "flush",
+};
+
+
+const char* profile_phase_name(uint32_t phase) {
+    return phase < ProfilePhaseCount ? k_phase_names[phase] : "unknown";
+}
+
+
+/****************************************************************************************
+ ********************************** LatencyHistogram ************************************
+****************************************************************************************/
+
+
+uint32_t LatencyHistogram::bucket_index(uint64_t value) {
+    if (value < k_sub_buckets) {
+        return static_cast<uint32_t>(value);
+    }
+    const uint32_t exponent = 63 - __builtin_clzll(value);
+    const uint32_t sub = static_cast<uint32_t>(value >> (exponent - k_sub_bits)) & (k_sub_buckets - 1);
+    return (exponent - k_sub_bits + 1) * k_sub_buckets + sub;
+}
+
+
+uint64_t LatencyHistogram::bucket_lower(uint32_t index) {
+    if (index < k_sub_buckets) {
+        return index;
+    }
+    const uint32_t exponent = index / k_sub_buckets + k_sub_bits - 1;
+    const uint64_t sub = index % k_sub_buckets;
+    return (k_sub_buckets + sub) << (exponent - k_sub_bits);
+}
+
+
+uint64_t LatencyHistogram::bucket_upper(uint32_t index) {
+    if (index < k_sub_buckets) {
+        return index;
+    }
+    const uint32_t exponent = index / k_sub_buckets + k_sub_bits - 1;
+    return bucket_lower(index) + ((1ull << (exponent - k_sub_bits)) - 1);
+}
+
+
+void LatencyHistogram::record(uint64_t value) {
+    _buckets[bucket_index(value)]++;
+    _count++;
+    _sum += value;
+    if (value < _min) {
+        _min = value;
+    }
+    if (value > _max) {
+        _max = value;
+    }
+}
+
+
+uint64_t LatencyHistogram::percentile(double quantile) const {
+    if (_count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(quantile * _count + 0.5);
+    rank = rank == 0 ? 1 : (rank > _count ? _count : rank);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < k_bucket_count; i++) {
+        seen += _buckets[i];
+        if (seen >= rank) {
+            const uint64_t upper = bucket_upper(i);
+            return upper < _max ? upper : _max;
+        }
+    }
+    return _max;
+}
+
+
+/****************************************************************************************
+ *********************************** Hardware counters **********************************
+****************************************************************************************/
+
+
+// Per-thread counter group: cycles leads, LLC misses follow. Both count
+// user space only, so they work with perf_event_paranoid <= 2.
+typedef struct ThreadCounters {
+    int leader = -1;
+    int llc_misses = -1;
+    bool opened = false;
+
+    ~ThreadCounters() {
+        if (llc_misses >= 0) {
+            close(llc_misses);
+        }
+        if (leader >= 0) {
+            close(leader);
+        }
+    }
+} ThreadCounters_t;
+
+static thread_local ThreadCounters_t _thread_counters;
+
+
+static int open_counter(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+
+
+static bool open_thread_counters(ThreadCounters_t& counters) {
+    counters.opened = true;
+    counters.leader = open_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (counters.leader < 0) {
+        return false;
+    }
+    counters.llc_misses = open_counter(PERF_COUNT_HW_CACHE_MISSES, counters.leader);
+    if (counters.llc_misses < 0) {
+        close(counters.leader);
+        counters.leader = -1;
+        return false;
+    }
+    return true;
+}
+
+
+/****************************************************************************************
+ ************************************ SelfProfiler **************************************
+****************************************************************************************/
+
+
+SelfProfiler::SelfProfiler(bool counters)
+    : _counters(counters), _start(std::chrono::steady_clock::now()) {}
+
+
+ProfileEntry_t* SelfProfiler::add_owner(const void* owner, const std::string& name) {
+    std::lock_guard<std::mutex> guard(_owners_mutex);
+    _owners.push_back({owner, name, std::vector<ProfileEntry_t>(ProfilePhaseCount)});
+    return _owners.back().entries.data();
+}
+
+
+bool SelfProfiler::read_counters(CounterSample_t& sample) {
+    ThreadCounters_t& counters = _thread_counters;
+    if (!counters.opened && !open_thread_counters(counters)) {
+        if (_counters.exchange(false)) {
+            fprintf(stderr, "[SANALYZER ERROR] Cannot open hardware counters (%s), profiling without them.\n",
+                    strerror(errno));
+            fflush(stderr);
+        }
+        return false;
+    }
+    if (counters.leader < 0) {
+        return false;
+    }
+    uint64_t values[3];     // nr, cycles, llc misses
+    if (read(counters.leader, values, sizeof(values)) != static_cast<ssize_t>(sizeof(values))) {
+        return false;
+    }
+    sample.cycles = values[1];
+    sample.llc_misses = values[2];
+    return true;
+}
+
+
+uint64_t SelfProfiler::analyzer_ns() const {
+    std::lock_guard<std::mutex> guard(_owners_mutex);
+    uint64_t total = 0;
+    for (const auto& o : _owners) {
+        for (const auto& e : o.entries) {
+            total += e.latency.sum();
+        }
+    }
+    return total;
+}
+
+
+double SelfProfiler::wall_seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+}
+
+
+void SelfProfiler::print_summary(FILE* out) const {
+    const double wall = wall_seconds();
+    const double analyzer = analyzer_ns() / 1e9;
+    fprintf(out, "[SANALYZER INFO] Self profile: %.3f s in the analyzer over %.3f s (%.1f%%), "
+            "%lu host events, %lu GPU buffers, %lu records, %.1f MB.\n",
+            analyzer, wall, wall > 0 ? 100.0 * analyzer / wall : 0.0,
+            _events.load(), _gpu_buffers.load(), _gpu_records.load(), _gpu_bytes / 1e6);
+    if (analyzer > 0 && _gpu_bytes > 0) {
+        fprintf(out, "[SANALYZER INFO] Self profile: %.1f MB/s, %.0f records/s of analyzer time.\n",
+                _gpu_bytes / analyzer / 1e6, _gpu_records / analyzer);
+    }
+
+    const bool counters = this->counters();
+    fprintf(out, "%-28s %-14s %10s %12s %10s %10s %10s %10s",
+            "tool", "phase", "calls", "total_ms", "mean_us", "p50_us", "p99_us", "max_us");
+    if (counters) {
+        fprintf(out, " %14s %12s", "cycles", "llc_misses");
+    }
+    fprintf(out, "\n");
+    for (const auto& o : _owners) {
+        for (uint32_t phase = 0; phase < ProfilePhaseCount; phase++) {
+            const ProfileEntry_t& e = o.entries[phase];
+            const LatencyHistogram& h = e.latency;
+            if (h.count() == 0) {
+                continue;
+            }
+            fprintf(out, "%-28s %-14s %10lu %12.3f %10.2f %10.2f %10.2f %10.2f",
+                    o.name.c_str(), profile_phase_name(phase), h.count(), h.sum() / 1e6,
+                    h.sum() / 1e3 / h.count(), h.percentile(0.5) / 1e3, h.percentile(0.99) / 1e3, h.max() / 1e3);
+            if (counters) {
+                fprintf(out, " %14lu %12lu", e.cycles, e.llc_misses);
+            }
+            fprintf(out, "\n");
+        }
+    }
+    fflush(out);
+}
+
+
+// Histograms are written as [lower_ns, upper_ns, count] triples of the
+// non-empty buckets, so runs can be merged or re-bucketed offline.
+bool SelfProfiler::write_json(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        fprintf(stderr, "[SANALYZER ERROR] Cannot open self profile file %s.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+
+    const bool counters = this->counters();
+    out << "{\n";
+    out << "  \"wall_ns\": " << static_cast<uint64_t>(wall_seconds() * 1e9) << ",\n";
+    out << "  \"analyzer_ns\": " << analyzer_ns() << ",\n";
+    out << "  \"host_events\": " << _events << ",\n";
+    out << "  \"gpu_buffers\": " << _gpu_buffers << ",\n";
+    out << "  \"gpu_records\": " << _gpu_records << ",\n";
+    out << "  \"gpu_bytes\": " << _gpu_bytes << ",\n";
+    out << "  \"counters\": " << (counters ? "true" : "false") << ",\n";
+    out << "  \"entries\": [";
+    bool first = true;
+    for (const auto& o : _owners) {
+        for (uint32_t phase = 0; phase < ProfilePhaseCount; phase++) {
+            const ProfileEntry_t& e = o.entries[phase];
+            const LatencyHistogram& h = e.latency;
+            if (h.count() == 0) {
+                continue;
+            }
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "    {\"tool\": \"" << o.name << "\", \"phase\": \"" << profile_phase_name(phase) << "\""
+                << ", \"calls\": " << h.count()
+                << ", \"total_ns\": " << h.sum()
+                << ", \"min_ns\": " << h.min()
+                << ", \"max_ns\": " << h.max()
+                << ", \"p50_ns\": " << h.percentile(0.5)
+                << ", \"p90_ns\": " << h.percentile(0.9)
+                << ", \"p99_ns\": " << h.percentile(0.99)
+                << ", \"p999_ns\": " << h.percentile(0.999);
+            if (counters) {
+                out << ", \"cycles\": " << e.cycles << ", \"llc_misses\": " << e.llc_misses;
+            }
+            out << ", \"histogram\": [";
+            bool first_bucket = true;
+            for (uint32_t i = 0; i < LatencyHistogram::k_bucket_count; i++) {
+                if (h.bucket(i) == 0) {
+                    continue;
+                }
+                out << (first_bucket ? "" : ", ") << "[" << LatencyHistogram::bucket_lower(i) << ", "
+                    << LatencyHistogram::bucket_upper(i) << ", " << h.bucket(i) << "]";
+                first_bucket = false;
+            }
+            out << "]}";
+        }
+    }
+    out << "\n  ]\n}\n";
+    return true;
+}
+
+}   // yosemite
@@ -0,0 +1,606 @@
+#include "utils/trace_capture.h"
+#include "nvbit_common.h"
+
+#include <cstring>
+
+namespace yosemite {
+
+static const char k_capture_magic[8] = {'Y', 'S', 'M', 'C', 'A', 'P', 'T', '\0'};
+
+// item kinds following the EventType_t range
+static constexpr uint8_t k_item_name = 0x80;
+static constexpr uint8_t k_item_gpu_data = 0x81;
+static constexpr uint8_t k_item_query_ranges = 0x82;
+static constexpr uint8_t k_item_query_tensors = 0x83;
+static constexpr uint8_t k_item_end = 0xFF;
+
+
+// packed size of a GpuDataLayout_TRACKER buffer: the two counters, then both state tables
+static constexpr uint64_t k_tracker_bytes =
+    2 * sizeof(uint64_t) + sizeof(MemoryAccessState) + sizeof(TensorAccessState);
+
+
+uint64_t gpu_data_bytes(GpuDataLayout_t layout, uint64_t size) {
+    switch (layout) {
+        case GpuDataLayout_ACCESSES:
+            return size * sizeof(MemoryAccess);
+        case GpuDataLayout_TRACKER:
+            return k_tracker_bytes;
+        case GpuDataLayout_ACCESS_STATE:
+            return sizeof(MemoryAccessState);
+        case GpuDataLayout_NVBIT_ACCESS:
+            return sizeof(nvbit_mem_access_t);
+        default:
+            return 0;
+    }
+}
+
+
+static inline uint64_t zigzag_encode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+
+static inline int64_t zigzag_decode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+
+/****************************************************************************************
+ ************************************ CaptureWriter *************************************
+****************************************************************************************/
+
+
+CaptureWriter::~CaptureWriter() {
+    close();
+}
+
+
+bool CaptureWriter::open(const std::string& path, const CaptureHeader_t& header) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _file = fopen(path.c_str(), "wb");
+    if (!_file) {
+        fprintf(stderr, "[SANALYZER ERROR] Cannot open capture file %s.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    _path = path;
+    _layout = gpu_data_layout(header.patch_name);
+    _buffer.reserve(k_buffer_size);
+
+    const uint32_t version = k_capture_version;
+    _buffer.insert(_buffer.end(), k_capture_magic, k_capture_magic + sizeof(k_capture_magic));
+    for (int i = 0; i < 4; i++) {
+        _buffer.push_back(static_cast<uint8_t>(version >> (8 * i)));
+    }
+    put_varint(header.patch_name);
+    put_varint(header.sample_rate);
+    put_string(header.tool_names);
+    return true;
+}
+
+
+void CaptureWriter::close() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (!_file) {
+        return;
+    }
+    _buffer.push_back(k_item_end);
+    flush_buffer();
+    fclose(_file);
+    _file = nullptr;
+}
+
+
+void CaptureWriter::put_varint(uint64_t value) {
+    while (value >= 0x80) {
+        _buffer.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    _buffer.push_back(static_cast<uint8_t>(value));
+}
+
+
+void CaptureWriter::put_signed(int64_t value) {
+    put_varint(zigzag_encode(value));
+}
+
+
+void CaptureWriter::put_string(const std::string& value) {
+    put_varint(value.size());
+    _buffer.insert(_buffer.end(), value.begin(), value.end());
+}
+
+
+// large payloads skip the staging copy
+void CaptureWriter::put_bytes(const void* data, uint64_t size) {
+    if (size >= k_buffer_size) {
+        flush_buffer();
+        if (fwrite(data, 1, size, _file) != size) {
+            fprintf(stderr, "[SANALYZER ERROR] Failed to write capture file %s.\n", _path.c_str());
+            fflush(stderr);
+        }
+        _bytes += size;
+        return;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    _buffer.insert(_buffer.end(), bytes, bytes + size);
+    if (_buffer.size() >= k_buffer_size) {
+        flush_buffer();
+    }
+}
+
+
+void CaptureWriter::flush_buffer() {
+    if (_buffer.empty()) {
+        return;
+    }
+    if (fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size()) {
+        fprintf(stderr, "[SANALYZER ERROR] Failed to write capture file %s.\n", _path.c_str());
+        fflush(stderr);
+    }
+    _bytes += _buffer.size();
+    _buffer.clear();
+}
+
+
+uint32_t CaptureWriter::capture_name(uint32_t name_id) {
+    auto it = _names.find(name_id);
+    if (it != _names.end()) {
+        return it->second;
+    }
+    const uint32_t capture_id = static_cast<uint32_t>(_names.size());
+    _names.emplace(name_id, capture_id);
+    _buffer.push_back(k_item_name);
+    put_varint(capture_id);
+    put_string(event_name(name_id));
+    return capture_id;
+}
+
+
+void CaptureWriter::write_event(const EventRecord_t& record) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (!_file) {
+        return;
+    }
+
+    // names go out ahead of the event that first uses them
+    uint32_t name_id = 0;
+    if (record.evt_type == EventType_KERNEL_LAUNCH) {
+        name_id = capture_name(record.kernel_launch.name_id);
+    } else if (record.evt_type == EventType_KERNEL_END) {
+        name_id = capture_name(record.kernel_end.name_id);
+    } else if (record.evt_type == EventType_OP_START) {
+        name_id = capture_name(record.op_start.name_id);
+    } else if (record.evt_type == EventType_OP_END) {
+        name_id = capture_name(record.op_end.name_id);
+    }
+
+    _buffer.push_back(static_cast<uint8_t>(record.evt_type));
+    put_signed(record.device_id);
+    switch (record.evt_type) {
+        case EventType_KERNEL_LAUNCH: {
+            const auto& r = record.kernel_launch;
+            put_varint(name_id);
+            put_varint(r.grid_dim_x);
+            put_varint(r.grid_dim_y);
+            put_varint(r.grid_dim_z);
+            put_varint(r.block_dim_x);
+            put_varint(r.block_dim_y);
+            put_varint(r.block_dim_z);
+            break;
+        }
+        case EventType_KERNEL_END:
+            put_varint(name_id);
+            break;
+        case EventType_MEM_ALLOC:
+            put_varint(record.mem_alloc.addr);
+            put_varint(record.mem_alloc.size);
+            put_signed(record.mem_alloc.alloc_type);
+            break;
+        case EventType_MEM_FREE:
+            put_varint(record.mem_free.addr);
+            put_varint(record.mem_free.size);
+            put_signed(record.mem_free.alloc_type);
+            break;
+        case EventType_MEM_COPY: {
+            const auto& r = record.mem_cpy;
+            put_varint(r.src_addr);
+            put_varint(r.dst_addr);
+            put_varint(r.size);
+            put_varint(r.direction);
+            put_varint(r.is_async);
+            break;
+        }
+        case EventType_MEM_SET: {
+            const auto& r = record.mem_set;
+            put_varint(r.addr);
+            put_varint(r.size);
+            put_varint(r.value);
+            put_varint(r.is_async);
+            break;
+        }
+        case EventType_TEN_ALLOC: {
+            const auto& r = record.ten_alloc;
+            put_varint(r.addr);
+            put_signed(r.size);
+            put_signed(r.allocated_size);
+            put_signed(r.reserved_size);
+            break;
+        }
+        case EventType_TEN_FREE: {
+            const auto& r = record.ten_free;
+            put_varint(r.addr);
+            put_signed(r.size);
+            put_signed(r.allocated_size);
+            put_signed(r.reserved_size);
+            break;
+        }
+        case EventType_OP_START:
+            put_varint(name_id);
+            put_varint(reinterpret_cast<uint64_t>(record.op_start.ctx));
+            break;
+        case EventType_OP_END:
+            put_varint(name_id);
+            put_varint(reinterpret_cast<uint64_t>(record.op_end.ctx));
+            break;
+        default:
+            break;
+    }
+    _items++;
+    if (_buffer.size() >= k_buffer_size) {
+        flush_buffer();
+    }
+}
+
+
+void CaptureWriter::write_gpu_data(const void* data, uint64_t size, int device_id) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (!_file) {
+        return;
+    }
+    _buffer.push_back(k_item_gpu_data);
+    put_varint(size);
+    put_signed(device_id);
+    switch (_layout) {
+        case GpuDataLayout_ACCESSES:
+        case GpuDataLayout_ACCESS_STATE:
+        case GpuDataLayout_NVBIT_ACCESS:
+            put_varint(gpu_data_bytes(_layout, size));
+            put_bytes(data, gpu_data_bytes(_layout, size));
+            break;
+        case GpuDataLayout_TRACKER: {
+            static const MemoryAccessState empty_access_state = {};
+            static const TensorAccessState empty_tensor_state = {};
+            const MemoryAccessTracker* tracker = static_cast<const MemoryAccessTracker*>(data);
+            const uint64_t counters[2] = {tracker->accessCount, tracker->accessSize};
+            put_varint(k_tracker_bytes);
+            put_bytes(counters, sizeof(counters));
+            put_bytes(tracker->access_state ? tracker->access_state : &empty_access_state,
+                      sizeof(MemoryAccessState));
+            put_bytes(tracker->tensor_access_state ? tracker->tensor_access_state : &empty_tensor_state,
+                      sizeof(TensorAccessState));
+            break;
+        }
+        default:
+            put_varint(0);
+            break;
+    }
+    _items++;
+}
+
+
+void CaptureWriter::write_query(CaptureItemKind_t kind, uint32_t limit) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (!_file) {
+        return;
+    }
+    _buffer.push_back(kind == CaptureItem_QUERY_TENSORS ? k_item_query_tensors : k_item_query_ranges);
+    put_varint(limit);
+    _items++;
+}
+
+
+/****************************************************************************************
+ ************************************ CaptureReader *************************************
+****************************************************************************************/
+
+
+CaptureReader::~CaptureReader() {
+    if (_file) {
+        fclose(_file);
+    }
+}
+
+
+bool CaptureReader::open(const std::string& path) {
+    _file = fopen(path.c_str(), "rb");
+    if (!_file) {
+        fprintf(stderr, "[SANALYZER ERROR] Cannot open capture file %s.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    _buffer.resize(k_buffer_size);
+
+    char magic[sizeof(k_capture_magic)];
+    uint8_t version[4];
+    if (!get_bytes(magic, sizeof(magic)) || memcmp(magic, k_capture_magic, sizeof(magic)) != 0
+        || !get_bytes(version, sizeof(version))) {
+        fprintf(stderr, "[SANALYZER ERROR] %s is not a capture file.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    _header.version = version[0] | (version[1] << 8) | (version[2] << 16) | (static_cast<uint32_t>(version[3]) << 24);
+    if (_header.version < k_capture_min_version || _header.version > k_capture_version) {
+        fprintf(stderr, "[SANALYZER ERROR] Capture file %s has version %u, expected %u to %u.\n",
+                path.c_str(), _header.version, k_capture_min_version, k_capture_version);
+        fflush(stderr);
+        return false;
+    }
+
+    uint64_t patch_name = 0;
+    uint64_t sample_rate = 0;
+    if (!get_varint(patch_name) || !get_varint(sample_rate) || !get_string(_header.tool_names)) {
+        fprintf(stderr, "[SANALYZER ERROR] Capture file %s has a truncated header.\n", path.c_str());
+        fflush(stderr);
+        return false;
+    }
+    _header.patch_name = static_cast<uint32_t>(patch_name);
+    _header.sample_rate = static_cast<uint32_t>(sample_rate);
+    _layout = gpu_data_layout(_header.patch_name);
+    return true;
+}
+
+
+// Makes at least `count` bytes available in the buffer.
+bool CaptureReader::fill(size_t count) {
+    if (_end - _pos >= count) {
+        return true;
+    }
+    if (_pos > 0) {
+        memmove(_buffer.data(), _buffer.data() + _pos, _end - _pos);
+        _end -= _pos;
+        _pos = 0;
+    }
+    if (_buffer.size() < count) {
+        _buffer.resize(count);
+    }
+    _end += fread(_buffer.data() + _end, 1, _buffer.size() - _end, _file);
+    return _end - _pos >= count;
+}
+
+
+bool CaptureReader::get_bytes(void* dst, size_t count) {
+    // bulk payloads bypass the read buffer
+    if (count > k_buffer_size) {
+        const size_t buffered = _end - _pos;
+        memcpy(dst, _buffer.data() + _pos, buffered);
+        _pos = _end = 0;
+        return fread(static_cast<uint8_t*>(dst) + buffered, 1, count - buffered, _file) == count - buffered;
+    }
+    if (!fill(count)) {
+        return false;
+    }
+    memcpy(dst, _buffer.data() + _pos, count);
+    _pos += count;
+    return true;
+}
+
+
+bool CaptureReader::get_varint(uint64_t& value) {
+    value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (_pos == _end && !fill(1)) {
+            return false;
+        }
+        const uint8_t byte = _buffer[_pos++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool CaptureReader::get_signed(int64_t& value) {
+    uint64_t raw = 0;
+    if (!get_varint(raw)) {
+        return false;
+    }
+    value = zigzag_decode(raw);
+    return true;
+}
+
+
+bool CaptureReader::get_string(std::string& value) {
+    uint64_t size = 0;
+    if (!get_varint(size)) {
+        return false;
+    }
+    value.resize(size);
+    return get_bytes(&value[0], size);
+}
+
+
+const std::string& CaptureReader::name(uint32_t id) const {
+    static const std::string empty;
+    return id < _names.size() ? _names[id] : empty;
+}
+
+
+bool CaptureReader::read_event(EventType_t evt_type, EventRecord_t& record) {
+    uint64_t v[7] = {};
+    int64_t s[3] = {};
+    int64_t device_id = 0;
+    if (!get_signed(device_id)) {
+        return false;
+    }
+    record.timestamp = _sequence++;
+    record.evt_type = evt_type;
+    record.device_id = static_cast<int>(device_id);
+
+    bool ok = true;
+    switch (evt_type) {
+        case EventType_KERNEL_LAUNCH: {
+            for (int i = 0; i < 7 && ok; i++) {
+                ok = get_varint(v[i]);
+            }
+            auto& r = record.kernel_launch;
+            r.name_id = static_cast<uint32_t>(v[0]);
+            r.grid_dim_x = static_cast<uint32_t>(v[1]);
+            r.grid_dim_y = static_cast<uint32_t>(v[2]);
+            r.grid_dim_z = static_cast<uint32_t>(v[3]);
+            r.block_dim_x = static_cast<uint32_t>(v[4]);
+            r.block_dim_y = static_cast<uint32_t>(v[5]);
+            r.block_dim_z = static_cast<uint32_t>(v[6]);
+            r.block_thread_count = r.block_dim_x * r.block_dim_y * r.block_dim_z;
+            r.grid_cta_count = static_cast<uint64_t>(r.grid_dim_x) * r.grid_dim_y * r.grid_dim_z;
+            break;
+        }
+        case EventType_KERNEL_END:
+            ok = get_varint(v[0]);
+            record.kernel_end.name_id = static_cast<uint32_t>(v[0]);
+            break;
+        case EventType_MEM_ALLOC:
+        case EventType_MEM_FREE: {
+            ok = get_varint(v[0]) && get_varint(v[1]) && get_signed(s[0]);
+            MemAllocRecord_t r = {v[0], v[1], static_cast<int>(s[0])};
+            if (evt_type == EventType_MEM_ALLOC) {
+                record.mem_alloc = r;
+            } else {
+                record.mem_free = {r.addr, r.size, r.alloc_type};
+            }
+            break;
+        }
+        case EventType_MEM_COPY:
+            for (int i = 0; i < 5 && ok; i++) {
+                ok = get_varint(v[i]);
+            }
+            record.mem_cpy = {v[0], v[1], v[2], static_cast<uint32_t>(v[3]), v[4] != 0};
+            break;
+        case EventType_MEM_SET:
+            for (int i = 0; i < 4 && ok; i++) {
+                ok = get_varint(v[i]);
+            }
+            record.mem_set = {v[0], v[1], static_cast<uint32_t>(v[2]), v[3] != 0};
+            break;
+        case EventType_TEN_ALLOC:
+        case EventType_TEN_FREE: {
+            ok = get_varint(v[0]) && get_signed(s[0]) && get_signed(s[1]) && get_signed(s[2]);
+            if (evt_type == EventType_TEN_ALLOC) {
+                record.ten_alloc = {v[0], s[0], s[1], s[2]};
+            } else {
+                record.ten_free = {v[0], s[0], s[1], s[2]};
+            }
+            break;
+        }
+        case EventType_OP_START:
+            ok = get_varint(v[0]) && get_varint(v[1]);
+            record.op_start = {static_cast<uint32_t>(v[0]), reinterpret_cast<void*>(v[1])};
+            break;
+        case EventType_OP_END:
+            ok = get_varint(v[0]) && get_varint(v[1]);
+            record.op_end = {static_cast<uint32_t>(v[0]), reinterpret_cast<void*>(v[1])};
+            break;
+        default:
+            ok = false;
+            break;
+    }
+    return ok;
+}
+
+
+bool CaptureReader::read_gpu_data(CaptureItem_t& item) {
+    uint64_t size = 0;
+    int64_t device_id = -1;
+    uint64_t bytes = 0;
+    if (!get_varint(size) || (_header.version >= 2 && !get_signed(device_id)) || !get_varint(bytes)) {
+        return false;
+    }
+    _data.resize(bytes);
+    if (!get_bytes(_data.data(), bytes)) {
+        return false;
+    }
+    item.kind = CaptureItem_GPU_DATA;
+    item.data = bytes > 0 ? _data.data() : nullptr;
+    item.size = size;
+    item.bytes = bytes;
+    item.device_id = static_cast<int>(device_id);
+
+    if (_layout == GpuDataLayout_TRACKER) {
+        if (bytes != k_tracker_bytes) {
+            fprintf(stderr, "[SANALYZER ERROR] Capture holds a %lu byte tracker, expected %lu.\n", bytes, k_tracker_bytes);
+            fflush(stderr);
+            return false;
+        }
+        if (!_access_state) {
+            _access_state = std::make_unique<MemoryAccessState>();
+            _tensor_state = std::make_unique<TensorAccessState>();
+        }
+        const uint8_t* src = _data.data();
+        memcpy(&_tracker.accessCount, src, sizeof(uint64_t));
+        memcpy(&_tracker.accessSize, src + sizeof(uint64_t), sizeof(uint64_t));
+        src += 2 * sizeof(uint64_t);
+        memcpy(_access_state.get(), src, sizeof(MemoryAccessState));
+        memcpy(_tensor_state.get(), src + sizeof(MemoryAccessState), sizeof(TensorAccessState));
+        _tracker.access_state = _access_state.get();
+        _tracker.tensor_access_state = _tensor_state.get();
+        _tracker.access = nullptr;
+        item.data = &_tracker;
+    }
+    return true;
+}
+
+
+bool CaptureReader::next(CaptureItem_t& item) {
+    while (!_done) {
+        uint8_t kind = 0;
+        if (!get_bytes(&kind, 1)) {
+            _truncated = true;
+            break;
+        }
+
+        bool ok = true;
+        if (kind < EventTypeCount) {
+            item.kind = CaptureItem_EVENT;
+            ok = read_event(static_cast<EventType_t>(kind), item.record);
+        } else if (kind == k_item_name) {
+            uint64_t id = 0;
+            std::string name;
+            ok = get_varint(id) && get_string(name);
+            if (ok) {
+                if (id >= _names.size()) {
+                    _names.resize(id + 1);
+                }
+                _names[id] = std::move(name);
+                continue;
+            }
+        } else if (kind == k_item_gpu_data) {
+            ok = read_gpu_data(item);
+        } else if (kind == k_item_query_ranges || kind == k_item_query_tensors) {
+            uint64_t limit = 0;
+            ok = get_varint(limit);
+            item.kind = kind == k_item_query_ranges ? CaptureItem_QUERY_RANGES : CaptureItem_QUERY_TENSORS;
+            item.limit = static_cast<uint32_t>(limit);
+        } else if (kind == k_item_end) {
+            item.kind = CaptureItem_END;
+            _done = true;
+            return false;
+        } else {
+            fprintf(stderr, "[SANALYZER ERROR] Unknown capture item kind %u.\n", kind);
+            fflush(stderr);
+            ok = false;
+        }
+
+        if (!ok) {
+            _truncated = true;
+            break;
+        }
+        return true;
+    }
+    _done = true;
+    return false;
+}
+
+}   // yosemite